@@ -0,0 +1,159 @@
+#include "alurom.h"
+#include "../../assembler/src/symbol.h"
+
+#include <sstream>
+#include <exception>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <utility>
+
+std::string aluRomLayout::describe() const
+{
+	int rhsLo = 0;
+	int lhsLo = OPERAND_BITS;
+	int opLo = 2 * OPERAND_BITS;
+
+	std::stringstream s;
+	s << addressBits() << " address bits = op[" << opLo + opBits - 1 << ":" << opLo << "] lhs[" << opLo - 1 << ":"
+		<< lhsLo << "] rhs[" << lhsLo - 1 << ":" << rhsLo << "], " << wordBits << " bits (result, flags, flag enables) over "
+		<< romCount << " x " << romBits << "-bit rom(s)";
+
+	return s.str();
+}
+
+std::vector<aluOperation> findAluOperations(const cpu& c, aluRomLayout& layout)
+{
+	std::vector<aluOperation> operations;
+	uint32_t all = 0;
+
+	for (const symbol* s : c.getSymbols(SymbolType::ControlLine))
+	{
+		std::string_view name = s->getName();
+		if (!name.empty() && name[0] == '_')
+			name.remove_prefix(1);
+
+		// _alu_write_data puts the result on the data bus -- it's not an operation
+		if (name.rfind("alu_", 0) != 0 || name.find("_write_data") != std::string_view::npos || name.find("_read_data") != std::string_view::npos)
+			continue;
+
+		aluOperation o;
+		o.name = s->getName();
+		o.code = static_cast<uint32_t>(s->getAddress());
+		o.op = aluOpFromName(name.substr(4));
+
+		if (o.op == AluOp::Invalid)
+		{
+			std::stringstream msg;
+			msg << "Control line [" << o.name << "] at line " << s->getLine() << " is not a known alu operation!";
+			throw std::exception(msg.str().c_str());
+		}
+
+		all |= o.code;
+		operations.push_back(o);
+	}
+
+	if (all == 0)
+		throw std::exception("The architecture has no alu operations!");
+
+	// The operations share a field of the control word. When the architecture declares its fields
+	// (n << s) that is the one holding the lowest bit they use, otherwise it starts at that bit.
+	int low = 0;
+	while (((all >> low) & 1) == 0)
+		low++;
+
+	int start = low;
+	int end = 32;
+	for (int f : c.getControlFields())
+	{
+		if (f <= low)
+			start = f;
+		else
+		{
+			end = f;
+			break;
+		}
+	}
+
+	uint32_t field = (end >= 32 ? 0xFFFFFFFFu : (1u << end) - 1) & ~((1u << start) - 1);
+
+	for (aluOperation& o : operations)
+	{
+		if ((o.code & ~field) != 0)
+		{
+			std::stringstream msg;
+			msg << "Control line [" << o.name << "] doesn't fit the alu field [" << end - 1 << ":" << start << "]!";
+			throw std::exception(msg.str().c_str());
+		}
+
+		o.code >>= start;
+	}
+
+	layout.opBits = 0;
+	while ((all >> start) >> layout.opBits != 0)
+		layout.opBits++;
+
+	return operations;
+}
+
+namespace
+{
+	uint32_t packWord(const aluResult& r)
+	{
+		return r.value | (static_cast<uint32_t>(r.flags) << 8) | (static_cast<uint32_t>(r.affected) << 16);
+	}
+
+	// With the operation a template argument, aluCompute folds down to the code of that one operation,
+	// and the inner loop over rhs is plain arithmetic the compiler can vectorize.
+	template <AluOp Op>
+	void fillOperation(uint32_t* block)
+	{
+		const uint32_t operands = 1u << aluRomLayout::OPERAND_BITS;
+
+		for (uint32_t lhs = 0; lhs < operands; lhs++)
+		{
+			uint32_t* row = block + (lhs << aluRomLayout::OPERAND_BITS);
+
+			for (uint32_t rhs = 0; rhs < operands; rhs++)
+				row[rhs] = packWord(aluCompute(Op, static_cast<uint8_t>(lhs), static_cast<uint8_t>(rhs)));
+		}
+	}
+
+	using fillFunction = void (*)(uint32_t* block);
+
+	template <size_t... I>
+	constexpr std::array<fillFunction, sizeof...(I)> fillTable(std::index_sequence<I...>)
+	{
+		return { { &fillOperation<static_cast<AluOp>(I)>... } };
+	}
+
+	constexpr auto fillFunctions = fillTable(std::make_index_sequence<static_cast<size_t>(AluOp::Invalid)>());
+}
+
+std::vector<uint32_t> buildAluRom(const aluRomLayout& layout, const std::vector<aluOperation>& operations)
+{
+	std::vector<uint32_t> image(layout.entries(), 0);
+
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < operations.size(); i = next++)
+		{
+			const aluOperation& o = operations[i];
+			fillFunctions[static_cast<size_t>(o.op)](image.data() + layout.address(o.code, 0, 0));
+		}
+	};
+
+	size_t threadCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), operations.size()));
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < threadCount; t++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (std::thread& t : threads)
+		t.join();
+
+	return image;
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../../simulator/src/alu.h"
+#include "../../assembler/src/cpu.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The ALU is a lookup rom. From the most significant bit down, an address is made of the operation
+// (the value of the alu_* field of the control word), lhs and rhs. Each word holds the result in its
+// low byte, the new flag values above that and which flags the operation sets (the flag register's
+// load enables) in the top byte, so every byte goes to an 8-bit rom chip of its own.
+class aluRomLayout
+{
+public:
+	// the alu works on bytes, see alu.h
+	static constexpr int OPERAND_BITS = 8;
+
+	int opBits = 0;
+
+	int wordBits = 24;
+	int romBits = 8;
+	int romCount = 3;
+
+	uint32_t address(uint32_t op, uint32_t lhs, uint32_t rhs) const
+	{
+		return (op << (2 * OPERAND_BITS)) | (lhs << OPERAND_BITS) | rhs;
+	}
+
+	int addressBits() const { return opBits + 2 * OPERAND_BITS; }
+	size_t entries() const { return size_t(1) << addressBits(); }
+	size_t opBlock() const { return size_t(1) << (2 * OPERAND_BITS); }
+
+	std::string describe() const;
+};
+
+// one alu_* control line
+class aluOperation
+{
+public:
+	std::string name;
+	uint32_t code = 0;
+	AluOp op = AluOp::Invalid;
+};
+
+// Find the alu_* control lines of an architecture and the field of the control word they share.
+// Throws if one of them names an operation the alu doesn't know.
+std::vector<aluOperation> findAluOperations(const cpu& c, aluRomLayout& layout);
+
+// Compute every entry of the rom, one operation per thread at a time. Op codes no line uses are left
+// at zero.
+std::vector<uint32_t> buildAluRom(const aluRomLayout& layout, const std::vector<aluOperation>& operations);
\ No newline at end of file
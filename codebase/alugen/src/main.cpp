@@ -0,0 +1,86 @@
+#include "alurom.h"
+#include "../../assembler/src/assembler.h"
+#include "../../assembler/src/cpu.h"
+#include "../../assembler/src/rom.h"
+#include "../../assembler/src/util.h"
+
+#include <iostream>
+#include <string>
+#include <chrono>
+
+int main(int argc, char* argv[])
+{
+	// On the command-line, we expect ./alugen file.arch [options], where file.arch is the architecture
+	// whose alu_* control lines select the operations. The alu rom images are written next to it, as
+	// file.alu0.bin (result), file.alu1.bin (flags) and file.alu2.bin (flag enables).
+	//  -I dir       add to the include search path (the code directory is searched last)
+	//  -o name      write name.aluN.bin instead
+	//  -hex         also print the images
+	if (argc < 2)
+	{
+		std::cout << "Please specify an input file!" << std::endl;
+		return 1;
+	}
+
+	try
+	{
+		cpu cpu;
+		assembler assembler(argv[1], cpu);
+		assembler.setEcho(0x10);
+
+		std::string basename = assembler.outputBasename();
+		bool hex = false;
+
+		for (int i = 2; i < argc; i++)
+		{
+			std::string arg = argv[i];
+
+			if (arg == "-I" && i + 1 < argc)
+				assembler.addIncludePath(argv[++i]);
+			else if (arg.rfind("-I", 0) == 0 && arg.size() > 2)
+				assembler.addIncludePath(arg.substr(2));
+			else if (arg == "-o" && i + 1 < argc)
+				basename = argv[++i];
+			else if (arg == "-hex")
+				hex = true;
+			else
+				std::cout << "Ignoring unknown argument [" << arg << "]" << std::endl;
+		}
+
+		assembler.addIncludePath("code");
+		assembler.assembly_pass0();
+
+		aluRomLayout layout;
+		std::vector<aluOperation> operations = findAluOperations(cpu, layout);
+
+		std::cout << "-- " << dec << operations.size() << " alu operations, " << layout.describe() << "\n";
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<uint32_t> image = buildAluRom(layout, operations);
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+		std::cout << "   " << dec << layout.entries() << " entries generated in " << elapsed.count() << " ms\n";
+
+		for (int r = 0; r < layout.romCount; r++)
+		{
+			std::string filename = basename + ".alu" + std::to_string(r) + ".bin";
+			std::vector<uint8_t> slice = sliceRomImage(image, r * layout.romBits, layout.romBits);
+			writeRomImage(filename, slice);
+
+			std::cout << "          *** Wrote alu rom bits [" << dec << (r + 1) * layout.romBits - 1 << ":" << r * layout.romBits << "] to " << filename << "\n";
+
+			if (hex)
+			{
+				std::string dump = hexDumpRomImage(slice);
+				std::cout.write(dump.data(), dump.size());
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Fatal error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
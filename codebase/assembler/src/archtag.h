@@ -4,6 +4,7 @@
 #include "cpu.h"
 #include "command.h"
 #include "parser.h"
+#include "lexer.h"
 
 #include <iostream>
 #include <sstream>
@@ -15,7 +16,7 @@ class archBitWidth : public command
 public:
 	void process(assembler& assembler, cpu& cpu, const std::string& label, std::string remainder, int line) const override
 	{
-		auto sizeToken = parser::instance().extract_token_ws_comma(remainder);
+		auto sizeToken = assembler.getParser().extract_token_ws_comma(remainder);
 		if (!sizeToken.has_value())
 		{
 			std::stringstream msg;
@@ -34,10 +35,10 @@ public:
 		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
 		{
 			if (label == INSTRUCTION_WIDTH_STR)
-				std::cout << "          *** Instruction Width set to " << std::string(sizeToken.value()) << "\n\n";
+				assembler.out() << "          *** Instruction Width set to " << std::string(sizeToken.value()) << "\n\n";
 
 			if (label == ADDRESS_WIDTH_STR)
-				std::cout << "          *** Address Width set to " << std::string(sizeToken.value()) << "\n\n";
+				assembler.out() << "          *** Address Width set to " << std::string(sizeToken.value()) << "\n\n";
 		}
 
 		if (label == INSTRUCTION_WIDTH_STR)
@@ -53,7 +54,7 @@ class archRom : public command
 public:
 	void process(assembler& assembler, cpu& cpu, const std::string& label, std::string remainder, int line) const override
 	{
-		auto writeToken = parser::instance().extract_token_ws_comma(remainder);
+		auto writeToken = assembler.getParser().extract_token_ws_comma(remainder);
 		if (!writeToken.has_value())
 		{
 			std::stringstream msg;
@@ -69,7 +70,7 @@ public:
 			throw std::exception(msg.str().c_str());
 		}
 
-		auto inSizeToken = parser::instance().extract_token_ws_comma(remainder);
+		auto inSizeToken = assembler.getParser().extract_token_ws_comma(remainder);
 		if (!inSizeToken.has_value())
 		{
 			std::stringstream msg;
@@ -85,7 +86,7 @@ public:
 			throw std::exception(msg.str().c_str());
 		}
 
-		auto outSizeToken = parser::instance().extract_token_ws_comma(remainder);
+		auto outSizeToken = assembler.getParser().extract_token_ws_comma(remainder);
 		if (!outSizeToken.has_value())
 		{
 			std::stringstream msg;
@@ -106,17 +107,17 @@ public:
 		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
 		{
 			if (label == DECODER_ROM_STR)
-				std::cout << "          *** Decoder Rom with " << std::string(inSizeToken.value()) << " inputs and " << std::string(outSizeToken.value()) << " outputs (";
+				assembler.out() << "          *** Decoder Rom with " << std::string(inSizeToken.value()) << " inputs and " << std::string(outSizeToken.value()) << " outputs (";
 
 			if (label == PROGRAM_ROM_STR)
-				std::cout << "          *** Program Rom with " << std::string(inSizeToken.value()) << " inputs and " << std::string(outSizeToken.value()) << " outputs (";
+				assembler.out() << "          *** Program Rom with " << std::string(inSizeToken.value()) << " inputs and " << std::string(outSizeToken.value()) << " outputs (";
 
 			if (write)
-				std::cout << "write)\n";
+				assembler.out() << "write)\n";
 			else
-				std::cout << "non-write)\n";
+				assembler.out() << "non-write)\n";
 
-			std::cout << "\n";
+			assembler.out() << "\n";
 		}
 
 		if (label == DECODER_ROM_STR)
@@ -132,7 +133,7 @@ class archRegister : public command
 public:
 	void process(assembler& assembler, cpu& cpu, const std::string& label, std::string remainder, int line) const override
 	{
-		auto sizeToken = parser::instance().extract_token_ws_comma(remainder);
+		auto sizeToken = assembler.getParser().extract_token_ws_comma(remainder);
 		if (!sizeToken.has_value())
 		{
 			std::stringstream msg;
@@ -151,13 +152,13 @@ public:
 		bool tokensRemain = true;
 		while (tokensRemain)
 		{
-			auto nameToken = parser::instance().extract_token_ws_comma(remainder);
+			auto nameToken = assembler.getParser().extract_token_ws_comma(remainder);
 			if (nameToken.has_value())
 			{
 				std::string nameTokenString = std::string(nameToken.value());
 
 				if (assembler.echoParsedMajor() && assembler.echoArchitecture())
-					std::cout << "          *** Adding " << std::string(sizeToken.value()) << "-bit Register [" << nameTokenString << "]\n";
+					assembler.out() << "          *** Adding " << std::string(sizeToken.value()) << "-bit Register [" << nameTokenString << "]\n";
 
 				cpu.addRegister(nameTokenString, stoi(std::string(sizeToken.value())), line);
 			}
@@ -168,7 +169,7 @@ public:
 		}
 
 		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
-			std::cout << "\n";
+			assembler.out() << "\n";
 	}
 };
 
@@ -180,7 +181,7 @@ public:
 		bool tokensRemain = true;
 		while (tokensRemain)
 		{
-			auto nameToken = parser::instance().extract_token_ws_comma(remainder);
+			auto nameToken = assembler.getParser().extract_token_ws_comma(remainder);
 			if (nameToken.has_value())
 			{
 				std::string nameTokenString = std::string(nameToken.value());
@@ -188,10 +189,10 @@ public:
 				if (assembler.echoParsedMajor() && assembler.echoArchitecture())
 				{
 					if (label == FLAG_STR)
-						std::cout << "          *** Adding flag [" << nameTokenString << "]\n";
+						assembler.out() << "          *** Adding flag [" << nameTokenString << "]\n";
 
 					if (label == DEVICE_STR)
-						std::cout << "          *** Adding device [" << nameTokenString << "]\n";
+						assembler.out() << "          *** Adding device [" << nameTokenString << "]\n";
 				}
 
 				if (label == FLAG_STR)
@@ -204,7 +205,7 @@ public:
 		}
 
 		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
-			std::cout << "\n";
+			assembler.out() << "\n";
 	}
 };
 
@@ -213,119 +214,96 @@ class archControlLine : public command
 public:
 	void process(assembler& assembler, cpu& cpu, const std::string& label, std::string remainder, int line) const override
 	{
-		auto nameToken = parser::instance().extract_token_ws(remainder);
-		if (!nameToken.has_value())
+		lexer lex(remainder);
+
+		token nameToken = lex.next();
+		if (!nameToken.is(TokenType::Identifier))
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! No label provided for control line!";
 			throw std::exception(msg.str().c_str());
 		}
 
-		if (std::string(nameToken.value()) == "fetch")
-			std::cout << "";
-
-		bool tokensRemain = true;
 		int firstNum = -1;
-		int op = 0;
 		int secondNum = -1;
-		while (tokensRemain)
+		int shift = 0;
+		bool usesSymbols = false;
+		Operation op = Operation::None;
+		for (token t = lex.next(); !t.is(TokenType::End); t = lex.next())
 		{
-			// Get the rest of 
-			auto nextToken = parser::instance().extract_token_ws_comma(remainder);
-			if (nextToken.has_value())
+			switch (t.type)
 			{
-				std::string tokenString = std::string(nextToken.value());
-				LiteralNumType type = parser::instance().get_num_type(tokenString);
+			case TokenType::Number:
+				if (shift == 0) firstNum = t.value;
+				else            secondNum = t.value;
+				break;
+
+			case TokenType::ShiftLeft:
+				shift = -1;
+				break;
+
+			case TokenType::ShiftRight:
+				shift = 1;
+				break;
+
+			case TokenType::Pipe:
+				op = Operation::OR;
+				break;
 
-				if (type != LiteralNumType::None)
+			case TokenType::Equals:
+			case TokenType::Comma:
+				break;
+
+			case TokenType::Identifier:
+				usesSymbols = true;
+				if (firstNum == -1)
+					firstNum = 0;
+
+				if (op == Operation::OR)
 				{
-					int num = parser::instance().parse_literal_num(tokenString, type);
-					if (num != -1)
-					{
-						if (op == 0) firstNum = num;
-						else         secondNum = num;
-					}
+					if (t.text.front() == '_')
+						firstNum = firstNum ^ cpu.getSymbolAddress(t.text, line);
 					else
-					{
-						std::stringstream msg;
-						msg << "Assembling command " << label << " at line <" << line << ">! Bad int literal parse type!";
-						throw std::exception(msg.str().c_str());
-					}
+						firstNum = firstNum | cpu.getSymbolAddress(t.text, line);
+
+					op = Operation::None;
 				}
 				else
 				{
-					if (tokenString[0] == '<' && tokenString[1] == '<') op = -1;
-					else if (tokenString[0] == '>' && tokenString[1] == '>') op = 1;
-					else
-					{
-						if (!isdigit(tokenString.c_str()[0]))
-						{
-							if (tokenString[0] == '|')
-							{
-								op = Operation::OR;
-							}
-							else if (tokenString[0] == '=')
-							{
-								continue;
-							}
-							else
-							{
-								if (firstNum == -1)
-									firstNum = 0;
-
-								if (op == Operation::OR)
-								{
-									if (tokenString[0] == '_')
-										firstNum = firstNum ^ cpu.getSymbolAddress(tokenString);
-									else
-										firstNum = firstNum | cpu.getSymbolAddress(tokenString);
-
-									op = Operation::None;
-								}
-								else
-								{
-									firstNum = cpu.getSymbolAddress(tokenString);
-								}
-							}
-						}
-						else
-						{
-							std::stringstream msg;
-							msg << "Assembling command " << label << " at line <" << line << ">! Expected a symbol reference -- found !" << tokenString;
-							throw std::exception(msg.str().c_str());
-						}
-					}
+					firstNum = cpu.getSymbolAddress(t.text, line);
 				}
-			}
-			else
+				break;
+
+			default:
 			{
-				tokensRemain = false;
+				std::stringstream msg;
+				msg << "Assembling command " << label << " at line <" << line << ">! Expected a symbol reference -- found !" << t.text;
+				throw std::exception(msg.str().c_str());
+			}
 			}
 		}
 
 		int finalNum = -1;
-		if (op != 0)
-		{
-			if (op == -1) finalNum = firstNum << secondNum;
-			if (op == 1)  finalNum = firstNum >> secondNum;
-		}
-		else
-		{
-			finalNum = firstNum;
-		}
+		if (shift == -1) finalNum = firstNum << secondNum;
+		else if (shift == 1) finalNum = firstNum >> secondNum;
+		else finalNum = firstNum;
 
 		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
 		{
-			std::cout << "          *** Saving control line = ";
-			std::cout << " = $" << hex8 << finalNum;
+			assembler.out() << "          *** Saving control line = ";
+			assembler.out() << " = $" << hex8 << finalNum;
 
 			if (assembler.echoParsedMinor())
-				std::cout << " = %" << std::bitset<sizeof(int) * 8>(finalNum);
+				assembler.out() << " = %" << std::bitset<sizeof(int) * 8>(finalNum);
 
-			std::cout << "\n\n";
+			assembler.out() << "\n\n";
 		}
 
-		cpu.addControlLine(std::string(nameToken.value()), finalNum, line);
+		cpu.addControlLine(nameToken.text, finalNum, line);
+
+		// a line written as value << shift marks where one field of the control word starts
+		if (shift == -1 && !usesSymbols)
+			cpu.addControlField(secondNum);
 	}
 };
 
@@ -335,88 +313,101 @@ public:
 	virtual void process(assembler& assembler, cpu& cpu, const std::string& label, std::string remainder, int line) const override
 	{
 		opcode opcode;
+		bool isAlias = label == OPCODE_ALIAS_STR;
+
+		lexer lex(remainder);
 
-		auto valueToken = parser::instance().extract_token_ws_comma(remainder);
-		if (!valueToken.has_value())
+		token valueToken = lex.next();
+		if (!valueToken.is(TokenType::Number))
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! Opcode is not assigned a valid value!";
 			throw std::exception(msg.str().c_str());
 		}
 
-		std::string valueString = std::string(valueToken.value());
-		int parsedValue = parser::instance().parse_literal_num(valueString);
+		int parsedValue = valueToken.value;
+		if (!cpu.opcodeFits(parsedValue))
+		{
+			std::stringstream msg;
+			msg << "Assembling command " << label << " at line <" << line << ">! Opcode value $" << hex2 << parsedValue
+				<< " doesn't fit in the " << dec << cpu.getInstructionWidth() << " byte instruction width!";
+			throw std::exception(msg.str().c_str());
+		}
 
 		opcode.setValue(parsedValue);
 
-		auto nameToken = parser::instance().extract_token_ws_comma(remainder);
-		if (!nameToken.has_value())
+		token nameToken = lex.next();
+		if (!nameToken.is(TokenType::Identifier))
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! Opcode is not assigned a valid label!";
 			throw std::exception(msg.str().c_str());
 		}
 
-		opcode.setMnemonic(std::string(nameToken.value()));
+		opcode.setMnemonic(std::string(nameToken.text));
 
-		bool tokensRemain = true;
 		Operation op = Operation::None;
-		int seq = 0;
+		bool isAddress = false;
 		int num = -1;
-		while (tokensRemain)
+		for (token t = lex.next(); !t.is(TokenType::End); t = lex.next())
 		{
-			auto nextToken = parser::instance().extract_token_ws_comma(remainder);
-
-			if (nextToken.has_value())
+			switch (t.type)
 			{
-				std::string tokenString = std::string(nextToken.value());
+			case TokenType::IndirectBegin:
+				isAddress = true;
+				break;
+
+			case TokenType::IndirectEnd:
+				isAddress = false;
+				break;
 
-				bool isAddress = parser::instance().try_strip_indirect(tokenString);
+			case TokenType::Pipe:
+				op = Operation::OR;
+				break;
 
-				if (tokenString[0] == '|' && label != OPCODE_ALIAS_STR)
+			case TokenType::Equals:
+			case TokenType::Comma:
+				break;
+
+			case TokenType::Hash:
+			{
+				opcode::arg newArg;
+				if (isAddress)
 				{
-					op = Operation::OR;
+					newArg._type = ArgType::DerefNum;
+					newArg._string = "[#]";
 				}
-				else if (tokenString[0] == '=' && label != OPCODE_ALIAS_STR)
+				else
 				{
-					continue;
+					newArg._type = ArgType::Numeral;
+					newArg._string = "#";
 				}
-				else if (tokenString[0] == '#')
-				{
-					opcode::arg newArg;
-					if (isAddress)
-					{
-						newArg._type = ArgType::DerefNum;
-						newArg._string = "[#]";
-					}
-					else
-					{
-						newArg._type = ArgType::Numeral;
-						newArg._string = "#";
-					}
 
-					opcode.addArgument(newArg);
+				opcode.addArgument(newArg);
 
-					if (assembler.echoParsedMinor() && assembler.echoArchitecture())
-					{
-						if (!isAddress)
-							std::cout << "					*** Adding an immediate value argument = " << newArg._string << "\n";
-						else
-							std::cout << "					*** Adding a dereferenced value argument = " << newArg._string << "\n";
-					}
+				if (assembler.echoParsedMinor() && assembler.echoArchitecture())
+				{
+					if (!isAddress)
+						assembler.out() << "					*** Adding an immediate value argument = " << newArg._string << "\n";
+					else
+						assembler.out() << "					*** Adding a dereferenced value argument = " << newArg._string << "\n";
 				}
-				else if (cpu.getSymbolType(tokenString) == SymbolType::Register)
+				break;
+			}
+
+			case TokenType::Identifier:
+				if (cpu.getSymbolType(t.text) == SymbolType::Register)
 				{
 					opcode::arg newArg;
 					if (isAddress)
 					{
 						newArg._type = ArgType::DerefReg;
-						newArg._string = "[" + tokenString + "]";
+						newArg._string = "[" + std::string(t.text) + "]";
 					}
 					else
 					{
 						newArg._type = ArgType::Register;
-						newArg._string = tokenString;
+						newArg._string = std::string(t.text);
 					}
 
 					opcode.addArgument(newArg);
@@ -424,86 +415,89 @@ public:
 					if (assembler.echoParsedMinor() && assembler.echoArchitecture())
 					{
 						if (!isAddress)
-							std::cout << "					*** Adding a register value argument = " << newArg._string << "\n";
+							assembler.out() << "					*** Adding a register value argument = " << newArg._string << "\n";
 						else
-							std::cout << "					*** Adding a dereferenced register value argument = " << newArg._string << "\n";
+							assembler.out() << "					*** Adding a dereferenced register value argument = " << newArg._string << "\n";
 					}
 				}
-				else if (label != OPCODE_ALIAS_STR)
+				else if (!isAlias)
 				{
 					if (num == -1)
 						num = 0;
 
 					if (op == Operation::OR)
 					{
-						if (tokenString[0] == '_')
-							num = num ^ cpu.getSymbolAddress(tokenString);
+						if (t.text.front() == '_')
+							num = num ^ cpu.getSymbolAddress(t.text, line);
 						else
-							num = num | cpu.getSymbolAddress(tokenString);
+							num = num | cpu.getSymbolAddress(t.text, line);
 
 						op = Operation::None;
 					}
 					else
 					{
-						num = cpu.getSymbolAddress(tokenString);
+						num = cpu.getSymbolAddress(t.text, line);
 					}
 				}
-			}
-			else
-			{
-				tokensRemain = false;
+				break;
+
+			default:
+				break;
 			}
 		}
 
-		cpu.addOpcode(parsedValue, opcode);
+		if (isAlias)
+			cpu.addOpcodeAlias(parsedValue, opcode);
+		else
+			cpu.addOpcode(parsedValue, opcode);
 
-		if (num != -1 && label != OPCODE_ALIAS_STR)
+		// an inline control pattern becomes the first cycle of the opcode
+		if (num != -1 && !isAlias)
 		{
 			controlPattern cp;
 			cp.pattern = num;
+			cp.type = PatternType::Seq;
+			cp.flags = flagSet::all();
 
-			for (int i = 0; i < pow(2, cpu.getFlagCount()); i++)
-			{
-				cp.flags.push_back(i);
-				cp.type = PatternType::Seq;
-			}
-
-			opcode.addNewControlPattern(cp);
+			cpu.addNewControlPatternToCurrentOpcode(cp);
 		}
 
 		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
 		{
-			std::cout << "          *** Saving opcode " << std::string(nameToken.value()) << " ";
+			assembler.out() << "          *** Saving opcode " << nameToken.text << " ";
 
 			for (int i = 0; i < opcode.numArgs(); i++)
 			{
-				std::cout << opcode.getArg(i)._string;
+				assembler.out() << opcode.getArg(i)._string;
 
 				if (i != opcode.numArgs() - 1)
-					std::cout << ", ";
+					assembler.out() << ", ";
 			}
 
-			if (label != OPCODE_ALIAS_STR)
-				std::cout << " -- val = $";
+			if (!isAlias)
+				assembler.out() << " -- val = $";
 			else
-				std::cout << " -- to existing opcode with val = $";
+				assembler.out() << " -- to existing opcode with val = $";
 
-			std::cout << hex2 << opcode.value();
+			assembler.out() << hex2 << opcode.value();
 
-			if (label != OPCODE_ALIAS_STR)
+			if (!isAlias)
 			{
-				std::cout << ", control sequence : ";
-				for (int i = 0; i < opcode.numCycles(); i++)
+				assembler.out() << ", control sequence : ";
+
+				const opcodeTable& opcodes = cpu.getOpcodes();
+				const auto* stored = opcodes.find(parsedValue);
+				for (int i = 0; i < stored->numCycles(); i++)
 				{
-					for (int j = 0; j < opcode.getPatterns(i).cpattern[0].flags.size(); i++)
-					{
-						controlPattern p = opcode.getPatterns(i).cpattern[0];
-						std::cout << "              " << dec << i << ": $" << hex8 << p.pattern << " and flag pattern = " << p.flags[j] << "\n";
-					}
+					const controlPattern& p = opcodes.getCycle(*stored, i).cpattern[0];
+					p.flags.forEach(cpu.getFlagCount(), [&](uint32_t f)
+						{
+							assembler.out() << "              " << dec << i << ": $" << hex8 << p.pattern << " and flag pattern = " << dec << f << "\n";
+						});
 				}
 			}
 
-			std::cout << ", unique_str = " << opcode.getUniqueString() << "\n";
+			assembler.out() << ", unique_str = " << opcode.getUniqueString() << "\n";
 		}
 	}
 };
@@ -513,75 +507,64 @@ class archOpcodeSeq : public command
 public:
 	void process(assembler& assembler, cpu& cpu, const std::string& label, std::string remainder, int line) const override
 	{
-		bool tokensRemain = true;
 		bool colonFound = false;
 		Operation op = Operation::None;
 
-		cpu.lastAddedFlags.clear();
-
 		controlPattern cp;
 		int num = 0;
-		while (tokensRemain)
-		{
-			auto nextToken = parser::instance().extract_token_ws_comma(remainder);
 
-			if (nextToken.has_value())
-			{
-				std::string tokenString = std::string(nextToken.value());
+		// seq_if collects its conditions as it goes, seq_else takes whatever the matching seq_if did not
+		// cover, and a plain seq applies to every flag state
+		if (label == OPCODE_SEQ_IF_STR) cp.flags = flagSet::none();
+		else if (label == OPCODE_SEQ_ELSE_STR) cp.flags = cpu.lastSeqIfFlags.complement();
+		else cp.flags = flagSet::all();
 
-				if (tokenString[0] == ':')
-				{
-					colonFound = true;
-				}
-				else if (tokenString[0] == '|')
-				{
-					op = Operation::OR;
-				}
-				else if (tokenString[0] == '=')
+		lexer lex(remainder);
+		for (token t = lex.next(); !t.is(TokenType::End); t = lex.next())
+		{
+			if (t.is(TokenType::Colon))
+			{
+				colonFound = true;
+			}
+			else if (t.is(TokenType::Pipe))
+			{
+				op = Operation::OR;
+			}
+			else if (t.is(TokenType::Equals) || t.is(TokenType::Comma))
+			{
+				continue;
+			}
+			else if (!colonFound && label == OPCODE_SEQ_IF_STR)
+			{
+				// flag patterns like x0x1x -- the raw token text is used whatever it lexed as
+				auto cube = flagCube::parse(t.text, cpu.getFlagCount());
+				if (!cube.has_value())
 				{
-					continue;
+					std::stringstream msg;
+					msg << "Assembling command " << label << " at line <" << line << ">! Flag pattern [" << t.text << "] must have one 0, 1 or x for each of the " << cpu.getFlagCount() << " flags!";
+					throw std::exception(msg.str().c_str());
 				}
+
+				cp.flags.add(cube.value());
+			}
+			else if (!t.is(TokenType::Identifier))
+			{
+				std::stringstream msg;
+				msg << "Assembling command " << label << " at line <" << line << ">! Expected a control line -- found [" << t.text << "]!";
+				throw std::exception(msg.str().c_str());
+			}
+			else if (op == Operation::OR)
+			{
+				if (t.text.front() == '_')
+					num = num ^ cpu.getSymbolAddress(t.text, line);
 				else
-				{
-					if (!colonFound && label == OPCODE_SEQ_IF_STR)
-					{
-						int nFlags = cpu.getFlagCount();
-						for (int i = 0; i < pow(2, nFlags); i++)
-						{
-							std::string currFlag = std::bitset<5>(i).to_string();
-
-							bool patternMatch = true;
-							for (int j = 0; j < nFlags; j++)
-							{
-								bool digit_j_matches = tokenString[j] == 'x' || tokenString[j] == currFlag[j];
-								patternMatch = patternMatch && digit_j_matches;
-							}
-
-							if (patternMatch)
-							{
-								cp.flags.push_back(i);
-								cpu.lastAddedFlags.push_back(i);
-							}
-						}
-					}
-					else if (op == Operation::OR)
-					{
-						if (tokenString[0] == '_')
-							num = num ^ cpu.getSymbolAddress(tokenString);
-						else
-							num = num | cpu.getSymbolAddress(tokenString);
+					num = num | cpu.getSymbolAddress(t.text, line);
 
-						op = Operation::None;
-					}
-					else
-					{
-						num = cpu.getSymbolAddress(tokenString);
-					}
-				}
+				op = Operation::None;
 			}
 			else
 			{
-				tokensRemain = false;
+				num = cpu.getSymbolAddress(t.text, line);
 			}
 		}
 
@@ -591,22 +574,42 @@ public:
 		if (label == OPCODE_SEQ_IF_STR) cp.type = PatternType::Seq_If;
 		if (label == OPCODE_SEQ_ELSE_STR) cp.type = PatternType::Seq_Else;
 
-		if (label != OPCODE_SEQ_IF_STR)
+		const opcode* current = cpu.getOpcode(cpu.lastOpcodeIndex());
+		if (current == nullptr)
 		{
-			for (int i = 0; i < pow(2, cpu.getFlagCount()); i++)
+			std::stringstream msg;
+			msg << "Assembling command " << label << " at line <" << line << ">! " << label << " must follow an opcode!";
+			throw std::exception(msg.str().c_str());
+		}
+
+		if (label == OPCODE_SEQ_ELSE_STR)
+		{
+			// seq_else is the other half of the cycle started by the seq_if right before it
+			if (current->numCycles() == 0 ||
+				cpu.getOpcodes().getCycle(*current, current->numCycles() - 1).count != 1 ||
+				cpu.getOpcodes().getCycle(*current, current->numCycles() - 1).cpattern[0].type != PatternType::Seq_If)
 			{
-				cp.flags.push_back(i);
+				std::stringstream msg;
+				msg << "Assembling command " << label << " at line <" << line << ">! " << label << " must directly follow a " << OPCODE_SEQ_IF_STR << "!";
+				throw std::exception(msg.str().c_str());
 			}
-		}
 
-		cpu.addNewControlPatternToCurrentOpcode(cp);
+			cpu.addToLastControlPatternInCurrentOpcode(cp);
+		}
+		else
+		{
+			cpu.addNewControlPatternToCurrentOpcode(cp);
+		}
 
-		opcode opcode = cpu.getOpcode(cpu.lastOpcodeIndex());
+		if (label == OPCODE_SEQ_IF_STR)
+			cpu.lastSeqIfFlags = cp.flags;
 
 		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
 		{
-			for (int i = 0; i < cp.flags.size(); i++)
-				std::cout << "              *** new cycle added = $" << hex8 << num << " with flag pattern = " << cp.flags[i] << "\n";
+			cp.flags.forEach(cpu.getFlagCount(), [&](uint32_t f)
+				{
+					assembler.out() << "              *** new cycle added = $" << hex8 << num << " with flag pattern = " << dec << f << "\n";
+				});
 		}
 	}
 };
\ No newline at end of file
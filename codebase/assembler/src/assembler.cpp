@@ -3,105 +3,518 @@
 #include "parser.h"
 #include "directive.h"
 #include "archtag.h"
+#include "util.h"
+#include "stats.h"
 
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <cctype>
 
 assembler::assembler(const std::string& filename, cpu &c)
 	:
 	_cpu(c)
 {
-	// set file exceptions, save the start file, add to file stack
-	_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	// save the start file
 	_startFile = filename;
 }
 
 void assembler::assemble()
 {
+	scopedTimer timer("assemble");
+
 	assembly_pass0();
+
+	// every label is known now, so forward references can be patched
+	{
+		scopedTimer fixups("fixups");
+		_cpu.resolveFixups();
+	}
+
+	if (_cpu.writesDecoderRom())
+		_cpu.writeDecoderRom(*this, outputBasename());
+
+	if (_cpu.writesProgramRom())
+		_cpu.writeProgramRom(*this, outputBasename());
+
+	if (_cycle_listing)
+		writeCycleListing();
+}
+
+void assembler::writeCycleListing()
+{
+	scopedTimer timer("cycles");
+
+	cycleEstimator estimator(_cpu);
+	for (const cycleEstimator::sourceLine& line : _listingLines)
+		estimator.addLine(line);
+
+	estimator.analyze();
+
+	std::string filename = outputBasename() + CYCLES_EXTENSION;
+	std::ofstream file(filename);
+	if (!file)
+	{
+		std::stringstream msg;
+		msg << "Could not write cycle listing [" << filename << "]!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	estimator.writeListing(file, _startFile);
+
+	if (_echo_major_tasks)
+		out() << "\n-- writing cycle listing: " << dec << estimator.numInstructions() << " instruction(s) in " << estimator.numBlocks()
+			<< " block(s) to " << filename << "\n";
+}
+
+objectFile assembler::buildObject()
+{
+	scopedTimer timer("assemble");
+
+	_cpu.setObjectMode(true);
+	assembly_pass0();
+
+	// labels this unit doesn't define are left for the linker
+	{
+		scopedTimer fixups("fixups");
+		_cpu.resolveFixups();
+	}
+
+	objectFile o = _cpu.buildObject();
+	for (const auto& entry : _sources)
+		o.sources.push_back({ entry.first, hashContents(entry.second->contents()) });
+
+	return o;
+}
+
+std::string assembler::compile()
+{
+	objectFile o = buildObject();
+	std::string objFile = outputBasename() + OBJECT_EXTENSION;
+
+	scopedTimer output("output");
+	if (!o.save(objFile))
+	{
+		std::stringstream msg;
+		msg << "Could not write object file [" << objFile << "]!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	if (_echo_major_tasks)
+		out() << "\n-- writing object: " << dec << o.sections.size() << " section(s), " << o.symbols.size() << " symbol(s), "
+			<< o.relocations.size() << " relocation(s) to " << objFile << "\n";
+
+	return objFile;
+}
+
+// rom images are written next to the start file, named after it without its extension
+std::string assembler::outputBasename() const
+{
+	size_t dot = _startFile.find_last_of('.');
+	size_t slash = _startFile.find_last_of("/\\");
+
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return _startFile;
+
+	return _startFile.substr(0, dot);
 }
 
 void assembler::assembly_pass0()
 {
-	pushFileToStack(_startFile);
+	pushFile(_startFile);
+
+	processFiles();
+}
+
+void assembler::addIncludePath(const std::string& path)
+{
+	_includePaths.push_back(path);
+}
+
+const std::string& assembler::currentFile() const
+{
+	assert(!_includeStack.empty());
+	return _includeStack.back().file->name();
+}
+
+// Look for an include next to the file that includes it, then along the search path. Files that are
+// already loaded are matched by path without touching the disk again.
+std::optional<std::string> assembler::resolveInclude(const std::string& filename) const
+{
+	namespace fs = std::filesystem;
+
+	fs::path name(filename);
+	std::vector<fs::path> candidates;
+
+	if (name.is_absolute())
+	{
+		candidates.push_back(name);
+	}
+	else
+	{
+		// with no file being processed yet, the name is taken as it is
+		if (!_includeStack.empty())
+			candidates.push_back(fs::path(currentFile()).parent_path() / name);
+		else
+			candidates.push_back(name);
+
+		for (const std::string& dir : _includePaths)
+			candidates.push_back(fs::path(dir) / name);
+	}
+
+	for (const fs::path& candidate : candidates)
+	{
+		std::string path = candidate.lexically_normal().string();
 
-	_cmds.clear();
-	_cmds.insert(_cmds.end(), { ".include", INSTRUCTION_WIDTH_STR, ADDRESS_WIDTH_STR,
-		                        DECODER_ROM_STR, PROGRAM_ROM_STR, REGISTER_STR,
-								FLAG_STR, DEVICE_STR, CONTROL_STR, OPCODE_STR, OPCODE_ALIAS_STR,
-								OPCODE_SEQ_STR, OPCODE_SEQ_IF_STR, OPCODE_SEQ_ELSE_STR });
+		std::error_code ec;
+		if (_sources.count(path) > 0 || fs::is_regular_file(candidate, ec))
+			return path;
+	}
 
-	processFile();
+	return { };
 }
 
-void assembler::pushFileToStack(const std::string& filename)
+// Architecture files are loaded from their snapshot when there is a valid one. Otherwise the file is
+// parsed as usual, and a snapshot gets saved when it reaches its end.
+void assembler::includeFile(const std::string& filename, int line)
 {
-	_filestack.push(filename);
+	auto path = resolveInclude(filename);
+	if (!path.has_value())
+	{
+		std::stringstream msg;
+		msg << "Include at line <" << line << ">! Could not find [" << filename << "]!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	if (_includeOnce.count(path.value()) > 0)
+	{
+		if (_echo_minor_tasks)
+			out() << "          *** Skipping " << path.value() << " -- already included once\n";
+
+		return;
+	}
+
+	bool isArch = isArchitectureFile(path.value());
+
+	if (isArch && !_sharedArchFile.empty())
+	{
+		std::error_code ec;
+		if (!std::filesystem::equivalent(path.value(), _sharedArchFile, ec))
+		{
+			std::stringstream msg;
+			msg << "Include at line <" << line << ">! [" << path.value() << "] is not the architecture this unit is assembled against ["
+				<< _sharedArchFile << "]!";
+			throw std::exception(msg.str().c_str());
+		}
+
+		if (_echo_minor_tasks)
+			out() << "          *** Skipping " << path.value() << " -- the architecture is already loaded\n";
+
+		return;
+	}
+
+	for (const includeFrame& frame : _includeStack)
+	{
+		if (frame.file->name() == path.value())
+		{
+			std::stringstream msg;
+			msg << "Include at line <" << line << ">! [" << path.value() << "] includes itself!";
+			throw std::exception(msg.str().c_str());
+		}
+	}
+
+	if (isArch && _use_arch_snapshots && !_recording_arch && !_cpu.hasArchitecture())
+	{
+		std::string snapFile = path.value() + SNAPSHOT_EXTENSION;
+		scopedTimer timer("snapshot", "load");
+
+		_archFile = path.value();
+		_archSources.clear();
+
+		if (loadArchSnapshot(snapFile, _cpu, &_archSources))
+		{
+			if (_echo_major_tasks)
+				out() << "\n-- loaded architecture snapshot: " << snapFile << "\n";
+
+			return;
+		}
+
+		_recording_arch = true;
+		_archSources.clear();
+		_archProgramSize = _cpu.programSize();
+		_archAddress = _cpu.getAddress();
+	}
+
+	pushFile(path.value());
 }
 
-void assembler::processFile()
+std::string assembler::loadArchitecture(const std::string& archFile)
 {
-	if (_file.is_open()) _file.close();
-	std::string currname = _filestack.currName();
-	_file.open(currname);
+	auto path = resolveInclude(archFile);
+	if (!path.has_value())
+	{
+		std::stringstream msg;
+		msg << "Could not find architecture file [" << archFile << "]!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	includeFile(path.value(), 0);
+	processFiles();
+
+	// units only copy the architecture, the same as a snapshot holds it
+	if (_cpu.programSize() != 0 || _cpu.getAddress() != 0)
+	{
+		std::stringstream msg;
+		msg << "Architecture [" << path.value() << "] holds labels, variables, constants or code, which can't be shared between units!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	return path.value();
+}
+
+void assembler::shareArchitecture(const cpu& architecture, const std::string& archFile)
+{
+	if (!_cpu.copyArchitecture(architecture))
+	{
+		std::stringstream msg;
+		msg << "Could not share architecture [" << archFile << "]! [" << _startFile << "] already has one!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	_sharedArchFile = archFile;
+}
+
+// every file reachable from the start file in the include graph, the start file included
+std::set<std::string> assembler::dependencies() const
+{
+	std::set<std::string> files;
+	std::vector<std::string> pending = { std::string() };
+
+	while (!pending.empty())
+	{
+		auto i = _includeGraph.find(pending.back());
+		pending.pop_back();
+
+		if (i == _includeGraph.end())
+			continue;
+
+		for (const std::string& f : i->second)
+			if (files.insert(f).second)
+				pending.push_back(f);
+	}
+
+	return files;
+}
+
+bool assembler::isArchitectureFile(const std::string& path)
+{
+	return path.size() > std::strlen(ARCH_EXTENSION) &&
+		path.compare(path.size() - std::strlen(ARCH_EXTENSION), std::string::npos, ARCH_EXTENSION) == 0;
+}
+
+// true anywhere inside an architecture file, including the files it includes
+bool assembler::inArchitectureFile() const
+{
+	for (const includeFrame& frame : _includeStack)
+		if (isArchitectureFile(frame.file->name()))
+			return true;
+
+	return false;
+}
+
+// .once -- the current file is skipped by any later include
+void assembler::markIncludeOnce()
+{
+	_includeOnce.insert(currentFile());
+}
+
+// Load a file (or find it in the cache) and make it the one being processed. Its lines are picked up
+// by processFiles, which keeps going with the parent once this file runs out.
+void assembler::pushFile(const std::string& path)
+{
+	std::unique_ptr<sourcefile>& source = _sources[path];
+	if (!source)
+	{
+		scopedTimer timer("load");
+
+		source = std::make_unique<sourcefile>();
+		if (!source->open(path))
+		{
+			_sources.erase(path);
+
+			std::stringstream msg;
+			msg << "Could not open file [" << path << "]!";
+			throw std::exception(msg.str().c_str());
+		}
+	}
 
 	if (_echo_major_tasks)
-		std::cout << "\n-- processing file: " << currname << "\n";
+		out() << "\n-- processing file: " << path << "\n";
 
-	std::string line;
-	_lineNumber = 0;
+	if (_recording_arch && std::find(_archSources.begin(), _archSources.end(), path) == _archSources.end())
+		_archSources.push_back(path);
+
+	// the include graph -- the start file (and an architecture loaded on its own) has no parent
+	_includeGraph[_includeStack.empty() ? std::string() : currentFile()].insert(path);
+
+	_includeStack.push_back({ source.get(), 0, 0 });
+}
 
-	try
+void assembler::popFile()
+{
+	const std::string& name = currentFile();
+
+	if (_recording_arch && name == _archFile)
 	{
-		while (std::getline(_file, line))
+		_recording_arch = false;
+
+		std::string snapFile = _archFile + SNAPSHOT_EXTENSION;
+		scopedTimer timer("snapshot", "save");
+
+		// a snapshot only holds the architecture, so loading one would lose any program code in it
+		if (_cpu.programSize() != _archProgramSize || _cpu.getAddress() != _archAddress)
 		{
-			int startLine = _filestack.getLine();
-			if (startLine < _lineNumber && _filestack.processingNewFile())
-				_lineNumber = startLine;
-
-			if (startLine != 0 && _lineNumber < startLine)
-			{
-				_lineNumber++;
-				continue;
-			}
-
-			if (_echo_source)
-				std::cout << "     ==> source line #" << _lineNumber << " = " << line << "\n";
-			
-			// remove any comments and extract token
-			parser::instance().strip_comment(line);
-			auto token = parser::instance().extract_token_ws(line);
-			std::string tokenString = "";
+			if (_echo_warnings)
+				out() << "          *** Warning: not writing architecture snapshot [" << snapFile << "] -- " << _archFile
+					<< " holds labels, variables, constants or code\n";
+		}
+		else if (!saveArchSnapshot(snapFile, _cpu, _archSources) && _echo_warnings)
+		{
+			out() << "          *** Warning: could not write architecture snapshot [" << snapFile << "]\n";
+		}
+	}
+
+	_includeStack.pop_back();
+}
+
+void assembler::processFiles()
+{
+	// Lines are views into the loaded file, so nothing is copied until a line turns out to hold a command
+	while (!_includeStack.empty())
+	{
+		includeFrame& frame = _includeStack.back();
+
+		auto line = frame.file->nextLine(frame.cursor);
+		if (!line.has_value())
+		{
+			// end of file -- the parent picks up right where it left off
+			popFile();
+			continue;
+		}
+
+		// an include pushes a new frame, so don't hold on to this one past here
+		_lineNumber = frame.line++;
+		stats::instance().count(StatCounter::Lines);
+
+		if (_echo_source)
+			out() << "     ==> source line #" << _lineNumber << " = " << line.value() << "\n";
+
+		// remove any comments and extract token
+		std::string_view remainder = line.value();
+		std::optional<std::string_view> token;
+		Keyword k = Keyword::None;
+		{
+			scopedTimer timer("tokenize");
+
+			_parser.strip_comment(remainder);
+			token = _parser.extract_token_ws(remainder);
 
 			if (token.has_value())
-				tokenString = std::string(token.value());
-			
-			for (std::string command : _cmds)
-			{
-				if (tokenString == command)
-					_cpu.processCommand(*this, token, line, _lineNumber);
-			}
-
-			_lineNumber++;
+				k = lookupKeyword(token.value());
 		}
+
+		if (!token.has_value())
+			continue;
+
+		processStatement(k, token.value(), remainder);
+	}
+}
+
+// One statement -- the start of a line, or whatever follows a label on it
+void assembler::processStatement(Keyword k, std::string_view token, std::string_view remainder)
+{
+	if (k != Keyword::None)
+	{
+		_cpu.processCommand(*this, k, token, std::string(remainder), _lineNumber);
 	}
-	catch (const std::ifstream::failure& e)
+	else if (_parser.is_directive(token))
 	{
-		if (!_file.eof())
+		// only handle registered directives
+		std::stringstream msg;
+		msg << "Unknown directive at line <" << _lineNumber << ">! Found ["
+			<< token << "]";
+		throw std::exception(msg.str().c_str());
+	}
+	else
+	{
+		processProgramLine(token, remainder);
+	}
+}
+
+// Anything that isn't a keyword is program code: an optional label, then an instruction. Other
+// punctuation (braces, #region markers) is left alone.
+void assembler::processProgramLine(std::string_view token, std::string_view remainder)
+{
+	if (token.back() == LABEL_KEY)
+	{
+		std::string_view name = token.substr(0, token.size() - 1);
+
+		if (!_parser.is_command(name) || _cpu.getSymbolType(name) != SymbolType::None)
 		{
-			throw e;
+			std::stringstream msg;
+			msg << "Bad label at line <" << _lineNumber << ">! [" << name << "] is not a valid name or is already defined!";
+			throw std::exception(msg.str().c_str());
 		}
-		else
+
+		_cpu.addLabel(name, _cpu.getAddress(), _lineNumber);
+
+		if (_cycle_listing)
+			_listingLines.push_back({ currentFile(), _lineNumber, token, name, _cpu.getActiveSegment(), _cpu.getAddress(), 0 });
+
+		if (_echo_parsed_major)
+			out() << "          *** Label " << name << " = $" << hex4 << _cpu.getAddress() << "\n";
+
+		// an instruction, a directive or another label may follow on the same line
+		auto next = _parser.extract_token_ws(remainder);
+		if (!next.has_value())
+			return;
+
+		Keyword k = lookupKeyword(next.value());
+		if (k == Keyword::None && !_parser.is_directive(next.value()) && !_cpu.isAMnemonic(next.value()) && next.value().back() != LABEL_KEY)
 		{
-			if (_file.is_open()) _file.close();
+			std::stringstream msg;
+			msg << "Unknown instruction at line <" << _lineNumber << ">! Found [" << next.value() << "] after label [" << name << "]";
+			throw std::exception(msg.str().c_str());
+		}
 
-			if (!_filestack.hasNullParent())
-			{
-				_filestack.makeParentActive();
-				processFile();
-			}
+		processStatement(k, next.value(), remainder);
+		return;
+	}
+
+	if (_cpu.isAMnemonic(token))
+	{
+		int address = _cpu.getAddress();
+		_cpu.processInstruction(*this, token, std::string(remainder), _lineNumber);
+
+		// the instruction as written, without the label or comment around it
+		if (_cycle_listing)
+		{
+			std::string_view text(token.data(), remainder.data() + remainder.size() - token.data());
+			while (!text.empty() && isspace(static_cast<unsigned char>(text.back())))
+				text.remove_suffix(1);
+
+			_listingLines.push_back({ currentFile(), _lineNumber, text, { }, _cpu.getActiveSegment(), address, _cpu.getAddress() - address });
 		}
 	}
+	else if (_parser.is_command(token))
+	{
+		std::stringstream msg;
+		msg << "Unknown instruction at line <" << _lineNumber << ">! Found [" << token << "]";
+		throw std::exception(msg.str().c_str());
+	}
 }
 
 void assembler::setEcho(unsigned char e)
@@ -1,14 +1,20 @@
 #pragma once
 
 #include "cpu.h"
-#include "filestack.h"
+#include "sourcefile.h"
 #include "command.h"
+#include "parser.h"
+#include "object.h"
+#include "cycles.h"
+#include "keyword.h"
 
-#include <fstream>
 #include <string>
 #include <vector>
 #include <optional>
 #include <map>
+#include <set>
+#include <memory>
+#include <iostream>
 #include <assert.h>
 
 class assembler
@@ -19,8 +25,46 @@ public:
 	void assemble();
 	void assembly_pass0();
 
-	void pushFileToStack(const std::string& filename);
-	void processFile();
+	// Assemble into a relocatable object instead of program roms (see object.h). Returns the object
+	// file, written next to the start file.
+	std::string compile();
+
+	std::string outputBasename() const;
+
+	// Include stuff -- an include is looked for next to the including file first, then along the
+	// search path in the order the paths were added
+	void addIncludePath(const std::string& path);
+	void includeFile(const std::string& filename, int line);
+	void markIncludeOnce();
+	const std::string& currentFile() const;
+	bool inArchitectureFile() const;
+
+	void processStatement(Keyword k, std::string_view token, std::string_view remainder);
+	void processProgramLine(std::string_view token, std::string_view remainder);
+
+	// Every assembler has its own parser, so separate units can be assembled on separate threads
+	parser& getParser() { return _parser; }
+
+	// Units shared between many programs -- the architecture is parsed once, on its own, and each unit
+	// copies it instead of parsing it again. Returns the architecture file as resolved.
+	std::string loadArchitecture(const std::string& archFile);
+	void shareArchitecture(const cpu& architecture, const std::string& archFile);
+
+	// Where the echo goes -- stdout unless set, but a unit assembled on a worker thread gets a buffer
+	// of its own so its output can't interleave with anyone else's
+	void setOutput(std::ostream& o) { _out = &o; }
+	std::ostream& out() { return *_out; }
+
+	// Include graph -- every file that was processed, keyed by the file that included it (the empty
+	// name for the start file). An architecture loaded from its snapshot isn't in it, but its files
+	// are listed in architectureSources.
+	const std::map<std::string, std::set<std::string>>& includeGraph() const { return _includeGraph; }
+	std::set<std::string> dependencies() const;
+	const std::string& architectureFile() const { return _archFile; }
+	const std::vector<std::string>& architectureSources() const { return _archSources; }
+
+	// Object stuff -- compile writes the object to disk, buildObject just hands it back
+	objectFile buildObject();
 
 	// Echo stuff
 	void setEcho(unsigned char e);
@@ -33,15 +77,63 @@ public:
 	bool echoParsedMinor() { return _echo_parsed_minor; }
 	bool echoRomData() { return _echo_rom_data; }
 
+	// Architecture snapshots -- on by default
+	void setArchSnapshots(bool enable) { _use_arch_snapshots = enable; }
+
+	// Cycle listing -- assemble also writes name.cycles.lst, with the clock cycles of every line, block
+	// and label of the program (see cycles.h). Off by default.
+	void setCycleListing(bool enable) { _cycle_listing = enable; }
+
+private:
+	std::optional<std::string> resolveInclude(const std::string& filename) const;
+	void pushFile(const std::string& path);
+	void popFile();
+	void processFiles();
+
+	static bool isArchitectureFile(const std::string& path);
+
+	void writeCycleListing();
+
 private:
 	cpu& _cpu;
+	parser _parser;
+	std::ostream* _out = &std::cout;
 
-	std::ifstream _file;
-	filestack _filestack;
 	std::string _startFile;
 	int _lineNumber = -1;
 
-	std::vector<std::string> _cmds;
+	// include stuff -- every file is loaded once and cached by its resolved path. The files being
+	// processed form an explicit stack, each with its own cursor into the cached contents, so an
+	// include never causes its parent to be read again.
+	struct includeFrame
+	{
+		const sourcefile* file;
+		size_t cursor;
+		int line;
+	};
+
+	std::map<std::string, std::unique_ptr<sourcefile>> _sources;
+	std::vector<includeFrame> _includeStack;
+	std::set<std::string> _includeOnce;
+	std::vector<std::string> _includePaths;
+	std::map<std::string, std::set<std::string>> _includeGraph;
+
+	// architecture snapshot stuff -- while an architecture file is being parsed, every file opened
+	// is recorded so the snapshot can be checked against all of them later, and the program size
+	// and address are kept to tell whether the file held any program
+	bool _use_arch_snapshots = true;
+	bool _recording_arch = false;
+	size_t _archProgramSize = 0;
+	int _archAddress = 0;
+	std::string _archFile;
+	std::vector<std::string> _archSources;
+
+	// the architecture file when the cpu was given a shared architecture -- includes of it are skipped
+	std::string _sharedArchFile;
+
+	// cycle listing stuff -- the program lines, recorded as they are assembled
+	bool _cycle_listing = false;
+	std::vector<cycleEstimator::sourceLine> _listingLines;
 
 	// echo stuff
 	bool _echo_architecture = false;
@@ -10,8 +10,8 @@ class command
 {
 public:
 	virtual ~command() {};
-	virtual void process(class assembler& a, class cpu& c, const std::string& d, std::string remainder, int line) const {}
-	virtual void process(class assembler& a, class cpu& c, std::string& line, int value0, int value1, int startAddress) const {}
+	virtual void process(class assembler&, class cpu&, const std::string&, std::string, int) const {}
+	virtual void process(class assembler&, class cpu&, std::string&, int, int, int) const {}
 };
 
 class commandAlias : public command
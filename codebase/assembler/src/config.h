@@ -9,8 +9,19 @@ constexpr const char COMMENT_KEY = ';';
 constexpr const char DIRECTIVE_KEY = '.';
 constexpr const char INDIRECT_BEGIN_KEY = '[';
 constexpr const char INDIRECT_END_KEY = ']';
+constexpr const char LABEL_KEY = ':';
+
+constexpr const char* ARCH_EXTENSION = ".arch";
+constexpr const char* SNAPSHOT_EXTENSION = ".snap";
+constexpr const char* OBJECT_EXTENSION = ".obj";
+constexpr const char* CYCLES_EXTENSION = ".cycles.lst";
 
 constexpr const char* INCLUDE_STR = "include";
+constexpr const char* ONCE_STR = "once";
+constexpr const char* ORG_STR = "org";
+constexpr const char* BYTE_STR = "byte";
+constexpr const char* WORD_STR = "word";
+constexpr const char* EQU_STR = "equ";
 
 constexpr const char* REGISTER_STR = "register";
 constexpr const char* FLAG_STR = "flag";
@@ -1,6 +1,14 @@
 #include "cpu.h"
 #include "archtag.h"
 #include "directive.h"
+#include "instruction.h"
+#include "stats.h"
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
 
 cpu::cpu()
 {
@@ -9,54 +17,136 @@ cpu::cpu()
 
 void cpu::registerOperations()
 {
-	registerDirective<includeDirective>(INCLUDE_STR);
+	registerDirective<includeDirective>(Keyword::Include);
+	registerDirective<onceDirective>(Keyword::Once);
+	registerDirective<orgDirective>(Keyword::Org);
+	registerDirective<dataDirective>(Keyword::Byte);
+	registerDirective<dataDirective>(Keyword::Word);
+	registerDirective<equDirective>(Keyword::Equ);
 
-	registerArchTag<archBitWidth>(INSTRUCTION_WIDTH_STR);
-	registerArchTag<archBitWidth>(ADDRESS_WIDTH_STR);
-	registerArchTag<archRom>(DECODER_ROM_STR);
-	registerArchTag<archRom>(PROGRAM_ROM_STR);
-	registerArchTag<archRegister>(REGISTER_STR);
-	registerArchTag<archFlagDevice>(FLAG_STR);
-	registerArchTag<archFlagDevice>(DEVICE_STR);
-	registerArchTag<archControlLine>(CONTROL_STR);
-	registerArchTag<archOpcode>(OPCODE_STR);
-	registerArchTag<archOpcode>(OPCODE_ALIAS_STR);
-	registerArchTag<archOpcodeSeq>(OPCODE_SEQ_STR);
-	registerArchTag<archOpcodeSeq>(OPCODE_SEQ_IF_STR);
-	registerArchTag<archOpcodeSeq>(OPCODE_SEQ_ELSE_STR);
+	registerArchTag<archBitWidth>(Keyword::InstructionWidth);
+	registerArchTag<archBitWidth>(Keyword::AddressWidth);
+	registerArchTag<archRom>(Keyword::DecoderRom);
+	registerArchTag<archRom>(Keyword::ProgramRom);
+	registerArchTag<archRegister>(Keyword::Register);
+	registerArchTag<archFlagDevice>(Keyword::Flag);
+	registerArchTag<archFlagDevice>(Keyword::Device);
+	registerArchTag<archControlLine>(Keyword::Control);
+	registerArchTag<archOpcode>(Keyword::Opcode);
+	registerArchTag<archOpcode>(Keyword::OpcodeAlias);
+	registerArchTag<archOpcodeSeq>(Keyword::Seq);
+	registerArchTag<archOpcodeSeq>(Keyword::SeqIf);
+	registerArchTag<archOpcodeSeq>(Keyword::SeqElse);
 }
 
-void cpu::processCommand(assembler& a, std::optional<std::string> token, std::string remainder, int lineNum)
+void cpu::processCommand(assembler& a, Keyword k, std::string_view token, std::string remainder, int lineNum)
 {
-	if (parser::instance().is_command(token.value()))
+	// directives are handed their name without the directive symbol
+	if (token.front() == DIRECTIVE_KEY)
+		token.remove_prefix(1);
+
+	scopedTimer timer("command", token);
+
+	const std::unique_ptr<command>& c = _keywords[static_cast<size_t>(k)];
+	if (!c)
 	{
-		/*	if (_symbols.count(token.value()) > 0)
+		std::stringstream msg;
+		msg << "Unknown command at line <" << lineNum << ">! Found [" << token << "]";
+		throw std::exception(msg.str().c_str());
+	}
+
+	c->process(a, *this, std::string(token), std::move(remainder), lineNum);
+}
+
+void cpu::processInstruction(assembler& a, std::string_view mnemonic, std::string remainder, int lineNum)
 {
-	std::stringstream msg;
-	msg << "Found a symbol at line <" << linenum << ">! Symbol [" << token.value() << "] already exists!";
-	throw std::exception(msg.str().c_str());
+	scopedTimer timer("instruction");
+
+	auto i = _instructions.find(mnemonic);
+	if (i == _instructions.end())
+	{
+		std::stringstream msg;
+		msg << "Unknown instruction at line <" << lineNum << ">! Found [" << mnemonic << "]";
+		throw std::exception(msg.str().c_str());
+	}
+
+	i->second->process(a, *this, std::string(mnemonic), std::move(remainder), lineNum);
 }
-else*/
-		if (_archtags.count(token.value()) > 0)
-		{
-			_archtags[token.value()]->process(a, *this, token.value(), remainder, lineNum);
-		}
+
+void cpu::emitValue(int value, int width)
+{
+	for (int b = 0; b < width; b++)
+		addByteToProgramRom(static_cast<int8_t>((value >> (8 * b)) & 0xFF));
+}
+
+void cpu::emitSymbol(std::string_view name, int width, int line)
+{
+	int id = _symbols.intern(name);
+	SymbolType t = _symbols.get(id).getType();
+
+	if (t != SymbolType::None && t != SymbolType::Label && t != SymbolType::Constant && t != SymbolType::Variable)
+	{
+		std::stringstream msg;
+		msg << "Symbol [" << name << "] at line <" << line << "> can't be used as a value!";
+		throw std::exception(msg.str().c_str());
 	}
-	else if (parser::instance().is_directive(token.value()))
+
+	int value;
+	if (t != SymbolType::None && symbolValue(id, false, value))
 	{
-		// strip off the directive symbol
-		token.value().erase(token.value().begin(), token.value().begin() + 1);
+		int target = _objectMode ? relocatableSection(id) : -1;
+		if (target >= 0)
+			addRelocation(currentSection(), _address, width, "", target);
 
-		// only handle registered directives
-		if (_directives.count(token.value()) == 0)
+		emitValue(value, width);
+		return;
+	}
+
+	// not known yet (a label further on, or an equate that uses one) -- reserve the bytes and patch
+	// them once every label is known
+	_fixups.push_back({ id, _activeSegmentIndex, _address, width, line, _objectMode ? currentSection() : -1 });
+	emitValue(0, width);
+}
+
+void cpu::resolveFixups()
+{
+	resolveEquates();
+
+	int activeSegment = _activeSegmentIndex;
+
+	for (const fixup& f : _fixups)
+	{
+		const symbol& s = _symbols.get(f.symbol);
+		SymbolType t = s.getType();
+
+		// in object mode, another unit may define it -- the linker fills it in
+		if (_objectMode && t == SymbolType::None)
+		{
+			addRelocation(f.section, f.address, f.width, std::string(s.getName()), -1);
+			continue;
+		}
+
+		if (t != SymbolType::Label && t != SymbolType::Constant && t != SymbolType::Variable)
 		{
 			std::stringstream msg;
-			msg << "Unknown directive at line <" << lineNum << ">! Found [."
-				<< token.value() << "]";
+			msg << "Undefined symbol [" << s.getName() << "] referenced at line <" << f.line << ">!";
 			throw std::exception(msg.str().c_str());
 		}
-		_directives[token.value()]->process(a, *this, token.value(), std::move(remainder), lineNum);
+
+		int value;
+		symbolValue(f.symbol, true, value);
+
+		int target = _objectMode ? relocatableSection(f.symbol) : -1;
+		if (target >= 0)
+			addRelocation(f.section, f.address, f.width, "", target);
+
+		_activeSegmentIndex = f.segment;
+		for (int b = 0; b < f.width; b++)
+			addByteToProgramRom(static_cast<int8_t>((value >> (8 * b)) & 0xFF), f.address + b);
 	}
+
+	_activeSegmentIndex = activeSegment;
+	_fixups.clear();
 }
 
 void cpu::setAddress(int a)
@@ -67,6 +157,24 @@ void cpu::setAddress(int a)
 		_max_address = _address;
 }
 
+void cpu::setOrigin(int a, int line)
+{
+	if (_objectMode)
+	{
+		if (_currentSection >= 0 && _sections[_currentSection].relocatable)
+		{
+			std::stringstream msg;
+			msg << "Processing directive ." << ORG_STR << " at line <" << line << ">! Code or labels before it went into a relocatable section, so this unit can't be placed with ." << ORG_STR << "!";
+			throw std::exception(msg.str().c_str());
+		}
+
+		_sections.push_back({ _activeSegmentIndex, a, a, false });
+		_currentSection = static_cast<int>(_sections.size()) - 1;
+	}
+
+	setAddress(a);
+}
+
 void cpu::addDecoderRom(bool write, int inputs, int outputs)
 {
 	_write_decode_rom = write;
@@ -74,29 +182,318 @@ void cpu::addDecoderRom(bool write, int inputs, int outputs)
 	_out_bits_decode = outputs;
 }
 
-void cpu::addProgramRom(bool write, int inputs, int outputs)
+// Work out how the decoder rom address is split between opcode, cycle and flags
+decoderRomLayout cpu::getDecoderRomLayout() const
+{
+	decoderRomLayout layout;
+	layout.opcodeBits = _instructionWidth * 8;
+	layout.flagBits = _nFlags;
+
+	while ((1 << layout.cycleBits) < _maxNumCycles)
+		layout.cycleBits++;
+
+	int used = layout.opcodeBits + layout.cycleBits + layout.flagBits;
+	if (used > _in_bits_decode)
+	{
+		std::stringstream msg;
+		msg << "Decoder rom has " << _in_bits_decode << " inputs, but needs " << used << " (" << layout.opcodeBits
+			<< " opcode + " << layout.cycleBits << " cycle + " << layout.flagBits << " flag bits)!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	if (_maxOpcodeValue >= (1 << layout.opcodeBits))
+	{
+		std::stringstream msg;
+		msg << "Opcode $" << hex2 << _maxOpcodeValue << " does not fit in the " << dec << layout.opcodeBits << "-bit instruction width!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	// control words only need as many bits as the highest control line used
+	uint32_t allLines = 0;
+	for (int a : _controlLineAddresses)
+		allLines |= static_cast<uint32_t>(a);
+
+	while (layout.wordBits < 32 && (allLines >> layout.wordBits) != 0)
+		layout.wordBits++;
+
+	layout.addressBits = _in_bits_decode;
+	layout.romBits = _out_bits_decode;
+	layout.romCount = layout.romBits > 0 ? (layout.wordBits + layout.romBits - 1) / layout.romBits : 0;
+
+	return layout;
+}
+
+// Fill the whole decoder rom image from the stored control patterns. Opcodes share most of their
+// cycles (see opcodetable.h), so each distinct cycle is expanded into a block once and then copied
+// into every opcode that uses it. Both steps write disjoint blocks, so they're spread over all cores
+// without any locking. Within a block, flag wildcards turn into runs of identical words that are
+// written with fill_n.
+std::vector<uint32_t> cpu::buildDecoderRom(const decoderRomLayout& layout) const
+{
+	std::vector<uint32_t> image(layout.entries(), 0);
+
+	std::vector<const opcode*> opcodes;
+	opcodes.reserve(_opcodes.size());
+	for (const opcode& oc : _opcodes)
+		opcodes.push_back(&oc);
+
+	const size_t cycleBlock = layout.cycleBlock();
+	const uint32_t flagMask = static_cast<uint32_t>(cycleBlock - 1);
+
+	std::vector<uint32_t> blocks(static_cast<size_t>(_opcodes.numDistinctCycles()) * cycleBlock, 0);
+
+	// returns how many flag states the cube covered
+	auto fillCube = [&](uint32_t* block, const flagCube& cube, uint32_t word) -> uint64_t
+	{
+		// the free bits below the lowest conditioned flag form one contiguous run
+		uint32_t freeBits = ~cube.mask & flagMask;
+		uint32_t run = 1;
+		while ((freeBits & run) != 0 && run < cycleBlock)
+			run <<= 1;
+
+		uint32_t highFree = freeBits & ~(run - 1);
+
+		// walk every subset of the remaining free bits
+		uint32_t sub = 0;
+		uint64_t filled = 0;
+		do
+		{
+			std::fill_n(block + (cube.value | sub), run, word);
+			sub = (sub - highFree) & highFree;
+			filled += run;
+		} while (sub != 0);
+
+		return filled;
+	};
+
+	auto fillCycle = [&](size_t id)
+	{
+		uint32_t* block = blocks.data() + id * cycleBlock;
+		const controlPatterns& cps = _opcodes.getDistinctCycle(static_cast<int>(id));
+		uint64_t expanded = 0;
+
+		// complemented sets (seq_else) go down first as a background for the conditions they
+		// complement; everything else overwrites only the states it matches
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (int p = 0; p < cps.count; p++)
+			{
+				const controlPattern& cp = cps.cpattern[p];
+				uint32_t word = static_cast<uint32_t>(cp.pattern);
+
+				if (cp.flags.complemented() != (pass == 0))
+					continue;
+
+				if (!cp.flags.complemented())
+				{
+					for (const flagCube& cube : cp.flags.cubes())
+						expanded += fillCube(block, cube, word);
+				}
+				else if (cps.count == 2 && cps.cpattern[1 - p].flags == cp.flags.complement())
+				{
+					std::fill_n(block, cycleBlock, word);
+					expanded += cycleBlock;
+				}
+				else
+				{
+					cp.flags.forEach(layout.flagBits, [&](uint32_t f) { block[f] = word; expanded++; });
+				}
+			}
+		}
+
+		stats::instance().count(StatCounter::FlagExpansions, expanded);
+	};
+
+	auto fillOpcode = [&](size_t i)
+	{
+		const opcode& oc = *opcodes[i];
+		uint32_t* base = image.data() + layout.address(oc.value(), 0, 0);
+
+		std::vector<int> ids;
+		_opcodes.cycleIds(oc, ids);
+
+		for (int c = 0; c < oc.numCycles(); c++)
+		{
+			const uint32_t* block = blocks.data() + ids[c] * cycleBlock;
+			std::copy(block, block + cycleBlock, base + c * cycleBlock);
+		}
+	};
+
+	auto forEachParallel = [](size_t count, const std::function<void(size_t)>& f)
+	{
+		std::atomic<size_t> next(0);
+		auto worker = [&]()
+		{
+			for (size_t i = next++; i < count; i = next++)
+				f(i);
+		};
+
+		size_t threadCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), count));
+		std::vector<std::thread> threads;
+		for (size_t t = 1; t < threadCount; t++)
+			threads.emplace_back(worker);
+
+		worker();
+
+		for (std::thread& t : threads)
+			t.join();
+	};
+
+	forEachParallel(static_cast<size_t>(_opcodes.numDistinctCycles()), fillCycle);
+	forEachParallel(opcodes.size(), fillOpcode);
+
+	return image;
+}
+
+void cpu::writeDecoderRom(assembler& a, const std::string& basename)
 {
-	int size = outputs * pow(2, inputs);
+	auto start = std::chrono::steady_clock::now();
+
+	decoderRomLayout layout = getDecoderRomLayout();
+
+	if (a.echoMajorTasks())
+	{
+		opcodeTable::sharingReport sharing = _opcodes.sharing();
+
+		a.out() << "\n-- writing decoder rom: " << layout.describe() << "\n";
+		a.out() << "   microcode: " << dec << sharing.opcodes << " opcodes, " << sharing.cycles << " cycles stored as "
+			<< sharing.distinctCycles << " distinct cycles and " << sharing.sequenceNodes << " sequence nodes\n";
+	}
+
+	std::vector<uint32_t> image;
+	{
+		scopedTimer timer("rom", "decoder");
+		image = buildDecoderRom(layout);
+	}
+
+	for (int r = 0; r < layout.romCount; r++)
+	{
+		std::string filename = basename + ".decoder" + std::to_string(r) + ".bin";
+		std::vector<uint8_t> slice = sliceRomImage(image, r * layout.romBits, layout.romBits);
+		writeRomImage(filename, slice);
+
+		if (a.echoMinorTasks())
+			a.out() << "          *** Wrote decoder rom bits [" << dec << (r + 1) * layout.romBits - 1 << ":" << r * layout.romBits << "] to " << filename << "\n";
+
+		if (a.echoRomData())
+		{
+			std::string dump = hexDumpRomImage(slice, layout.romBits <= 8 ? 1 : (layout.romBits <= 16 ? 2 : 4));
+			a.out().write(dump.data(), dump.size());
+		}
+	}
 
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+	if (a.echoMajorTasks())
+		a.out() << "   " << dec << layout.entries() << " entries generated in " << elapsed.count() << " ms\n";
+}
+
+void cpu::addProgramRom(bool write, int inputs, int outputs)
+{
 	_write_program_rom = write;
 	_in_bits_program = inputs;
 	_out_bits_program = outputs;
 }
 
-SymbolType cpu::getSymbolType(const std::string& n)
+void cpu::setActiveSegment(int i)
+{
+	_activeSegmentIndex = i;
+
+	if (_activeSegmentIndex >= static_cast<int>(_programSegments.size()))
+		_programSegments.resize(_activeSegmentIndex + 1);
+}
+
+// Bytes go straight into the active segment's contiguous buffer. Without an explicit address the
+// byte lands at the current address, which then moves past it.
+void cpu::addByteToProgramRom(int8_t byte, int address)
+{
+	if (_in_bits_program <= 0)
+		throw std::exception("Program code comes before any program_rom is declared!");
+
+	bool append = address == -1;
+	if (append)
+	{
+		address = _address;
+		setAddress(_address + 1);
+	}
+
+	if (address < 0 || address >= (1 << _in_bits_program))
+	{
+		std::stringstream msg;
+		msg << "Program rom address $" << hex4 << address << " is outside of the " << dec << _in_bits_program << "-bit program rom!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	if (_activeSegmentIndex >= static_cast<int>(_programSegments.size()))
+		_programSegments.resize(_activeSegmentIndex + 1);
+
+	std::vector<uint8_t>& segment = _programSegments[_activeSegmentIndex];
+	if (address >= static_cast<int>(segment.size()))
+	{
+		// grow geometrically so long runs of appends don't reallocate every time
+		if (segment.capacity() <= static_cast<size_t>(address))
+			segment.reserve(std::max<size_t>(address + 1, segment.capacity() * 2));
+
+		segment.resize(address + 1, 0);
+	}
+
+	segment[address] = static_cast<uint8_t>(byte);
+
+	if (_objectMode && append)
+	{
+		section& s = _sections[currentSection()];
+		s.end = std::max(s.end, address + 1);
+	}
+}
+
+// Each segment is flushed with a single write, and the optional hex dump is formatted into one
+// buffer before it goes to the console
+void cpu::writeProgramRom(assembler& a, const std::string& basename)
+{
+	for (int i = 0; i < static_cast<int>(_programSegments.size()); i++)
+	{
+		const std::vector<uint8_t>& segment = _programSegments[i];
+		if (segment.empty())
+			continue;
+
+		std::string filename = basename + ".program" + std::to_string(i) + ".bin";
+		writeRomImage(filename, segment);
+
+		if (a.echoMajorTasks())
+			a.out() << "\n-- writing program rom segment " << dec << i << ": " << segment.size() << " bytes to " << filename << "\n";
+
+		if (a.echoRomData())
+		{
+			std::string dump = hexDumpRomImage(segment);
+			a.out().write(dump.data(), dump.size());
+		}
+	}
+}
+
+SymbolType cpu::getSymbolType(std::string_view n) const
 {
-	std::map<std::string, symbol>::iterator i = _symbols.find(n);
+	int id = _symbols.find(n);
 
-	if (i != _symbols.end())
-		return (i->second).getType();
+	if (id >= 0)
+		return _symbols.get(id).getType();
 
 	return SymbolType::None;
 }
 
-int cpu::getSymbolAddress(const std::string& n) const
+int cpu::getSymbolAddress(std::string_view n, int line)
 {
-	auto i = _symbols.find(n);
-	return (i->second).getAddress();
+	int id = _symbols.find(n);
+	if (id < 0 || !_symbols.get(id).isDefined())
+	{
+		std::stringstream msg;
+		msg << "Undefined symbol [" << n << "] at line <" << line << ">!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	int value;
+	symbolValue(id, true, value);
+
+	return value;
 }
 
 const std::vector<int>& cpu::getSymbolAddresses(SymbolType t)
@@ -120,110 +517,791 @@ const std::vector<int>& cpu::getSymbolAddresses(SymbolType t)
 
 	case SymbolType::ControlLine:
 		return _controlLineAddresses;
+
+	default:
+		throw std::exception("Symbols of this type have no addresses!");
 	}
 }
 
-void cpu::addConstant(const std::string& n, int a, int l)
+// symbols of one type, in the order they were defined
+std::vector<const symbol*> cpu::getSymbols(SymbolType t) const
+{
+	std::vector<const symbol*> symbols;
+	for (const symbol& s : _symbols)
+		if (s.getType() == t)
+			symbols.push_back(&s);
+
+	std::stable_sort(symbols.begin(), symbols.end(), [](const symbol* a, const symbol* b) { return a->getLine() < b->getLine(); });
+	return symbols;
+}
+
+void cpu::addConstant(std::string_view n, int a, int l)
 {
-	_symbols.emplace(n, symbol::makeConstant(n, a, l));
+	stats::instance().count(StatCounter::Symbols);
+	int id = _symbols.intern(n);
+	_symbols.define(id, SymbolType::Constant, a, l);
 	_constantAddresses.push_back(a);
 }
 
-void cpu::addVariable(const std::string& n, int a, int l)
+void cpu::addVariable(std::string_view n, int a, int l)
 {
-	_symbols.emplace(n, symbol::makeVariable(n, a, l));
+	stats::instance().count(StatCounter::Symbols);
+	int id = _symbols.intern(n);
+	_symbols.define(id, SymbolType::Variable, a, l);
+
+	if (_objectMode)
+		setSymbolSection(id, currentSection());
+
 	_variableAddresses.push_back(a);
 }
 
-void cpu::addLabel(const std::string& n, int a, int l)
+void cpu::addLabel(std::string_view n, int a, int l)
 {
-	_symbols.emplace(n, symbol::makeLabel(n, a, l));
+	stats::instance().count(StatCounter::Symbols);
+	int id = _symbols.intern(n);
+	_symbols.define(id, SymbolType::Label, a, l);
+
+	if (_objectMode)
+		setSymbolSection(id, currentSection());
+
 	_labelAddresses.push_back(a);
 }
 
-void cpu::addRegister(const std::string& n, int a, int l)
+void cpu::addRegister(std::string_view n, int a, int l)
 {
-	_symbols.emplace(n, symbol::makeRegister(n, a, l));
+	stats::instance().count(StatCounter::Symbols);
+	int id = _symbols.intern(n);
+	_symbols.define(id, SymbolType::Register, a, l);
 	_registerAddresses.push_back(a);
 }
 
-void cpu::addFlag(const std::string& n, int a, int l)
+void cpu::addFlag(std::string_view n, int a, int l)
 {
-	_symbols.emplace(n, symbol::makeFlag(n, a, l));
+	stats::instance().count(StatCounter::Symbols);
+	int id = _symbols.intern(n);
+	_symbols.define(id, SymbolType::Flag, a, l);
 	_nFlags++;
 
 	_flagAddresses.push_back(a);
 }
 
-void cpu::addControlLine(const std::string& n, int a, int l)
+void cpu::addControlLine(std::string_view n, int a, int l)
 {
-	_symbols.emplace(n, symbol::makeControlLine(n, a, l));
+	stats::instance().count(StatCounter::Symbols);
+	int id = _symbols.intern(n);
+	_symbols.define(id, SymbolType::ControlLine, a, l);
 
 	_controlLineAddresses.push_back(a);
 
 	if (a > _maxControlLineValue) _maxControlLineValue = a;
 }
+
+void cpu::addEquate(std::string_view n, std::string_view text, int l, bool architecture)
+{
+	int id = _symbols.intern(n);
+	if (!_symbols.define(id, SymbolType::Constant, 0, l))
+	{
+		std::stringstream msg;
+		msg << "Symbol [" << n << "] at line <" << l << "> is already defined!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	stats::instance().count(StatCounter::Symbols);
+
+	equate e{ id, expression(), std::string(text), l, architecture, EquateState::Pending };
+
+	std::string error;
+	if (!e.value.compile(e.text, _symbols, error))
+	{
+		std::stringstream msg;
+		msg << "Bad expression for [" << n << "] at line <" << l << ">! " << error << "!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	if (id >= static_cast<int>(_equateIndex.size()))
+		_equateIndex.resize(id + 1, -1);
+
+	_equateIndex[id] = static_cast<int>(_equates.size());
+	_equates.push_back(std::move(e));
+}
+
+// The value of a symbol that stands for a number, working an equate out the first time it's needed.
+// Returns false when it isn't known yet -- a label further on, or an equate that uses one -- and
+// throws instead when required.
+bool cpu::symbolValue(int id, bool required, int& value)
+{
+	if (id < static_cast<int>(_equateIndex.size()) && _equateIndex[id] >= 0 && !resolveEquate(id, required))
+		return false;
+
+	value = _symbols.get(id).getAddress();
+	return true;
+}
+
+// Equates can be chained thousands deep in generated headers, so the walk over what an equate uses
+// keeps its own stack instead of recursing. Whatever it works out along the way is remembered.
+bool cpu::resolveEquate(int id, bool required)
+{
+	equate& root = _equates[_equateIndex[id]];
+	if (root.state == EquateState::Resolved)
+		return true;
+
+	struct frame
+	{
+		int equate;
+		size_t next;
+	};
+
+	std::vector<frame> stack = { { _equateIndex[id], 0 } };
+	root.state = EquateState::Resolving;
+
+	while (!stack.empty())
+	{
+		frame& f = stack.back();
+		equate& e = _equates[f.equate];
+		const std::vector<exprNode>& nodes = e.value.nodes();
+
+		// find the next symbol this one uses that still has to be worked out
+		int pending = -1;
+		for (; f.next < nodes.size() && pending < 0; f.next++)
+		{
+			if (nodes[f.next].op != ExprOp::Symbol)
+				continue;
+
+			int used = nodes[f.next].value;
+			const symbol& s = _symbols.get(used);
+
+			if (!s.isDefined())
+			{
+				// nothing on the stack can be worked out yet, so it's left to be tried again later
+				for (const frame& open : stack)
+					_equates[open.equate].state = EquateState::Pending;
+
+				if (!required)
+					return false;
+
+				std::stringstream msg;
+				msg << "Undefined symbol [" << s.getName() << "] used by [" << _symbols.get(e.symbol).getName() << "] at line <" << e.line << ">!";
+				throw std::exception(msg.str().c_str());
+			}
+
+			if (_objectMode && relocatableSection(used) >= 0)
+			{
+				std::stringstream msg;
+				msg << "Equate [" << _symbols.get(e.symbol).getName() << "] at line <" << e.line << "> uses [" << s.getName()
+					<< "], which moves when it's linked! Only absolute values can be used in object mode.";
+				throw std::exception(msg.str().c_str());
+			}
+
+			int index = used < static_cast<int>(_equateIndex.size()) ? _equateIndex[used] : -1;
+			if (index < 0 || _equates[index].state == EquateState::Resolved)
+				continue;
+
+			if (_equates[index].state == EquateState::Resolving)
+			{
+				std::stringstream msg;
+				msg << "Equate [" << _symbols.get(e.symbol).getName() << "] at line <" << e.line << "> depends on itself! ";
+
+				auto start = std::find_if(stack.begin(), stack.end(), [&](const frame& open) { return open.equate == index; });
+				for (auto i = start; i != stack.end(); ++i)
+					msg << _symbols.get(_equates[i->equate].symbol).getName() << " -> ";
+
+				msg << s.getName();
+				throw std::exception(msg.str().c_str());
+			}
+
+			pending = index;
+		}
+
+		if (pending >= 0)
+		{
+			// f and e aren't used past this point, as the push can move them
+			_equates[pending].state = EquateState::Resolving;
+			stack.push_back({ pending, 0 });
+			continue;
+		}
+
+		// everything it uses is known now
+		int value;
+		std::string error;
+		if (!e.value.evaluate([&](int used) { return _symbols.get(used).getAddress(); }, value, error))
+		{
+			std::stringstream msg;
+			msg << "Equate [" << _symbols.get(e.symbol).getName() << "] at line <" << e.line << "> " << error << "!";
+			throw std::exception(msg.str().c_str());
+		}
+
+		_symbols.setAddress(e.symbol, value);
+		_constantAddresses.push_back(value);
+		e.state = EquateState::Resolved;
+
+		stack.pop_back();
+	}
+
+	return true;
+}
+
+// every label is known by now, so any equate nothing has used yet gets its value (or its error) too
+void cpu::resolveEquates()
+{
+	for (const equate& e : _equates)
+		resolveEquate(e.symbol, true);
+}
  
 void cpu::addOpcode(int v, const opcode& oc)
 {
 	_lastOpcodeIndex = v;
-	_opcodes.emplace(v, oc);
-
 	if (v > _maxOpcodeValue) _maxOpcodeValue = v;
 
-	_mnemonics.push_back(_opcodes[v].mnemonic());
-	registerInstruction<archOpcode>(_opcodes[v].getUniqueString());
+	if (_opcodes.add(v, oc))
+		indexOpcode(*_opcodes.find(v), false);
+	else
+		stats::instance().count(StatCounter::Opcodes);
 }
 
 void cpu::addOpcodeAlias(int v, const opcode& oca)
 {
-	_opcode_aliases.emplace(v, oca);
+	if (_opcode_aliases.add(v, oca))
+		indexOpcode(*_opcode_aliases.find(v), true);
+	else
+		stats::instance().count(StatCounter::Opcodes);
+}
+
+// make an opcode that's in one of the tables findable by mnemonic and unique string
+void cpu::indexOpcode(const opcode& oc, bool alias)
+{
+	stats::instance().count(StatCounter::Opcodes);
 
-	_mnemonics.push_back(_opcode_aliases[v].mnemonic());
-	registerInstruction<archOpcode>(_opcode_aliases[v].getUniqueString());
+	if (_mnemonicIndex.count(oc.mnemonic()) == 0)
+		_mnemonicIndex.insert(storeSignature(oc.mnemonic()));
+
+	if (alias)
+		_opcodeAliasIndex.emplace(storeSignature(oc.getUniqueString()), oc.value());
+	else
+		_opcodeIndex.emplace(storeSignature(oc.getUniqueString()), oc.value());
+
+	registerInstruction<instructionCommand>(oc.mnemonic());
 }
 
-void cpu::addNewControlPatternToCurrentOpcode(controlPattern cp)
+// keep a copy of the string that the lookup indices can safely point into
+std::string_view cpu::storeSignature(const std::string& s)
 {
-	_opcodes[_lastOpcodeIndex].addNewControlPattern(cp);
-	if (_opcodes[_lastOpcodeIndex].numCycles() > _maxNumCycles) _maxNumCycles = _opcodes[_lastOpcodeIndex].numCycles();
+	_signatures.push_back(s);
+	return _signatures.back();
 }
 
-void cpu::addToLastControlPatternInCurrentOpcode(controlPattern cp)
+void cpu::addNewControlPatternToCurrentOpcode(const controlPattern& cp)
 {
-	_opcodes[_lastOpcodeIndex].addToLastControlPattern(cp);
+	_opcodes.addCycle(_lastOpcodeIndex, cp);
+
+	int cycles = _opcodes.find(_lastOpcodeIndex)->numCycles();
+	if (cycles > _maxNumCycles) _maxNumCycles = cycles;
 }
 
-bool cpu::isAMnemonic(const std::string& s)
+void cpu::addToLastControlPatternInCurrentOpcode(const controlPattern& cp)
 {
-	return std::find(_mnemonics.begin(), _mnemonics.end(), s) != _mnemonics.end();
+	_opcodes.addToLastCycle(_lastOpcodeIndex, cp);
 }
 
-opcode& cpu::getOpcode(int v)
+bool cpu::isAMnemonic(std::string_view s)
 {
-	return _opcodes[v];
+	return _mnemonicIndex.count(s) > 0;
 }
 
-int cpu::getValueByUniqueOpcodeString(const std::string& m)
+// returns -1 when no opcode has the given unique string
+int cpu::getValueByUniqueOpcodeString(std::string_view m)
 {
-	for (auto it = _opcodes.begin(); it != _opcodes.end(); ++it)
-		if (it->second.getUniqueString() == m)
-			return it->first;
+	auto it = _opcodeIndex.find(m);
+	return it != _opcodeIndex.end() ? it->second : -1;
 }
 
-int cpu::getValueByUniqueOpcodeAliasString(const std::string& m)
+int cpu::getValueByUniqueOpcodeAliasString(std::string_view m)
 {
-	for (auto it = _opcode_aliases.begin(); it != _opcode_aliases.end(); ++it)
-		if (it->second.getUniqueString() == m)
-			return it->first;
+	auto it = _opcodeAliasIndex.find(m);
+	return it != _opcodeAliasIndex.end() ? it->second : -1;
 }
 
 int cpu::numOpcodeCycles()
 {
-	return _opcodes[_lastOpcodeIndex].numArgs();
+	const opcode* oc = _opcodes.find(_lastOpcodeIndex);
+	return oc != nullptr ? oc->numArgs() : 0;
 }
 
 int cpu::lastOpcodeIndex()
 {
 	return _lastOpcodeIndex;
+}
+
+bool cpu::hasArchitecture() const
+{
+	return !_opcodes.empty() || !_opcode_aliases.empty() || !_registerAddresses.empty() || !_flagAddresses.empty() || !_controlLineAddresses.empty();
+}
+
+size_t cpu::programSize() const
+{
+	size_t size = _fixups.size();
+
+	for (int id = 0; id < _symbols.size(); id++)
+	{
+		SymbolType t = _symbols.get(id).getType();
+		bool equate = id < static_cast<int>(_equateIndex.size()) && _equateIndex[id] >= 0;
+
+		if ((t == SymbolType::Label || t == SymbolType::Variable || t == SymbolType::Constant) && !equate)
+			size++;
+	}
+
+	for (const std::vector<uint8_t>& segment : _programSegments)
+		size += segment.size();
+
+	return size;
+}
+
+void cpu::saveArchitecture(snapshotWriter& w) const
+{
+	w.i32(_instructionWidth);
+	w.i32(_addressWidth);
+	w.i32(_nFlags);
+
+	w.u8(_write_decode_rom);
+	w.i32(_in_bits_decode);
+	w.i32(_out_bits_decode);
+	w.u8(_write_program_rom);
+	w.i32(_in_bits_program);
+	w.i32(_out_bits_program);
+
+	w.i32(_maxControlLineValue);
+	w.i32(_maxOpcodeValue);
+	w.i32(_maxNumCycles);
+	w.i32(_lastOpcodeIndex);
+
+	// only the symbols the architecture defines -- labels and such belong to the program
+	std::vector<const symbol*> symbols;
+	for (const symbol& s : _symbols)
+	{
+		SymbolType t = s.getType();
+		if (t == SymbolType::Register || t == SymbolType::Flag || t == SymbolType::ControlLine)
+			symbols.push_back(&s);
+	}
+
+	w.u32(static_cast<uint32_t>(symbols.size()));
+	for (const symbol* s : symbols)
+	{
+		w.str(s->getName());
+		w.u8(static_cast<uint8_t>(s->getType()));
+		w.i32(s->getAddress());
+		w.i32(s->getLine());
+	}
+
+	// the address lists keep definition order, which the symbol table doesn't
+	for (const std::vector<int>* addresses : { &_registerAddresses, &_flagAddresses, &_controlLineAddresses })
+	{
+		w.u32(static_cast<uint32_t>(addresses->size()));
+		for (int a : *addresses)
+			w.i32(a);
+	}
+
+	auto writeOpcodes = [&](const opcodeTable& opcodes)
+	{
+		w.u32(static_cast<uint32_t>(opcodes.size()));
+		for (const opcode& oc : opcodes)
+		{
+			w.i32(oc.value());
+			w.str(oc.mnemonic());
+
+			w.u32(oc.numArgs());
+			for (int i = 0; i < oc.numArgs(); i++)
+			{
+				w.u8(static_cast<uint8_t>(oc.getArg(i)._type));
+				w.str(oc.getArg(i)._string);
+			}
+
+			w.u32(oc.numCycles());
+			for (int c = 0; c < oc.numCycles(); c++)
+			{
+				const controlPatterns& cps = opcodes.getCycle(oc, c);
+
+				w.u8(static_cast<uint8_t>(cps.count));
+				for (int p = 0; p < cps.count; p++)
+				{
+					const controlPattern& cp = cps.cpattern[p];
+
+					w.i32(cp.pattern);
+					w.u8(static_cast<uint8_t>(cp.type));
+					w.u8(cp.flags.complemented());
+					w.u32(static_cast<uint32_t>(cp.flags.cubes().size()));
+					for (const flagCube& cube : cp.flags.cubes())
+					{
+						w.u32(cube.value);
+						w.u32(cube.mask);
+					}
+				}
+			}
+		}
+	};
+
+	w.u32(static_cast<uint32_t>(_controlFields.size()));
+	for (int f : _controlFields)
+		w.i32(f);
+
+	writeOpcodes(_opcodes);
+	writeOpcodes(_opcode_aliases);
+
+	// equates from the architecture files go in as they were written, to be compiled again on load
+	uint32_t equates = static_cast<uint32_t>(std::count_if(_equates.begin(), _equates.end(), [](const equate& e) { return e.architecture; }));
+
+	w.u32(equates);
+	for (const equate& e : _equates)
+	{
+		if (!e.architecture)
+			continue;
+
+		w.str(_symbols.get(e.symbol).getName());
+		w.str(e.text);
+		w.i32(e.line);
+	}
+}
+
+// Everything is read into locals first, so a bad snapshot leaves the cpu as it was
+bool cpu::loadArchitecture(snapshotReader& r)
+{
+	if (hasArchitecture())
+		return false;
+
+	int32_t instructionWidth, addressWidth, nFlags;
+	uint8_t writeDecode, writeProgram;
+	int32_t inDecode, outDecode, inProgram, outProgram;
+	int32_t maxControlLine, maxOpcode, maxCycles, lastOpcode;
+
+	if (!r.i32(instructionWidth) || !r.i32(addressWidth) || !r.i32(nFlags) ||
+		!r.u8(writeDecode) || !r.i32(inDecode) || !r.i32(outDecode) ||
+		!r.u8(writeProgram) || !r.i32(inProgram) || !r.i32(outProgram) ||
+		!r.i32(maxControlLine) || !r.i32(maxOpcode) || !r.i32(maxCycles) || !r.i32(lastOpcode))
+		return false;
+
+	uint32_t count;
+	if (!r.u32(count))
+		return false;
+
+	struct archSymbol
+	{
+		std::string name;
+		SymbolType type;
+		int address;
+		int line;
+	};
+
+	std::vector<archSymbol> symbols;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		std::string name;
+		uint8_t type;
+		int32_t address, line;
+		if (!r.str(name) || !r.u8(type) || !r.i32(address) || !r.i32(line))
+			return false;
+
+		SymbolType t = static_cast<SymbolType>(type);
+		if (t != SymbolType::Register && t != SymbolType::Flag && t != SymbolType::ControlLine)
+			return false;
+
+		symbols.push_back({ std::move(name), t, address, line });
+	}
+
+	std::vector<int> addresses[3];
+	for (std::vector<int>& list : addresses)
+	{
+		if (!r.u32(count))
+			return false;
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			int32_t a;
+			if (!r.i32(a))
+				return false;
+
+			list.push_back(a);
+		}
+	}
+
+	std::set<int> controlFields;
+	if (!r.u32(count))
+		return false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		int32_t f;
+		if (!r.i32(f))
+			return false;
+
+		controlFields.insert(f);
+	}
+
+	auto readOpcodes = [&](opcodeTable& opcodes)
+	{
+		opcodes.reserve(instructionWidth);
+
+		uint32_t n;
+		if (!r.u32(n))
+			return false;
+
+		for (uint32_t i = 0; i < n; i++)
+		{
+			int32_t value;
+			std::string mnemonic;
+			if (!r.i32(value) || !r.str(mnemonic))
+				return false;
+
+			opcode oc;
+			oc.setMnemonic(mnemonic);
+			oc.setValue(value);
+
+			uint32_t args;
+			if (!r.u32(args))
+				return false;
+
+			for (uint32_t a = 0; a < args; a++)
+			{
+				uint8_t type;
+				opcode::arg arg;
+				if (!r.u8(type) || !r.str(arg._string))
+					return false;
+
+				arg._type = static_cast<ArgType>(type);
+				oc.addArgument(arg);
+			}
+
+			if (!opcodes.add(value, oc))
+				return false;
+
+			uint32_t cycles;
+			if (!r.u32(cycles))
+				return false;
+
+			for (uint32_t c = 0; c < cycles; c++)
+			{
+				uint8_t patterns;
+				if (!r.u8(patterns) || patterns < 1 || patterns > 2)
+					return false;
+
+				for (uint8_t p = 0; p < patterns; p++)
+				{
+					controlPattern cp;
+					uint8_t type, complemented;
+					uint32_t cubes;
+					if (!r.i32(cp.pattern) || !r.u8(type) || !r.u8(complemented) || !r.u32(cubes))
+						return false;
+
+					cp.type = static_cast<PatternType>(type);
+					for (uint32_t k = 0; k < cubes; k++)
+					{
+						flagCube cube;
+						if (!r.u32(cube.value) || !r.u32(cube.mask))
+							return false;
+
+						cp.flags.add(cube);
+					}
+
+					if (complemented)
+						cp.flags = cp.flags.complement();
+
+					if (p == 0)
+						opcodes.addCycle(value, cp);
+					else
+						opcodes.addToLastCycle(value, cp);
+				}
+			}
+		}
+
+		return true;
+	};
+
+	opcodeTable opcodes, aliases;
+	if (!readOpcodes(opcodes) || !readOpcodes(aliases))
+		return false;
+
+	struct archEquate
+	{
+		std::string name;
+		std::string text;
+		int line;
+	};
+
+	std::vector<archEquate> equates;
+	if (!r.u32(count))
+		return false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		archEquate e;
+		int32_t line;
+		if (!r.str(e.name) || !r.str(e.text) || !r.i32(line))
+			return false;
+
+		e.line = line;
+		equates.push_back(std::move(e));
+	}
+
+	if (!r.done())
+		return false;
+
+	// the whole snapshot was good -- take it on
+	_instructionWidth = instructionWidth;
+	_addressWidth = addressWidth;
+	_nFlags = nFlags;
+
+	addDecoderRom(writeDecode != 0, inDecode, outDecode);
+	addProgramRom(writeProgram != 0, inProgram, outProgram);
+
+	for (const archSymbol& s : symbols)
+		_symbols.define(_symbols.intern(s.name), s.type, s.address, s.line);
+
+	_registerAddresses = std::move(addresses[0]);
+	_flagAddresses = std::move(addresses[1]);
+	_controlLineAddresses = std::move(addresses[2]);
+	_controlFields = std::move(controlFields);
+
+	_opcodes = std::move(opcodes);
+	_opcode_aliases = std::move(aliases);
+
+	for (const opcode& oc : _opcodes)
+		indexOpcode(oc, false);
+
+	for (const opcode& oc : _opcode_aliases)
+		indexOpcode(oc, true);
+
+	for (const archEquate& e : equates)
+		addEquate(e.name, e.text, e.line, true);
+
+	_maxControlLineValue = maxControlLine;
+	_maxOpcodeValue = maxOpcode;
+	_maxNumCycles = maxCycles;
+	_lastOpcodeIndex = lastOpcode;
+
+	return true;
+}
+
+bool cpu::copyArchitecture(const cpu& from)
+{
+	if (hasArchitecture())
+		return false;
+
+	_instructionWidth = from._instructionWidth;
+	_addressWidth = from._addressWidth;
+	_nFlags = from._nFlags;
+
+	addDecoderRom(from._write_decode_rom, from._in_bits_decode, from._out_bits_decode);
+	addProgramRom(from._write_program_rom, from._in_bits_program, from._out_bits_program);
+
+	// only the symbols the architecture defines, as with snapshots
+	for (const symbol& s : from._symbols)
+	{
+		SymbolType t = s.getType();
+		if (t == SymbolType::Register || t == SymbolType::Flag || t == SymbolType::ControlLine)
+			_symbols.define(_symbols.intern(s.getName()), t, s.getAddress(), s.getLine());
+	}
+
+	_registerAddresses = from._registerAddresses;
+	_flagAddresses = from._flagAddresses;
+	_controlLineAddresses = from._controlLineAddresses;
+	_controlFields = from._controlFields;
+
+	// the lookup indices point into this cpu's own signatures, so they're built again
+	_opcodes = from._opcodes;
+	_opcode_aliases = from._opcode_aliases;
+
+	for (const opcode& oc : _opcodes)
+		indexOpcode(oc, false);
+
+	for (const opcode& oc : _opcode_aliases)
+		indexOpcode(oc, true);
+
+	for (const equate& e : from._equates)
+		if (e.architecture)
+			addEquate(from._symbols.get(e.symbol).getName(), e.text, e.line, true);
+
+	_maxControlLineValue = from._maxControlLineValue;
+	_maxOpcodeValue = from._maxOpcodeValue;
+	_maxNumCycles = from._maxNumCycles;
+	_lastOpcodeIndex = from._lastOpcodeIndex;
+
+	return true;
+}
+
+uint64_t cpu::architectureHash() const
+{
+	snapshotWriter w;
+	saveArchitecture(w);
+	return hashContents(w.data());
+}
+
+// Code or a label with no .org before it opens the unit's relocatable section, which starts at 0
+int cpu::currentSection()
+{
+	if (_currentSection < 0)
+	{
+		_sections.push_back({ _activeSegmentIndex, _address, _address, true });
+		_currentSection = static_cast<int>(_sections.size()) - 1;
+	}
+
+	return _currentSection;
+}
+
+// the relocatable section a symbol was defined in, or -1 when its value is absolute
+int cpu::relocatableSection(int id) const
+{
+	if (id >= static_cast<int>(_symbolSections.size()))
+		return -1;
+
+	int section = _symbolSections[id];
+	if (section < 0 || !_sections[section].relocatable)
+		return -1;
+
+	return section;
+}
+
+// like the symbol itself, the section of its first definition wins
+void cpu::setSymbolSection(int id, int section)
+{
+	if (id >= static_cast<int>(_symbolSections.size()))
+		_symbolSections.resize(id + 1, -1);
+
+	if (_symbolSections[id] < 0)
+		_symbolSections[id] = section;
+}
+
+void cpu::addRelocation(int section, int address, int width, const std::string& symbol, int target)
+{
+	_relocations.push_back({ section, address - _sections[section].origin, width, symbol, target });
+}
+
+objectFile cpu::buildObject() const
+{
+	objectFile o;
+	o.archHash = architectureHash();
+	o.programBits = _in_bits_program;
+
+	for (const section& s : _sections)
+	{
+		objectSection os;
+		os.segment = s.segment;
+		os.relocatable = s.relocatable;
+		os.origin = s.origin;
+
+		if (s.end > s.origin)
+		{
+			const std::vector<uint8_t>& segment = _programSegments[s.segment];
+			os.data.assign(segment.begin() + s.origin, segment.begin() + s.end);
+		}
+
+		o.sections.push_back(std::move(os));
+	}
+
+	for (int id = 0; id < _symbols.size(); id++)
+	{
+		const symbol& s = _symbols.get(id);
+		SymbolType t = s.getType();
+		if (t == SymbolType::Label || t == SymbolType::Variable || t == SymbolType::Constant)
+			o.symbols.push_back({ std::string(s.getName()), t, s.getAddress(), relocatableSection(id) });
+	}
+
+	o.relocations = _relocations;
+	return o;
 }
\ No newline at end of file
@@ -1,13 +1,26 @@
 #pragma once
 
 #include "symbol.h"
+#include "symboltable.h"
 #include "opcode.h"
+#include "opcodetable.h"
 #include "assembler.h"
 #include "command.h"
+#include "keyword.h"
+#include "rom.h"
+#include "snapshot.h"
+#include "object.h"
+#include "expression.h"
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <set>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <array>
 #include <assert.h>
 #include <memory>
 #include <optional>
@@ -19,76 +32,141 @@ public:
 	cpu();
 
 	// bitwidth stuff
-	void setInstructionWidth(int i) { _instructionWidth = i; }
+	void setInstructionWidth(int i) { _instructionWidth = i; _opcodes.reserve(i); _opcode_aliases.reserve(i); }
 	void setAddressWidth(int a) { _addressWidth = a; }
-	int getInstructionWidth() { return _instructionWidth; }
-	int getAddressWidth() { return _addressWidth; }
+	int getInstructionWidth() const { return _instructionWidth; }
+	int getAddressWidth() const { return _addressWidth; }
+	bool opcodeFits(int v) const { return _opcodes.fits(v); }
 
 	void registerOperations(); 
-	void processCommand(assembler& a, std::optional<std::string> token, std::string remainder, int lineNum);
+	void processCommand(assembler& a, Keyword k, std::string_view token, std::string remainder, int lineNum);
+	void processInstruction(assembler& a, std::string_view mnemonic, std::string remainder, int lineNum);
 
 	// flag stuff
 	int getFlagCount() { return _nFlags; }
-	std::vector<int> lastAddedFlags;
+	flagSet lastSeqIfFlags;
 
 	// symbol stuff
-	SymbolType getSymbolType(const std::string& n);
-	int getSymbolAddress(const std::string& n) const;
+	SymbolType getSymbolType(std::string_view n) const;
+	int getSymbolAddress(std::string_view n, int line = -1);
+	int getSymbolId(std::string_view n) { return _symbols.intern(n); }
 	const std::vector<int>& getSymbolAddresses(SymbolType t);
-	void addLabel(const std::string& n, int a, int l);
-	void addConstant(const std::string& n, int a, int l);
-	void addVariable(const std::string& n, int a, int l);
-	void addFlag(const std::string& n, int a, int l);
-	void addRegister(const std::string& n, int a, int l);
-	void addControlLine(const std::string& n, int a, int l);
+	std::vector<const symbol*> getSymbols(SymbolType t) const;
+	void addLabel(std::string_view n, int a, int l);
+	void addConstant(std::string_view n, int a, int l);
+	void addVariable(std::string_view n, int a, int l);
+	void addFlag(std::string_view n, int a, int l);
+	void addRegister(std::string_view n, int a, int l);
+	void addControlLine(std::string_view n, int a, int l);
+
+	// .equ -- a constant defined by an expression, which is kept as it is and only worked out the first
+	// time something needs its value. Equates can use each other (and labels further on) in any order;
+	// the values are remembered, and an equate that ends up depending on itself is an error.
+	void addEquate(std::string_view n, std::string_view text, int l, bool architecture);
+	void addControlField(int shift) { _controlFields.insert(shift); }
 	void addOpcode(int v, const opcode& oc);
 	void addOpcodeAlias(int v, const opcode& oca);
-	void addNewControlPatternToCurrentOpcode(controlPattern cp);
-	void addToLastControlPatternInCurrentOpcode(controlPattern cp);
+	void addNewControlPatternToCurrentOpcode(const controlPattern& cp);
+	void addToLastControlPatternInCurrentOpcode(const controlPattern& cp);
+
+	// control word fields, by the bit each one starts at -- a field runs up to where the next one starts
+	const std::set<int>& getControlFields() const { return _controlFields; }
 
 	// opcode stuff
-	bool isAMnemonic(const std::string& s);
-	int getValueByUniqueOpcodeString(const std::string& s);
-	int getValueByUniqueOpcodeAliasString(const std::string& s);
+	bool isAMnemonic(std::string_view s);
+	int getValueByUniqueOpcodeString(std::string_view s);
+	int getValueByUniqueOpcodeAliasString(std::string_view s);
 	int numOpcodeCycles();
 	int lastOpcodeIndex();
-	opcode& getOpcode(int v);
+	const opcode* getOpcode(int v) const { return _opcodes.find(v); }
+	const opcodeTable& getOpcodes() const { return _opcodes; }
 
-	// addressing stuff
+	// program stuff -- values go out little-endian at the current address. Symbols that aren't
+	// defined yet leave a fixup behind that gets patched once the whole source has been seen.
+	void emitValue(int value, int width);
+	void emitSymbol(std::string_view name, int width, int line);
+	void resolveFixups();
+
+	// addressing stuff -- setOrigin is .org, which starts a new absolute section in object mode
 	void setAddress(int a);
+	void setOrigin(int a, int line);
 	int getAddress() const { return _address; }
 	
 	// Decoder Rom stuff
 	void addDecoderRom(bool write, int inputs, int outputs);
-	void writeDecoderRom();
+	bool writesDecoderRom() const { return _write_decode_rom; }
+	decoderRomLayout getDecoderRomLayout() const;
+	std::vector<uint32_t> buildDecoderRom(const decoderRomLayout& layout) const;
+	void writeDecoderRom(assembler& a, const std::string& basename);
 
 	// ProgramRom stuff
-	void setActiveSegment(int i) { _activeSegmentIndex = i; }
+	void setActiveSegment(int i);
+	int getActiveSegment() const { return _activeSegmentIndex; }
 	void addProgramRom(bool write, int inputs, int outputs);
 	void addByteToProgramRom(int8_t byte, int address = -1);
-	void writeProgramRom();
+	bool writesProgramRom() const { return _write_program_rom; }
+	const std::vector<uint8_t>& getProgramSegment(int i) const { return _programSegments[i]; }
+	int numProgramSegments() const { return static_cast<int>(_programSegments.size()); }
+	void writeProgramRom(assembler& a, const std::string& basename);
+
+	// architecture snapshot stuff -- everything the architecture file defines (see snapshot.h)
+	bool hasArchitecture() const;
+	void saveArchitecture(snapshotWriter& w) const;
+
+	// the architecture has to be the last thing in the snapshot -- anything left over and nothing is taken on
+	bool loadArchitecture(snapshotReader& r);
+
+	// How much program the cpu holds: labels, variables and constants (equates aside, which snapshots
+	// keep), fixups and program bytes. It only ever grows, so an architecture file that changed it (or
+	// the address) held program code, which a snapshot can't hold.
+	size_t programSize() const;
+
+	// Take on another cpu's architecture, the same state a snapshot holds. The other cpu is only read,
+	// so any number of units can copy one frozen architecture at once.
+	bool copyArchitecture(const cpu& from);
+
+	// hash of everything saveArchitecture writes -- objects remember the architecture they were built for
+	uint64_t architectureHash() const;
+
+	// object stuff -- in object mode the program goes into sections, and values the linker has to fill
+	// in become relocations, instead of the whole program landing at fixed addresses (see object.h)
+	void setObjectMode(bool o) { _objectMode = o; }
+	bool objectMode() const { return _objectMode; }
+	objectFile buildObject() const;
 
 private:
 private:
 	template <class d>
-	void registerDirective(std::string name)
+	void registerDirective(Keyword k)
 	{
-		assert(_directives.count(name) == 0);
-		_directives.emplace(name, std::make_unique<d>());
+		assert(!_keywords[static_cast<size_t>(k)]);
+		_keywords[static_cast<size_t>(k)] = std::make_unique<d>();
 	}
 
 	template <class a>
-	void registerArchTag(std::string name)
+	void registerArchTag(Keyword k)
 	{
-		assert(_archtags.count(name) == 0);
-		_archtags.emplace(name, std::make_unique<a>());
+		assert(!_keywords[static_cast<size_t>(k)]);
+		_keywords[static_cast<size_t>(k)] = std::make_unique<a>();
 	}
 
+	std::string_view storeSignature(const std::string& s);
+
+	bool symbolValue(int id, bool required, int& value);
+	bool resolveEquate(int id, bool required);
+	void resolveEquates();
+	void indexOpcode(const opcode& oc, bool alias);
+
+	int currentSection();
+	int relocatableSection(int id) const;
+	void setSymbolSection(int id, int section);
+	void addRelocation(int section, int address, int width, const std::string& symbol, int target);
+
 	template <class i>
-	void registerInstruction(std::string name)
+	void registerInstruction(const std::string& name)
 	{
-		assert(_instructions.count(name) == 0);
-		_instructions.emplace(name, std::make_unique<i>());
+		if (_instructions.count(name) == 0)
+			_instructions.emplace(name, std::make_unique<i>());
 	}
 
 private:
@@ -100,18 +178,42 @@ private:
 	int _nFlags = 0;
 
 	// symbol stuff
-	std::map<std::string, symbol> _symbols;
+	symbolTable _symbols;
 	std::vector<int> _constantAddresses;
 	std::vector<int> _variableAddresses;
 	std::vector<int> _labelAddresses;
 	std::vector<int> _registerAddresses;
 	std::vector<int> _flagAddresses;
 	std::vector<int> _controlLineAddresses;
+	std::set<int> _controlFields;
+
+	// equate stuff -- _equateIndex maps a symbol ID to its equate, or -1 when it isn't one. Equates
+	// from an architecture file are kept as text too, so snapshots and shared architectures can
+	// compile them again against their own symbol table.
+	enum class EquateState { Pending, Resolving, Resolved };
+
+	struct equate
+	{
+		int symbol;
+		expression value;
+		std::string text;
+		int line;
+		bool architecture;
+		EquateState state;
+	};
+
+	std::vector<equate> _equates;
+	std::vector<int> _equateIndex;
 
 	// opcode stuff
-	std::map<int, opcode> _opcodes;
-	std::map<int, opcode> _opcode_aliases;
-	std::vector<std::string> _mnemonics;
+	opcodeTable _opcodes;
+	opcodeTable _opcode_aliases;
+	// opcode lookup stuff -- signatures are computed once when an opcode is added, and the indices
+	// key on views into _signatures (a deque, so the strings never move)
+	std::deque<std::string> _signatures;
+	std::unordered_set<std::string_view> _mnemonicIndex;
+	std::unordered_map<std::string_view, int> _opcodeIndex;
+	std::unordered_map<std::string_view, int> _opcodeAliasIndex;
 	int _lastOpcodeIndex = -1;
 
 	// addressing stuff
@@ -119,22 +221,52 @@ private:
 	int _last_address = -1;
 	int _max_address = 0;
 
-	// token identifier stuff
-	std::map<std::string, std::unique_ptr<command>>  _directives;
-	std::map<std::string, std::unique_ptr<command>>  _archtags;
-	std::map<std::string, std::unique_ptr<command>>  _instructions;
+	// token identifier stuff -- fixed keywords are indexed directly, while instructions are
+	// registered by mnemonic at runtime as opcodes get defined
+	std::array<std::unique_ptr<command>, KEYWORD_COUNT> _keywords;
+	std::map<std::string, std::unique_ptr<command>, std::less<>>  _instructions;
+
+	// program stuff
+	struct fixup
+	{
+		int symbol;
+		int segment;
+		int address;
+		int width;
+		int line;
+		int section;
+	};
+
+	std::vector<fixup> _fixups;
+
+	// object stuff -- the sections of the program so far, and the relocatable section each label was
+	// defined in, indexed by symbol ID (-1 when it has none)
+	struct section
+	{
+		int segment;
+		int origin;
+		int end;
+		bool relocatable;
+	};
+
+	bool _objectMode = false;
+	std::vector<section> _sections;
+	int _currentSection = -1;
+	std::vector<int> _symbolSections;
+	std::vector<objectRelocation> _relocations;
 
 	// decode rom stuff
 	bool _write_decode_rom = false;
 	int _maxControlLineValue = -1;
 	int _maxOpcodeValue = -1;
 	int _maxNumCycles = -1;
-	int _in_bits_decode;
-	int _out_bits_decode;
+	int _in_bits_decode = 0;
+	int _out_bits_decode = 0;
 
 	// program rom stuff
-	int _activeSegmentIndex;
+	int _activeSegmentIndex = 0;
+	std::vector<std::vector<uint8_t>> _programSegments;
 	bool _write_program_rom = false;
-	int _in_bits_program;
-	int _out_bits_program;
+	int _in_bits_program = 0;
+	int _out_bits_program = 0;
 };
\ No newline at end of file
@@ -0,0 +1,555 @@
+#include "cycles.h"
+#include "cpu.h"
+#include "util.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <queue>
+#include <climits>
+#include <cctype>
+
+cycleEstimator::cycleEstimator(const cpu& c)
+	:
+	_cpu(c)
+{
+	// the field every control line sits in, worked out the way the simulator does it
+	std::vector<int> starts(c.getControlFields().begin(), c.getControlFields().end());
+
+	for (const symbol* s : c.getSymbols(SymbolType::ControlLine))
+	{
+		uint32_t value = static_cast<uint32_t>(s->getAddress());
+		if (value == 0)
+			continue;
+
+		uint32_t mask = value;
+		for (size_t f = 0; f < starts.size(); f++)
+		{
+			int end = f + 1 < starts.size() ? starts[f + 1] : 32;
+			uint32_t field = (end >= 32 ? 0xFFFFFFFFu : (1u << end) - 1) & ~((1u << starts[f]) - 1);
+
+			if ((value & field) == 0)
+				continue;
+
+			mask = (value & ~field) == 0 ? field : 0;
+			break;
+		}
+
+		std::string name(s->getName());
+		name.erase(0, name.find_first_not_of('_'));
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+
+		controlLine line = { value, mask, false, false, false };
+		line.endsSequence = name.find("endseq") != std::string::npos;
+		line.loadsPc = name.rfind("pc_read_", 0) == 0;
+		line.savesPc = name.size() > 5 && name.compare(name.size() - 5, 5, "_read") == 0;
+
+		if (mask != 0 && (line.endsSequence || line.loadsPc || line.savesPc))
+			_controlLines.push_back(line);
+	}
+}
+
+void cycleEstimator::cost::add(const cost& other)
+{
+	best += other.best;
+	worst += other.worst;
+	bounded = bounded && other.bounded;
+}
+
+// What an opcode costs, from its microcode. A cycle only does something for every flag state when it
+// is a plain seq, or a seq_if with its seq_else -- a lone seq_if leaves the other states doing nothing.
+const cycleEstimator::opcodeCost& cycleEstimator::costOf(int value)
+{
+	auto i = _opcodeCosts.find(value);
+	if (i != _opcodeCosts.end())
+		return i->second;
+
+	opcodeCost& oc = _opcodeCosts[value];
+
+	const opcode* op = _cpu.getOpcode(value);
+	if (op == nullptr)
+		return oc;
+
+	oc.known = true;
+
+	bool registers = false;
+	for (int a = 0; a < op->numArgs(); a++)
+	{
+		ArgType t = op->getArg(a)._type;
+		if (t == ArgType::Numeral || t == ArgType::DerefNum)
+			oc.direct = true;
+		else if (t != ArgType::None)
+			registers = true;
+	}
+
+	oc.direct = oc.direct && !registers;
+
+	int best = -1;
+	int worst = -1;
+	bool anyLoad = false;
+	bool allLoad = false;
+	bool saves = false;
+
+	for (int c = 0; c < op->numCycles() && worst < 0; c++)
+	{
+		const controlPatterns& cps = _cpu.getOpcodes().getCycle(*op, c);
+		bool covered = cps.count == 2 || (cps.count == 1 && cps.cpattern[0].type == PatternType::Seq);
+
+		bool anyEnd = false;
+		bool allEnd = covered;
+		bool cycleLoads = covered;
+
+		for (int p = 0; p < cps.count; p++)
+		{
+			uint32_t word = static_cast<uint32_t>(cps.cpattern[p].pattern);
+			bool ends = false;
+			bool loads = false;
+
+			for (const controlLine& l : _controlLines)
+			{
+				if ((word & l.mask) != l.value)
+					continue;
+
+				ends = ends || l.endsSequence;
+				loads = loads || l.loadsPc;
+				saves = saves || l.savesPc;
+			}
+
+			anyEnd = anyEnd || ends;
+			allEnd = allEnd && ends;
+			anyLoad = anyLoad || loads;
+			cycleLoads = cycleLoads && loads;
+		}
+
+		allLoad = allLoad || cycleLoads;
+
+		if (anyEnd && best < 0)
+			best = c + 1;
+
+		if (allEnd)
+			worst = c + 1;
+	}
+
+	// microcode that never ends runs through every cycle it has
+	if (worst < 0)
+		worst = op->numCycles();
+
+	if (best < 0)
+		best = worst;
+
+	oc.cycles = { best, worst, true };
+
+	if (!anyLoad)
+		oc.flow = FlowType::Next;
+	else if (saves)
+		oc.flow = FlowType::Call;
+	else if (!allLoad)
+		oc.flow = FlowType::Branch;
+	else
+		oc.flow = oc.direct ? FlowType::Jump : FlowType::Return;
+
+	return oc;
+}
+
+uint32_t cycleEstimator::readProgram(int segment, int address, int width) const
+{
+	if (segment < 0 || segment >= _cpu.numProgramSegments())
+		return 0;
+
+	const std::vector<uint8_t>& bytes = _cpu.getProgramSegment(segment);
+
+	uint32_t value = 0;
+	for (int b = 0; b < width && b < 4; b++)
+	{
+		size_t a = static_cast<size_t>(address) + b;
+		if (address >= 0 && a < bytes.size())
+			value |= static_cast<uint32_t>(bytes[a]) << (8 * b);
+	}
+
+	return value;
+}
+
+int cycleEstimator::findInstruction(int segment, int address) const
+{
+	auto i = _instructionIndex.find(key(segment, address));
+	return i != _instructionIndex.end() ? i->second : -1;
+}
+
+void cycleEstimator::analyze()
+{
+	const int instructionWidth = _cpu.getInstructionWidth();
+	const int addressWidth = _cpu.getAddressWidth();
+
+	// the instructions in address order -- code may be placed out of order with .org
+	_instructions.clear();
+	for (int l = 0; l < static_cast<int>(_lines.size()); l++)
+	{
+		const sourceLine& line = _lines[l];
+		if (!line.label.empty() || line.size <= 0)
+			continue;
+
+		int value = static_cast<int>(readProgram(line.segment, line.address, instructionWidth));
+		_instructions.push_back({ l, line.segment, line.address, line.size, costOf(value), -1, -1 });
+	}
+
+	std::stable_sort(_instructions.begin(), _instructions.end(), [](const instruction& a, const instruction& b)
+	{
+		return key(a.segment, a.address) < key(b.segment, b.address);
+	});
+
+	const int count = numInstructions();
+
+	_instructionIndex.clear();
+	for (int i = 0; i < count; i++)
+		_instructionIndex[key(_instructions[i].segment, _instructions[i].address)] = i;
+
+	for (instruction& in : _instructions)
+	{
+		if (in.op.flow != FlowType::Next && in.op.flow != FlowType::Return && in.op.direct)
+			in.target = findInstruction(in.segment, static_cast<int>(readProgram(in.segment, in.address + instructionWidth, addressWidth)));
+	}
+
+	auto fallsThrough = [&](int i)
+	{
+		return i + 1 < count && _instructions[i + 1].segment == _instructions[i].segment &&
+			_instructions[i].address + _instructions[i].size == _instructions[i + 1].address;
+	};
+
+	// lines to instructions, and the labels that start blocks
+	_lineInstruction.assign(_lines.size(), -1);
+	std::vector<bool> leader(count, false);
+	std::unordered_set<uint64_t> labels;
+
+	for (int l = 0; l < static_cast<int>(_lines.size()); l++)
+	{
+		const sourceLine& line = _lines[l];
+		_lineInstruction[l] = findInstruction(line.segment, line.address);
+
+		if (!line.label.empty())
+		{
+			labels.insert(key(line.segment, line.address));
+
+			if (_lineInstruction[l] >= 0)
+				leader[_lineInstruction[l]] = true;
+		}
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		const instruction& in = _instructions[i];
+		if (in.target >= 0)
+			leader[in.target] = true;
+
+		bool endsBlock = in.op.flow == FlowType::Jump || in.op.flow == FlowType::Branch || in.op.flow == FlowType::Return;
+		if (i + 1 < count && (endsBlock || !fallsThrough(i)))
+			leader[i + 1] = true;
+	}
+
+	// basic blocks
+	_blocks.clear();
+	for (int i = 0; i < count; i++)
+	{
+		if (i == 0 || leader[i])
+			_blocks.push_back({ i, i, { }, false, { }, { } });
+
+		block& b = _blocks.back();
+		b.last = i;
+		b.own.add(_instructions[i].op.cycles);
+		_instructions[i].block = numBlocks() - 1;
+	}
+
+	for (block& b : _blocks)
+	{
+		const instruction& last = _instructions[b.last];
+		int next = fallsThrough(b.last) ? _instructions[b.last + 1].block : -1;
+		int target = last.target >= 0 ? _instructions[last.target].block : -1;
+
+		switch (last.op.flow)
+		{
+		case FlowType::Next:
+		case FlowType::Call:
+			if (next >= 0)
+				b.successors.push_back(next);
+			else
+				b.exits = true;
+			break;
+
+		case FlowType::Jump:
+			if (target >= 0)
+				b.successors.push_back(target);
+			else
+				b.exits = true;
+			break;
+
+		case FlowType::Branch:
+			if (next >= 0)
+				b.successors.push_back(next);
+			if (target >= 0 && target != next)
+				b.successors.push_back(target);
+			b.exits = next < 0 || target < 0;
+			break;
+
+		case FlowType::Return:
+			b.exits = true;
+			break;
+		}
+	}
+
+	// every label -- up to the next label, and its path to a return
+	_routines.assign(_blocks.size(), routine());
+	_labelTotals.assign(_lines.size(), cost());
+
+	for (int l = 0; l < static_cast<int>(_lines.size()); l++)
+	{
+		int start = _lineInstruction[l];
+		if (_lines[l].label.empty() || start < 0)
+			continue;
+
+		for (int i = start; i < count; i++)
+		{
+			_labelTotals[l].add(_instructions[i].op.cycles);
+
+			if (!fallsThrough(i) || labels.count(key(_instructions[i + 1].segment, _instructions[i + 1].address)) > 0)
+				break;
+		}
+
+		routineCost(_instructions[start].block);
+	}
+
+	for (int b = 0; b < numBlocks(); b++)
+		blockCost(b);
+}
+
+// A block with the routines it calls. A call back into a routine that is still being worked out is
+// recursion, which has no worst case.
+cycleEstimator::cost cycleEstimator::blockCost(int b)
+{
+	block& bl = _blocks[b];
+
+	if (bl.state == State::Done)
+		return bl.total;
+
+	if (bl.state == State::Working)
+	{
+		cost c = bl.own;
+		c.bounded = false;
+		return c;
+	}
+
+	bl.state = State::Working;
+
+	cost total = bl.own;
+	for (int i = bl.first; i <= bl.last; i++)
+	{
+		const instruction& in = _instructions[i];
+		if (in.op.flow != FlowType::Call)
+			continue;
+
+		if (in.target < 0)
+		{
+			total.bounded = false;
+			continue;
+		}
+
+		routine r = routineCost(_instructions[in.target].block);
+		total.add(r.cycles);
+		total.bounded = total.bounded && r.returns;
+	}
+
+	bl.total = total;
+	bl.state = State::Done;
+
+	return total;
+}
+
+// The cheapest and dearest way from a block to a return, over the blocks it reaches without following
+// calls. The cheapest is a shortest path, loops or not; the dearest only exists when there are none.
+cycleEstimator::routine cycleEstimator::routineCost(int entry)
+{
+	if (_routines[entry].state == State::Done)
+		return _routines[entry];
+
+	if (_routines[entry].state == State::Working)
+	{
+		routine r;
+		r.cycles.bounded = false;
+		r.returns = true;
+		return r;
+	}
+
+	_routines[entry].state = State::Working;
+
+	// the blocks it reaches, numbered locally
+	std::vector<int> reached = { entry };
+	std::unordered_map<int, int> local = { { entry, 0 } };
+
+	for (size_t k = 0; k < reached.size(); k++)
+	{
+		for (int s : _blocks[reached[k]].successors)
+		{
+			if (local.emplace(s, static_cast<int>(reached.size())).second)
+				reached.push_back(s);
+		}
+	}
+
+	const int n = static_cast<int>(reached.size());
+
+	std::vector<cost> costs(n);
+	bool bounded = true;
+	for (int k = 0; k < n; k++)
+	{
+		costs[k] = blockCost(reached[k]);
+		bounded = bounded && costs[k].bounded;
+	}
+
+	// cheapest -- Dijkstra, since every block costs something
+	std::vector<int> cheapest(n, INT_MAX);
+	std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<>> queue;
+
+	cheapest[0] = costs[0].best;
+	queue.push({ cheapest[0], 0 });
+
+	int best = INT_MAX;
+	while (!queue.empty())
+	{
+		auto [d, k] = queue.top();
+		queue.pop();
+
+		if (d > cheapest[k])
+			continue;
+
+		if (_blocks[reached[k]].exits)
+			best = std::min(best, d);
+
+		for (int s : _blocks[reached[k]].successors)
+		{
+			int t = local[s];
+			if (d + costs[t].best < cheapest[t])
+			{
+				cheapest[t] = d + costs[t].best;
+				queue.push({ cheapest[t], t });
+			}
+		}
+	}
+
+	// dearest -- the longest path, over a topological order of the blocks
+	std::vector<int> incoming(n, 0);
+	for (int k = 0; k < n; k++)
+		for (int s : _blocks[reached[k]].successors)
+			incoming[local[s]]++;
+
+	std::vector<int> order;
+	for (int k = 0; k < n; k++)
+		if (incoming[k] == 0)
+			order.push_back(k);
+
+	for (size_t o = 0; o < order.size(); o++)
+	{
+		for (int s : _blocks[reached[order[o]]].successors)
+		{
+			if (--incoming[local[s]] == 0)
+				order.push_back(local[s]);
+		}
+	}
+
+	int worst = 0;
+	if (static_cast<int>(order.size()) < n)
+	{
+		bounded = false;
+	}
+	else
+	{
+		// the dearest way from each block to a return, or -1 for a block that never gets to one
+		std::vector<int> dearest(n, -1);
+		for (auto o = order.rbegin(); o != order.rend(); ++o)
+		{
+			const block& b = _blocks[reached[*o]];
+			int after = b.exits ? 0 : -1;
+
+			for (int s : b.successors)
+				after = std::max(after, dearest[local[s]]);
+
+			if (after >= 0)
+				dearest[*o] = after + costs[*o].worst;
+		}
+
+		worst = dearest[0];
+	}
+
+	routine& r = _routines[entry];
+	r.returns = best != INT_MAX;
+	r.cycles = { r.returns ? best : 0, std::max(worst, 0), bounded && r.returns };
+	r.state = State::Done;
+
+	return r;
+}
+
+uint64_t cycleEstimator::key(int segment, int address)
+{
+	return (static_cast<uint64_t>(static_cast<uint32_t>(segment)) << 32) | static_cast<uint32_t>(address);
+}
+
+std::string cycleEstimator::describe(const cost& c)
+{
+	if (!c.bounded)
+		return std::to_string(c.best) + "..loop";
+
+	if (c.best == c.worst)
+		return std::to_string(c.best);
+
+	return std::to_string(c.best) + ".." + std::to_string(c.worst);
+}
+
+void cycleEstimator::writeListing(std::ostream& o, const std::string& title) const
+{
+	o << "; cycle listing for " << title << " -- clock cycles as best..worst\n";
+	o << "; " << dec << numInstructions() << " instruction(s) in " << numBlocks() << " block(s)\n";
+	o << ";\n";
+	o << "; A block's count includes the routines it calls, and is shown on its last line. A label shows the\n";
+	o << "; cycles of its own instructions up to the next label, then its path: the cheapest and dearest way\n";
+	o << "; from it to a return, calls included.\n";
+	o << "; \"loop\" means there is no worst case, since a loop (or recursion) runs an unknown number of times.\n";
+
+	std::string_view file;
+	for (int l = 0; l < static_cast<int>(_lines.size()); l++)
+	{
+		const sourceLine& line = _lines[l];
+		int i = _lineInstruction[l];
+
+		if (line.file != file)
+		{
+			file = line.file;
+			o << "\n-- " << file << "\n";
+		}
+
+		std::string note;
+		std::string text;
+
+		if (!line.label.empty())
+		{
+			o << std::setfill(' ') << std::setw(27) << "";
+			text = std::string(line.label) + ":";
+
+			if (i >= 0)
+			{
+				const routine& r = _routines[_instructions[i].block];
+				note = "to next label " + describe(_labelTotals[l]) + ", path " + (r.returns ? describe(r.cycles) : "never returns");
+			}
+		}
+		else
+		{
+			o << std::setfill(' ') << std::setw(8) << dec << line.line + 1 << "  $" << hex4 << line.address << "  " << std::setfill(' ');
+			o << std::left << std::setw(10) << (i >= 0 && _instructions[i].op.known ? describe(_instructions[i].op.cycles) : "?") << std::right;
+			text = line.text;
+
+			if (i >= 0 && _instructions[i].line == l && _blocks[_instructions[i].block].last == i)
+				note = "block " + describe(_blocks[_instructions[i].block].total);
+		}
+
+		if (note.empty())
+			o << text;
+		else
+			o << std::left << std::setw(32) << text << std::right << " ; " << note;
+
+		o << "\n";
+	}
+}
\ No newline at end of file
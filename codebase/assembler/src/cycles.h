@@ -0,0 +1,141 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+#include <cstdint>
+
+class cpu;
+
+// Static clock counts for an assembled program, without running it.
+//
+// What an opcode costs and what it does to the program counter comes from its microcode. Control
+// lines are recognized by name, the same way the simulator does it (see machine.h):
+//   ...endseq       the last cycle -- an opcode costs the cycles up to the first one that may end it
+//                   (best) and the first one that always does (worst), so a seq_if that ends early
+//                   makes the two differ
+//   pc_read_...     the program counter is loaded -- a jump, or a branch when only a seq_if does it
+//   x_read          x latches the program counter as well -- a call
+// A jump or call takes its target from its numeric operand. One that has none (ret, a jump through a
+// register) leaves the routine.
+//
+// The program is split into basic blocks at labels, jump targets and after every jump. Every block gets
+// the cycles of its instructions, plus whatever the routines it calls cost. Every label gets the total
+// up to the next label, and the cheapest and dearest path from it to a return. A path through a loop has
+// no worst case, since how often the loop runs isn't known statically.
+class cycleEstimator
+{
+public:
+	// One line of program code, in the order the assembler saw them. A label and the instruction after
+	// it on the same line are two lines here.
+	struct sourceLine
+	{
+		std::string_view file;
+		int line;
+		std::string_view text;
+		std::string_view label;
+		int segment;
+		int address;
+		int size;
+	};
+
+	explicit cycleEstimator(const cpu& c);
+
+	// the program has to be complete, with every fixup resolved, before analyze
+	void addLine(const sourceLine& l) { _lines.push_back(l); }
+	void analyze();
+
+	int numInstructions() const { return static_cast<int>(_instructions.size()); }
+	int numBlocks() const { return static_cast<int>(_blocks.size()); }
+
+	// every line with its cycles, each label with its totals and each block with its own
+	void writeListing(std::ostream& o, const std::string& title) const;
+
+private:
+	enum class FlowType { Next, Jump, Branch, Call, Return };
+	enum class State { Pending, Working, Done };
+
+	// best and worst clock counts -- a worst case that can't be bounded isn't
+	struct cost
+	{
+		int best = 0;
+		int worst = 0;
+		bool bounded = true;
+
+		void add(const cost& other);
+	};
+
+	struct opcodeCost
+	{
+		cost cycles;
+		FlowType flow = FlowType::Next;
+		bool direct = false;
+		bool known = false;
+	};
+
+	struct controlLine
+	{
+		uint32_t value;
+		uint32_t mask;
+		bool endsSequence;
+		bool loadsPc;
+		bool savesPc;
+	};
+
+	struct instruction
+	{
+		int line;
+		int segment;
+		int address;
+		int size;
+		opcodeCost op;
+		int target;
+		int block;
+	};
+
+	struct block
+	{
+		int first;
+		int last;
+		std::vector<int> successors;
+		bool exits;
+		cost own;
+		cost total;
+		State state = State::Pending;
+	};
+
+	struct routine
+	{
+		cost cycles;
+		bool returns = false;
+		State state = State::Pending;
+	};
+
+	const opcodeCost& costOf(int value);
+	uint32_t readProgram(int segment, int address, int width) const;
+	int findInstruction(int segment, int address) const;
+
+	cost blockCost(int b);
+	routine routineCost(int entry);
+
+	static uint64_t key(int segment, int address);
+	static std::string describe(const cost& c);
+
+private:
+	const cpu& _cpu;
+
+	std::vector<sourceLine> _lines;
+	std::vector<controlLine> _controlLines;
+	std::unordered_map<int, opcodeCost> _opcodeCosts;
+
+	std::vector<instruction> _instructions;
+	std::unordered_map<uint64_t, int> _instructionIndex;
+	// the instruction each line holds, or for a label the one it points at (-1 for none)
+	std::vector<int> _lineInstruction;
+	std::vector<cost> _labelTotals;
+
+	std::vector<block> _blocks;
+	std::vector<routine> _routines;
+};
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "cpu.h"
 #include "command.h"
 #include "parser.h"
+#include "lexer.h"
 
 #include <iostream>
 #include <sstream>
@@ -11,9 +12,9 @@
 class includeDirective : public command
 {
 public:
-	void process(assembler& a, cpu& cpu, const std::string& d, std::string remainder, int line) const override
+	void process(assembler& a, cpu&, const std::string& d, std::string remainder, int line) const override
 	{
-		auto token = parser::instance().extract_token_str(remainder);
+		auto token = a.getParser().extract_token_str(remainder);
 		if (!token.has_value())
 		{
 			// no data
@@ -32,15 +33,14 @@ public:
 		}
 
 		std::string tokenString = token.has_value() ? std::string(token.value()) : "";
-		parser::instance().trim_ws(tokenString);
+		a.getParser().trim_ws(tokenString);
 
 		if (!tokenString.empty())
 		{
 			//if (a.echoMajorTasks())
-				std::cout << "          *** Processing include directive for file: " << tokenString << "\n";
+				a.out() << "          *** Processing include directive for file: " << tokenString << "\n";
 
-			a.pushFileToStack("code\\" + tokenString);
-			a.processFile();
+			a.includeFile(tokenString, line);
 		}
 		else
 		{
@@ -52,3 +52,125 @@ public:
 		}
 	}
 };
+
+// .once -- later includes of the file that holds it are skipped
+class onceDirective : public command
+{
+public:
+	void process(assembler& a, cpu&, const std::string& d, std::string remainder, int line) const override
+	{
+		a.getParser().trim_ws(remainder);
+		if (!remainder.empty())
+		{
+			std::stringstream msg;
+			msg << "Processing directive ." << d << " at line <" << line << ">! Unexpected [";
+			msg << remainder << "]!!";
+			throw std::exception(msg.str().c_str());
+		}
+
+		a.markIncludeOnce();
+
+		if (a.echoParsedMinor())
+			a.out() << "          *** " << a.currentFile() << " will only be included once\n";
+	}
+};
+
+class orgDirective : public command
+{
+public:
+	void process(assembler& a, cpu& cpu, const std::string& d, std::string remainder, int line) const override
+	{
+		lexer lex(remainder);
+
+		token t = lex.next();
+		if (!t.is(TokenType::Number) || !lex.done())
+		{
+			std::stringstream msg;
+			msg << "Processing directive ." << d << " at line <" << line << ">! Expected a single address -- found [";
+			msg << remainder << "]!!";
+			throw std::exception(msg.str().c_str());
+		}
+
+		cpu.setOrigin(t.value, line);
+
+		if (a.echoParsedMajor())
+			a.out() << "          *** Address set to $" << hex4 << t.value << "\n";
+	}
+};
+
+// .equ name expression -- the expression is stored as written and worked out when it's first needed
+class equDirective : public command
+{
+public:
+	void process(assembler& a, cpu& cpu, const std::string& d, std::string remainder, int line) const override
+	{
+		lexer lex(remainder);
+
+		token name = lex.next();
+		if (!name.is(TokenType::Identifier))
+		{
+			std::stringstream msg;
+			msg << "Processing directive ." << d << " at line <" << line << ">! Expected a name -- found [";
+			msg << name.text << "]!!";
+			throw std::exception(msg.str().c_str());
+		}
+
+		// the name and the expression may be separated by = or a comma
+		token separator = lex.peek();
+		if (separator.is(TokenType::Equals) || separator.is(TokenType::Comma))
+			lex.next();
+
+		std::string text(lex.rest());
+		a.getParser().trim_ws(text);
+
+		cpu.addEquate(name.text, text, line, a.inArchitectureFile());
+
+		if (a.echoParsedMajor())
+			a.out() << "          *** Equate [" << name.text << "] = " << text << "\n";
+	}
+};
+
+// .byte and .word -- a comma separated list of numbers, symbols and (for .byte) strings
+class dataDirective : public command
+{
+public:
+	void process(assembler&, cpu& cpu, const std::string& d, std::string remainder, int line) const override
+	{
+		int width = d == WORD_STR ? cpu.getAddressWidth() : 1;
+
+		lexer lex(remainder);
+		for (token t = lex.next(); !t.is(TokenType::End); t = lex.next())
+		{
+			switch (t.type)
+			{
+			case TokenType::Comma:
+				break;
+
+			case TokenType::Number:
+				cpu.emitValue(t.value, width);
+				break;
+
+			case TokenType::Identifier:
+				cpu.emitSymbol(t.text, width, line);
+				break;
+
+			case TokenType::String:
+				if (width == 1)
+				{
+					for (char c : t.text)
+						cpu.emitValue(c, 1);
+					break;
+				}
+				// fall through -- strings only make sense as bytes
+
+			default:
+			{
+				std::stringstream msg;
+				msg << "Processing directive ." << d << " at line <" << line << ">! Unexpected value [";
+				msg << t.text << "]!!";
+				throw std::exception(msg.str().c_str());
+			}
+			}
+		}
+	}
+};
\ No newline at end of file
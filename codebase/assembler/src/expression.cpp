@@ -0,0 +1,137 @@
+#include "expression.h"
+#include "symboltable.h"
+
+#include <limits>
+
+bool expression::compile(std::string_view text, symbolTable& symbols, std::string& error)
+{
+	_nodes.clear();
+
+	lexer lex(text);
+	if (!parseBinary(lex, 0, symbols, error))
+		return false;
+
+	if (!lex.done())
+	{
+		error = "Unexpected [" + std::string(lex.rest()) + "]";
+		return false;
+	}
+
+	return true;
+}
+
+bool expression::parseBinary(lexer& lex, int level, symbolTable& symbols, std::string& error)
+{
+	if (level == PRECEDENCE_LEVELS)
+		return parseUnary(lex, symbols, error);
+
+	if (!parseBinary(lex, level + 1, symbols, error))
+		return false;
+
+	ExprOp op;
+	while (binaryOperator(lex.peek(), level, op))
+	{
+		lex.next();
+
+		if (!parseBinary(lex, level + 1, symbols, error))
+			return false;
+
+		_nodes.push_back({ op, 0 });
+	}
+
+	return true;
+}
+
+bool expression::parseUnary(lexer& lex, symbolTable& symbols, std::string& error)
+{
+	token t = lex.next();
+
+	if (isOperator(t, '-') || isOperator(t, '~'))
+	{
+		if (!parseUnary(lex, symbols, error))
+			return false;
+
+		_nodes.push_back({ t.text.front() == '-' ? ExprOp::Negate : ExprOp::Not, 0 });
+		return true;
+	}
+
+	if (isOperator(t, '('))
+	{
+		if (!parseBinary(lex, 0, symbols, error))
+			return false;
+
+		if (!isOperator(lex.next(), ')'))
+		{
+			error = "Missing )";
+			return false;
+		}
+
+		return true;
+	}
+
+	if (t.is(TokenType::Number))
+	{
+		_nodes.push_back({ ExprOp::Number, t.value });
+		return true;
+	}
+
+	if (t.is(TokenType::Identifier))
+	{
+		_nodes.push_back({ ExprOp::Symbol, symbols.intern(t.text) });
+		return true;
+	}
+
+	error = t.is(TokenType::End) ? "Expected a value" : "Expected a value -- found [" + std::string(t.text) + "]";
+	return false;
+}
+
+// a single character operator, which the lexer hands out as TokenType::Other
+bool expression::isOperator(const token& t, char c)
+{
+	return t.is(TokenType::Other) && t.text.size() == 1 && t.text.front() == c;
+}
+
+// the operator t stands for at a precedence level (0 binds loosest), if it's one of that level's
+bool expression::binaryOperator(const token& t, int level, ExprOp& op)
+{
+	switch (level)
+	{
+	case 0:
+		if (t.is(TokenType::Pipe)) { op = ExprOp::Or; return true; }
+		break;
+
+	case 1:
+		if (isOperator(t, '^')) { op = ExprOp::Xor; return true; }
+		break;
+
+	case 2:
+		if (isOperator(t, '&')) { op = ExprOp::And; return true; }
+		break;
+
+	case 3:
+		if (t.is(TokenType::ShiftLeft)) { op = ExprOp::ShiftLeft; return true; }
+		if (t.is(TokenType::ShiftRight)) { op = ExprOp::ShiftRight; return true; }
+		break;
+
+	case 4:
+		if (isOperator(t, '+')) { op = ExprOp::Add; return true; }
+		if (isOperator(t, '-')) { op = ExprOp::Sub; return true; }
+		break;
+
+	case 5:
+		if (isOperator(t, '*')) { op = ExprOp::Mul; return true; }
+		if (isOperator(t, '/')) { op = ExprOp::Div; return true; }
+		break;
+	}
+
+	return false;
+}
+
+bool expression::fits(int64_t value, std::string& error)
+{
+	if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max())
+		return true;
+
+	error = "overflows to " + std::to_string(value);
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "lexer.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+class symbolTable;
+
+enum class ExprOp : uint8_t { Number, Symbol, Negate, Not, Mul, Div, Add, Sub, ShiftLeft, ShiftRight, And, Xor, Or };
+
+// One step of a compiled expression -- a number or a symbol ID to push, or an operator that works on
+// the values already pushed
+class exprNode
+{
+public:
+	ExprOp op;
+	int value;
+};
+
+// An integer expression over numbers and symbols, such as (buffer_end - buffer) >> 1. It is compiled
+// to postfix once, with every symbol already interned, so it can be stored and evaluated later without
+// going back to the text. Operators bind as they do in C: unary - and ~, then * and /, + and -,
+// << and >>, &, ^ and |.
+class expression
+{
+public:
+	// Returns false, with a reason in error, when the text isn't a well-formed expression. Symbols are
+	// interned as they're found, so they don't have to be defined yet.
+	bool compile(std::string_view text, symbolTable& symbols, std::string& error);
+
+	// Symbol values come from valueOf(id). Returns false, with a reason in error, when it would divide by
+	// zero, shift by less than 0 or 32 or more bits, or any step doesn't fit in an int.
+	template <class F>
+	bool evaluate(F valueOf, int& result, std::string& error) const
+	{
+		// worked out one size up, so a step that doesn't fit can be caught before it's cut down
+		std::vector<int64_t> stack;
+		stack.reserve(_nodes.size());
+
+		for (const exprNode& n : _nodes)
+		{
+			switch (n.op)
+			{
+			case ExprOp::Number:
+				stack.push_back(n.value);
+				continue;
+
+			case ExprOp::Symbol:
+				stack.push_back(valueOf(n.value));
+				continue;
+
+			case ExprOp::Negate:
+				stack.back() = -stack.back();
+				if (!fits(stack.back(), error))
+					return false;
+				continue;
+
+			case ExprOp::Not:
+				stack.back() = ~stack.back();
+				continue;
+
+			default:
+				break;
+			}
+
+			int64_t rhs = stack.back();
+			stack.pop_back();
+			int64_t& lhs = stack.back();
+
+			switch (n.op)
+			{
+			case ExprOp::Mul: lhs *= rhs; break;
+			case ExprOp::Add: lhs += rhs; break;
+			case ExprOp::Sub: lhs -= rhs; break;
+			case ExprOp::And: lhs &= rhs; break;
+			case ExprOp::Xor: lhs ^= rhs; break;
+			case ExprOp::Or: lhs |= rhs; break;
+
+			case ExprOp::ShiftLeft:
+			case ExprOp::ShiftRight:
+				if (rhs < 0 || rhs >= 32)
+				{
+					error = "shifts by " + std::to_string(rhs) + " bits";
+					return false;
+				}
+
+				// a left shift is a multiply, so a negative value shifts the same way
+				if (n.op == ExprOp::ShiftLeft)
+					lhs *= int64_t(1) << rhs;
+				else
+					lhs >>= rhs;
+				break;
+
+			case ExprOp::Div:
+				if (rhs == 0)
+				{
+					error = "divides by zero";
+					return false;
+				}
+
+				lhs /= rhs;
+				break;
+
+			default:
+				break;
+			}
+
+			if (!fits(lhs, error))
+				return false;
+		}
+
+		result = static_cast<int>(stack.back());
+		return true;
+	}
+
+	const std::vector<exprNode>& nodes() const { return _nodes; }
+
+private:
+	bool parseBinary(lexer& lex, int level, symbolTable& symbols, std::string& error);
+	bool parseUnary(lexer& lex, symbolTable& symbols, std::string& error);
+
+	static bool isOperator(const token& t, char c);
+	static bool fits(int64_t value, std::string& error);
+	static bool binaryOperator(const token& t, int level, ExprOp& op);
+
+	static constexpr int PRECEDENCE_LEVELS = 6;
+
+private:
+	std::vector<exprNode> _nodes;
+};
\ No newline at end of file
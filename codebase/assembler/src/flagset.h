@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string_view>
+#include <optional>
+#include <array>
+#include <algorithm>
+#include <assert.h>
+
+// Flag states are packed into an integer, where a flag's bit is its address minus 1 -- the first flag
+// defined is bit 0. A pattern like x0x1x is read as a binary number: its leftmost character is the
+// highest bit and its rightmost is bit 0, so with flag_c defined first, xxxx1 means carry.
+constexpr int MAX_FLAGS = 32;
+
+// A single flag condition -- the flag bits under mask must equal value. An empty mask matches every
+// flag state.
+class flagCube
+{
+public:
+	uint32_t value = 0;
+	uint32_t mask = 0;
+
+	bool matches(uint32_t flags) const { return (flags & mask) == value; }
+	bool operator==(const flagCube& other) const { return value == other.value && mask == other.mask; }
+
+	// Parse a seq_if pattern such as x0x1x, where x means "don't care"
+	static std::optional<flagCube> parse(std::string_view pattern, int nFlags)
+	{
+		if (nFlags > MAX_FLAGS || pattern.size() != static_cast<size_t>(nFlags))
+			return { };
+
+		flagCube c;
+		for (int j = 0; j < nFlags; j++)
+		{
+			uint32_t bit = 1u << (nFlags - 1 - j);
+
+			switch (pattern[j])
+			{
+			case '1':
+				c.value |= bit;
+				c.mask |= bit;
+				break;
+
+			case '0':
+				c.mask |= bit;
+				break;
+
+			case 'x':
+			case 'X':
+				break;
+
+			default:
+				return { };
+			}
+		}
+
+		return c;
+	}
+};
+
+// A read-only run of cubes
+class cubeRange
+{
+public:
+	cubeRange(const flagCube* first, const flagCube* last) : _first(first), _last(last) {}
+
+	const flagCube* begin() const { return _first; }
+	const flagCube* end() const { return _last; }
+	size_t size() const { return static_cast<size_t>(_last - _first); }
+
+	bool operator==(const cubeRange& other) const { return std::equal(_first, _last, other._first, other._last); }
+
+private:
+	const flagCube* _first;
+	const flagCube* _last;
+};
+
+// The set of flag states a control pattern applies to, kept as a union of cubes that can be
+// complemented as a whole (which is all seq_else needs). Its size depends on how many conditions
+// were written in the source, not on 2^flags. Nearly every set has only a cube or two, so the first
+// few live inside the set itself and copying one doesn't allocate.
+class flagSet
+{
+public:
+	static flagSet all()
+	{
+		flagSet s;
+		s.add(flagCube());
+		return s;
+	}
+
+	static flagSet none()
+	{
+		return flagSet();
+	}
+
+	// union with a single cube -- only valid before the set gets complemented
+	void add(const flagCube& c)
+	{
+		assert(!_complemented);
+
+		if (_count < INLINE_CUBES)
+		{
+			_inline[_count++] = c;
+			return;
+		}
+
+		// spill everything to the heap once, so the cubes stay contiguous
+		if (_count == INLINE_CUBES)
+			_spilled.assign(_inline.begin(), _inline.end());
+
+		_spilled.push_back(c);
+		_count++;
+	}
+
+	flagSet complement() const
+	{
+		flagSet s = *this;
+		s._complemented = !s._complemented;
+		return s;
+	}
+
+	bool contains(uint32_t flags) const
+	{
+		bool found = false;
+		for (const flagCube& c : cubes())
+		{
+			if (c.matches(flags))
+			{
+				found = true;
+				break;
+			}
+		}
+
+		return found != _complemented;
+	}
+
+	bool empty() const { return _count == 0 && !_complemented; }
+	bool isAll() const
+	{
+		for (const flagCube& c : cubes())
+			if (c.mask == 0) return !_complemented;
+
+		return _count == 0 && _complemented;
+	}
+
+	cubeRange cubes() const
+	{
+		const flagCube* first = _count <= INLINE_CUBES ? _inline.data() : _spilled.data();
+		return cubeRange(first, first + _count);
+	}
+	bool complemented() const { return _complemented; }
+
+	// Call f for every flag state in the set, in increasing order. This is 2^nFlags work, so it is
+	// meant for output (echoing, ROM images) rather than for building patterns.
+	template <class F>
+	void forEach(int nFlags, F f) const
+	{
+		uint64_t count = 1ull << nFlags;
+		for (uint64_t i = 0; i < count; i++)
+			if (contains(static_cast<uint32_t>(i))) f(static_cast<uint32_t>(i));
+	}
+
+	bool operator==(const flagSet& other) const { return _complemented == other._complemented && cubes() == other.cubes(); }
+
+private:
+	static constexpr size_t INLINE_CUBES = 4;
+
+	std::array<flagCube, INLINE_CUBES> _inline;
+	std::vector<flagCube> _spilled;
+	size_t _count = 0;
+	bool _complemented = false;
+};
\ No newline at end of file
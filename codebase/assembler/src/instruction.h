@@ -0,0 +1,131 @@
+#pragma once
+
+#include "assembler.h"
+#include "cpu.h"
+#include "command.h"
+#include "lexer.h"
+
+#include <iostream>
+#include <sstream>
+
+// Encodes one line of program code. The operands are lexed into argument kinds, the resulting
+// signature (e.g. mov_a_#) picks the opcode, and the opcode and its numeric operands are emitted at
+// the current address. An immediate is as wide as the register it goes with, or address_width when
+// there is no register (jumps, calls). A dereferenced operand is an address, so always address_width.
+class instructionCommand : public command
+{
+public:
+	static constexpr int MAX_OPERANDS = 4;
+
+	void process(assembler& assembler, cpu& cpu, const std::string& mnemonic, std::string remainder, int line) const override
+	{
+		struct operand
+		{
+			ArgType type = ArgType::None;
+			std::string_view symbol;
+			int value = 0;
+		};
+
+		operand operands[MAX_OPERANDS];
+		int count = 0;
+		int registerWidth = 0;
+
+		opcodeSignature sig(mnemonic);
+
+		lexer lex(remainder);
+		for (token t = lex.next(); !t.is(TokenType::End); t = lex.next())
+		{
+			if (count == MAX_OPERANDS)
+			{
+				std::stringstream msg;
+				msg << "Assembling instruction " << mnemonic << " at line <" << line << ">! Too many operands!";
+				throw std::exception(msg.str().c_str());
+			}
+
+			operand& op = operands[count++];
+
+			bool isAddress = t.is(TokenType::IndirectBegin);
+			if (isAddress)
+				t = lex.next();
+
+			// immediate values may optionally be marked the same way the architecture file does
+			if (t.is(TokenType::Hash))
+				t = lex.next();
+
+			if (t.is(TokenType::Identifier) && cpu.getSymbolType(t.text) == SymbolType::Register)
+			{
+				op.type = isAddress ? ArgType::DerefReg : ArgType::Register;
+				sig.addArg(op.type, t.text);
+
+				if (!isAddress)
+					registerWidth = cpu.getSymbolAddress(t.text, line) / 8;
+			}
+			else if (t.is(TokenType::Number) || t.is(TokenType::Identifier))
+			{
+				op.type = isAddress ? ArgType::DerefNum : ArgType::Numeral;
+				op.value = t.value;
+
+				if (t.is(TokenType::Identifier))
+					op.symbol = t.text;
+
+				sig.addArg(op.type);
+			}
+			else
+			{
+				std::stringstream msg;
+				msg << "Assembling instruction " << mnemonic << " at line <" << line << ">! Unexpected operand [" << t.text << "]!";
+				throw std::exception(msg.str().c_str());
+			}
+
+			if (isAddress && !lex.next().is(TokenType::IndirectEnd))
+			{
+				std::stringstream msg;
+				msg << "Assembling instruction " << mnemonic << " at line <" << line << ">! Missing " << INDIRECT_END_KEY << "!";
+				throw std::exception(msg.str().c_str());
+			}
+
+			token separator = lex.next();
+			if (!separator.is(TokenType::Comma) && !separator.is(TokenType::End))
+			{
+				std::stringstream msg;
+				msg << "Assembling instruction " << mnemonic << " at line <" << line << ">! Expected a comma -- found [" << separator.text << "]!";
+				throw std::exception(msg.str().c_str());
+			}
+
+			if (separator.is(TokenType::End))
+				break;
+		}
+
+		int value = cpu.getValueByUniqueOpcodeString(sig.view());
+		if (value == -1)
+			value = cpu.getValueByUniqueOpcodeAliasString(sig.view());
+
+		if (value == -1)
+		{
+			std::stringstream msg;
+			msg << "Assembling instruction " << mnemonic << " at line <" << line << ">! No opcode matches [" << sig.view() << "]!";
+			throw std::exception(msg.str().c_str());
+		}
+
+		int address = cpu.getAddress();
+		cpu.emitValue(value, cpu.getInstructionWidth());
+
+		int immediateWidth = registerWidth > 0 ? registerWidth : cpu.getAddressWidth();
+		for (int i = 0; i < count; i++)
+		{
+			const operand& op = operands[i];
+			if (op.type != ArgType::Numeral && op.type != ArgType::DerefNum)
+				continue;
+
+			int width = op.type == ArgType::Numeral ? immediateWidth : cpu.getAddressWidth();
+
+			if (!op.symbol.empty())
+				cpu.emitSymbol(op.symbol, width, line);
+			else
+				cpu.emitValue(op.value, width);
+		}
+
+		if (assembler.echoParsedMajor())
+			assembler.out() << "          *** $" << hex4 << address << ": " << sig.view() << " = $" << hex2 << value << "\n";
+	}
+};
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "config.h"
+
+#include <string_view>
+
+// Every fixed keyword the assembler understands (see config.h). Directives are stored without their
+// DIRECTIVE_KEY prefix, but are looked up with it.
+enum class Keyword
+{
+	None,
+
+	// directives
+	Include, Once, Org, Byte, Word, Equ,
+
+	// architecture tags
+	InstructionWidth, AddressWidth, DecoderRom, ProgramRom, Register, Flag, Device, Control,
+	Opcode, OpcodeAlias, Seq, SeqIf, SeqElse,
+
+	Count
+};
+
+constexpr size_t KEYWORD_COUNT = static_cast<size_t>(Keyword::Count);
+
+// Map a source token straight to its keyword. The keyword set is fixed, so the token length picks a
+// handful of candidates (usually just one) and a single compare confirms it -- there is no table to
+// scan and no map to search.
+constexpr Keyword lookupKeyword(std::string_view s)
+{
+	if (s.empty())
+		return Keyword::None;
+
+	if (s.front() == DIRECTIVE_KEY)
+	{
+		s.remove_prefix(1);
+
+		switch (s.size())
+		{
+		case 3:
+			if (s == ORG_STR) return Keyword::Org;
+			if (s == EQU_STR) return Keyword::Equ;
+			break;
+
+		case 4:
+			if (s == ONCE_STR) return Keyword::Once;
+			if (s == BYTE_STR) return Keyword::Byte;
+			if (s == WORD_STR) return Keyword::Word;
+			break;
+
+		case 7:
+			if (s == INCLUDE_STR) return Keyword::Include;
+			break;
+		}
+
+		return Keyword::None;
+	}
+
+	switch (s.size())
+	{
+	case 3:
+		if (s == OPCODE_SEQ_STR) return Keyword::Seq;
+		break;
+
+	case 4:
+		if (s == FLAG_STR) return Keyword::Flag;
+		break;
+
+	case 6:
+		if (s == OPCODE_STR) return Keyword::Opcode;
+		if (s == DEVICE_STR) return Keyword::Device;
+		if (s == OPCODE_SEQ_IF_STR) return Keyword::SeqIf;
+		break;
+
+	case 7:
+		if (s == CONTROL_STR) return Keyword::Control;
+		break;
+
+	case 8:
+		if (s == REGISTER_STR) return Keyword::Register;
+		if (s == OPCODE_SEQ_ELSE_STR) return Keyword::SeqElse;
+		break;
+
+	case 11:
+		if (s == DECODER_ROM_STR) return Keyword::DecoderRom;
+		if (s == PROGRAM_ROM_STR) return Keyword::ProgramRom;
+		break;
+
+	case 12:
+		if (s == OPCODE_ALIAS_STR) return Keyword::OpcodeAlias;
+		break;
+
+	case 13:
+		if (s == ADDRESS_WIDTH_STR) return Keyword::AddressWidth;
+		break;
+
+	case 17:
+		if (s == INSTRUCTION_WIDTH_STR) return Keyword::InstructionWidth;
+		break;
+	}
+
+	return Keyword::None;
+}
+
+// The dispatch above is keyed on string lengths, so make sure they still line up with config.h
+static_assert(lookupKeyword(".include") == Keyword::Include, "keyword table out of date");
+static_assert(lookupKeyword(".once") == Keyword::Once, "keyword table out of date");
+static_assert(lookupKeyword(".org") == Keyword::Org, "keyword table out of date");
+static_assert(lookupKeyword(".byte") == Keyword::Byte, "keyword table out of date");
+static_assert(lookupKeyword(".word") == Keyword::Word, "keyword table out of date");
+static_assert(lookupKeyword(".equ") == Keyword::Equ, "keyword table out of date");
+static_assert(lookupKeyword(INSTRUCTION_WIDTH_STR) == Keyword::InstructionWidth, "keyword table out of date");
+static_assert(lookupKeyword(ADDRESS_WIDTH_STR) == Keyword::AddressWidth, "keyword table out of date");
+static_assert(lookupKeyword(DECODER_ROM_STR) == Keyword::DecoderRom, "keyword table out of date");
+static_assert(lookupKeyword(PROGRAM_ROM_STR) == Keyword::ProgramRom, "keyword table out of date");
+static_assert(lookupKeyword(REGISTER_STR) == Keyword::Register, "keyword table out of date");
+static_assert(lookupKeyword(FLAG_STR) == Keyword::Flag, "keyword table out of date");
+static_assert(lookupKeyword(DEVICE_STR) == Keyword::Device, "keyword table out of date");
+static_assert(lookupKeyword(CONTROL_STR) == Keyword::Control, "keyword table out of date");
+static_assert(lookupKeyword(OPCODE_STR) == Keyword::Opcode, "keyword table out of date");
+static_assert(lookupKeyword(OPCODE_ALIAS_STR) == Keyword::OpcodeAlias, "keyword table out of date");
+static_assert(lookupKeyword(OPCODE_SEQ_STR) == Keyword::Seq, "keyword table out of date");
+static_assert(lookupKeyword(OPCODE_SEQ_IF_STR) == Keyword::SeqIf, "keyword table out of date");
+static_assert(lookupKeyword(OPCODE_SEQ_ELSE_STR) == Keyword::SeqElse, "keyword table out of date");
\ No newline at end of file
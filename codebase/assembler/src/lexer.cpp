@@ -0,0 +1,195 @@
+#include "lexer.h"
+#include "config.h"
+#include "stats.h"
+
+#include <cctype>
+
+token lexer::next()
+{
+	skipWhitespace();
+
+	if (_cursor >= _line.size())
+		return makeToken(TokenType::End, 0);
+
+	char c = _line[_cursor];
+	char n = _cursor + 1 < _line.size() ? _line[_cursor + 1] : '\0';
+
+	switch (c)
+	{
+	case '|': return makeToken(TokenType::Pipe, 1);
+	case '=': return makeToken(TokenType::Equals, 1);
+	case ':': return makeToken(TokenType::Colon, 1);
+	case ',': return makeToken(TokenType::Comma, 1);
+	case '#': return makeToken(TokenType::Hash, 1);
+	case INDIRECT_BEGIN_KEY: return makeToken(TokenType::IndirectBegin, 1);
+	case INDIRECT_END_KEY: return makeToken(TokenType::IndirectEnd, 1);
+	case '"': return lexString();
+	case '<': return n == '<' ? makeToken(TokenType::ShiftLeft, 2) : makeToken(TokenType::Other, 1);
+	case '>': return n == '>' ? makeToken(TokenType::ShiftRight, 2) : makeToken(TokenType::Other, 1);
+	}
+
+	if (isWordChar(c))
+		return lexWord();
+
+	return makeToken(TokenType::Other, 1);
+}
+
+token lexer::peek()
+{
+	size_t saved = _cursor;
+	token t = next();
+	_cursor = saved;
+
+	return t;
+}
+
+bool lexer::done()
+{
+	skipWhitespace();
+	return _cursor >= _line.size();
+}
+
+void lexer::skipWhitespace()
+{
+	while (_cursor < _line.size() && isspace(static_cast<unsigned char>(_line[_cursor])))
+		_cursor++;
+}
+
+// Identifiers and numbers are both runs of word characters; numbers are told apart by their first
+// character (a digit or one of the literal number keys in config.h)
+token lexer::lexWord()
+{
+	size_t length = 0;
+	while (_cursor + length < _line.size() && isWordChar(_line[_cursor + length]))
+		length++;
+
+	std::string_view text = _line.substr(_cursor, length);
+	char c = text.front();
+
+	bool numeric = isdigit(static_cast<unsigned char>(c)) ||
+		(BIN_KEY != ' ' && c == BIN_KEY) ||
+		(DEC_KEY != ' ' && c == DEC_KEY) ||
+		(HEX_KEY != ' ' && c == HEX_KEY);
+
+	if (!numeric)
+		return makeToken(TokenType::Identifier, length);
+
+	token t = makeToken(TokenType::Number, length);
+	if (!parseNumber(text, t))
+		t.type = TokenType::Other;
+
+	return t;
+}
+
+// Strings run from an opening double quote to the matching closing one. The token text excludes the
+// quotes themselves.
+token lexer::lexString()
+{
+	size_t end = _line.find('"', _cursor + 1);
+	if (end == std::string_view::npos)
+		return makeToken(TokenType::Other, _line.size() - _cursor);
+
+	token t;
+	t.type = TokenType::String;
+	t.text = _line.substr(_cursor + 1, end - _cursor - 1);
+	_cursor = end + 1;
+
+	return t;
+}
+
+token lexer::makeToken(TokenType type, size_t length)
+{
+	token t;
+	t.type = type;
+	t.text = _line.substr(_cursor, length);
+	_cursor += length;
+
+	if (type != TokenType::End)
+		stats::instance().count(StatCounter::Tokens);
+
+	return t;
+}
+
+bool lexer::isWordChar(char c)
+{
+	return isalnum(static_cast<unsigned char>(c)) || c == '_' ||
+		(BIN_KEY != ' ' && c == BIN_KEY) ||
+		(DEC_KEY != ' ' && c == DEC_KEY) ||
+		(HEX_KEY != ' ' && c == HEX_KEY);
+}
+
+// Same literal formats as parser::get_num_type ($hh, %bbbb, 0xhh, 0bbbbb, 0dnnn and plain decimal),
+// but the value is accumulated straight from the characters instead of being handed to stoi
+bool lexer::parseNumber(std::string_view s, token& t)
+{
+	int radix = 10;
+	t.base = LiteralNumType::Decimal;
+
+	if (BIN_KEY != ' ' && s.front() == BIN_KEY)
+	{
+		radix = 2;
+		t.base = LiteralNumType::Binary;
+		s.remove_prefix(1);
+	}
+	else if (DEC_KEY != ' ' && s.front() == DEC_KEY)
+	{
+		s.remove_prefix(1);
+	}
+	else if (HEX_KEY != ' ' && s.front() == HEX_KEY)
+	{
+		radix = 16;
+		t.base = LiteralNumType::Hexadecimal;
+		s.remove_prefix(1);
+	}
+	else if (s.size() > 2 && s.front() == '0' && !isdigit(static_cast<unsigned char>(s[1])))
+	{
+		switch (tolower(s[1]))
+		{
+		case 'x':
+		case 'h':
+			radix = 16;
+			t.base = LiteralNumType::Hexadecimal;
+			break;
+
+		case 'b':
+			radix = 2;
+			t.base = LiteralNumType::Binary;
+			break;
+
+		case 'd':
+			break;
+
+		default:
+			t.base = LiteralNumType::None;
+			return false;
+		}
+
+		s.remove_prefix(2);
+	}
+
+	if (s.empty())
+	{
+		t.base = LiteralNumType::None;
+		return false;
+	}
+
+	unsigned int value = 0;
+	for (char c : s)
+	{
+		int digit = -1;
+		if (c >= '0' && c <= '9') digit = c - '0';
+		else if (tolower(c) >= 'a' && tolower(c) <= 'f') digit = tolower(c) - 'a' + 10;
+
+		if (digit < 0 || digit >= radix)
+		{
+			t.base = LiteralNumType::None;
+			return false;
+		}
+
+		value = value * radix + digit;
+	}
+
+	t.value = static_cast<int>(value);
+
+	return true;
+}
\ No newline at end of file
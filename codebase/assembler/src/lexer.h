@@ -0,0 +1,55 @@
+#pragma once
+
+#include "parser.h"
+
+#include <string_view>
+
+// kinds of tokens handed out by the lexer
+enum class TokenType { End, Identifier, Number, Pipe, Equals, Colon, Comma, Hash, IndirectBegin, IndirectEnd, String, ShiftLeft, ShiftRight, Other };
+
+class token
+{
+public:
+	TokenType type = TokenType::End;
+
+	// the characters of the token, as a view into the lexed line
+	std::string_view text;
+
+	// only meaningful for TokenType::Number
+	LiteralNumType base = LiteralNumType::None;
+	int value = 0;
+
+	bool is(TokenType t) const { return type == t; }
+};
+
+// A cursor-based lexer that walks a single line without copying or erasing any characters. Every
+// token is a view into the original line, so tokenizing never allocates. Comments are expected to
+// have been stripped off already.
+class lexer
+{
+public:
+	lexer(std::string_view s)
+		:
+		_line(s)
+	{}
+
+	token next();
+	token peek();
+	bool done();
+
+	// whatever has not been lexed yet
+	std::string_view rest() const { return _line.substr(_cursor); }
+
+private:
+	void skipWhitespace();
+	token lexWord();
+	token lexString();
+	token makeToken(TokenType t, size_t length);
+
+	static bool isWordChar(char c);
+	static bool parseNumber(std::string_view s, token& t);
+
+private:
+	std::string_view _line;
+	size_t _cursor = 0;
+};
\ No newline at end of file
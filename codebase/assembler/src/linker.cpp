@@ -0,0 +1,272 @@
+#include "linker.h"
+#include "rom.h"
+#include "util.h"
+
+#include <sstream>
+#include <algorithm>
+
+void linker::add(const std::string& name, objectFile o)
+{
+	_inputs.push_back({ name, std::move(o), { } });
+}
+
+void linker::link()
+{
+	if (_inputs.empty())
+		throw std::exception("Nothing to link!");
+
+	for (const input& in : _inputs)
+		check(in);
+
+	place();
+	copySections();
+	collectSymbols();
+	relocate();
+}
+
+int linker::getSymbolAddress(const std::string& name) const
+{
+	auto i = _symbols.find(name);
+	if (i == _symbols.end())
+	{
+		std::stringstream msg;
+		msg << "Linking! Undefined symbol [" << name << "]!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	return i->second.value;
+}
+
+// an object has to match the first one, and everything in it has to point somewhere real
+void linker::check(const input& in) const
+{
+	const objectFile& first = _inputs.front().object;
+	const objectFile& o = in.object;
+
+	if (o.archHash != first.archHash || o.programBits != first.programBits)
+	{
+		std::stringstream msg;
+		msg << "Linking [" << in.name << "]! It was assembled for a different architecture than [" << _inputs.front().name << "]!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	int sections = static_cast<int>(o.sections.size());
+
+	for (const objectSection& s : o.sections)
+	{
+		if (s.segment < 0 || s.origin < 0)
+		{
+			std::stringstream msg;
+			msg << "Linking [" << in.name << "]! Bad section!";
+			throw std::exception(msg.str().c_str());
+		}
+	}
+
+	for (const objectSymbol& s : o.symbols)
+	{
+		if (s.section >= sections || (s.section >= 0 && !o.sections[s.section].relocatable))
+		{
+			std::stringstream msg;
+			msg << "Linking [" << in.name << "]! Symbol [" << s.name << "] is in a bad section!";
+			throw std::exception(msg.str().c_str());
+		}
+	}
+
+	for (const objectRelocation& r : o.relocations)
+	{
+		bool good = r.section >= 0 && r.section < sections && r.width > 0 && r.offset >= 0 &&
+			r.offset + r.width <= static_cast<int>(o.sections[r.section].data.size());
+
+		if (r.symbol.empty())
+			good = good && r.target >= 0 && r.target < sections && o.sections[r.target].relocatable;
+
+		if (!good)
+		{
+			std::stringstream msg;
+			msg << "Linking [" << in.name << "]! Bad relocation!";
+			throw std::exception(msg.str().c_str());
+		}
+	}
+}
+
+void linker::place()
+{
+	std::vector<int> next;
+
+	// relocatable code starts where the absolute code ends, unless told otherwise
+	for (const input& in : _inputs)
+	{
+		for (const objectSection& s : in.object.sections)
+		{
+			if (s.segment >= static_cast<int>(next.size()))
+				next.resize(s.segment + 1, 0);
+
+			if (!s.relocatable)
+				next[s.segment] = std::max(next[s.segment], s.origin + static_cast<int>(s.data.size()));
+		}
+	}
+
+	if (_base >= 0)
+		std::fill(next.begin(), next.end(), _base);
+
+	int romSize = 1 << _inputs.front().object.programBits;
+
+	for (input& in : _inputs)
+	{
+		for (const objectSection& s : in.object.sections)
+		{
+			int at = s.origin;
+			if (s.relocatable)
+			{
+				at = next[s.segment];
+				next[s.segment] += static_cast<int>(s.data.size());
+			}
+
+			if (at + static_cast<int>(s.data.size()) > romSize)
+			{
+				std::stringstream msg;
+				msg << "Linking [" << in.name << "]! " << dec << s.data.size() << " bytes at $" << hex4 << at
+					<< " don't fit in the " << dec << _inputs.front().object.programBits << "-bit program rom!";
+				throw std::exception(msg.str().c_str());
+			}
+
+			in.placed.push_back(at);
+		}
+	}
+}
+
+void linker::copySections()
+{
+	for (int i = 0; i < static_cast<int>(_inputs.size()); i++)
+	{
+		const input& in = _inputs[i];
+
+		for (size_t k = 0; k < in.object.sections.size(); k++)
+		{
+			const objectSection& s = in.object.sections[k];
+			if (s.data.empty())
+				continue;
+
+			if (s.segment >= static_cast<int>(_segments.size()))
+			{
+				_segments.resize(s.segment + 1);
+				_owners.resize(s.segment + 1);
+			}
+
+			std::vector<uint8_t>& segment = _segments[s.segment];
+			std::vector<int>& owners = _owners[s.segment];
+
+			size_t at = in.placed[k];
+			size_t end = at + s.data.size();
+			if (segment.size() < end)
+			{
+				segment.resize(end, 0);
+				owners.resize(end, 0);
+			}
+
+			for (size_t a = at; a < end; a++)
+			{
+				if (owners[a] != 0)
+				{
+					std::stringstream msg;
+					msg << "Linking [" << in.name << "]! Its code at $" << hex4 << a << " overlaps [" << _inputs[owners[a] - 1].name << "]!";
+					throw std::exception(msg.str().c_str());
+				}
+
+				owners[a] = i + 1;
+			}
+
+			std::copy(s.data.begin(), s.data.end(), segment.begin() + at);
+		}
+	}
+}
+
+void linker::collectSymbols()
+{
+	for (int i = 0; i < static_cast<int>(_inputs.size()); i++)
+	{
+		const input& in = _inputs[i];
+
+		for (const objectSymbol& s : in.object.symbols)
+		{
+			int value = s.value;
+			if (s.section >= 0)
+				value += in.placed[s.section] - in.object.sections[s.section].origin;
+
+			auto existing = _symbols.find(s.name);
+			if (existing != _symbols.end())
+			{
+				// units that include the same header all define its constants, which is fine as long
+				// as they agree
+				const linkedSymbol& other = existing->second;
+				if (s.type == SymbolType::Constant && other.type == SymbolType::Constant && s.section < 0 && value == other.value)
+					continue;
+
+				std::stringstream msg;
+				msg << "Linking [" << in.name << "]! [" << s.name << "] is already defined by [" << _inputs[other.input].name << "]";
+				if (s.type == SymbolType::Constant && other.type == SymbolType::Constant)
+					msg << " as $" << hex4 << other.value << ", not $" << hex4 << value;
+				msg << "!";
+				throw std::exception(msg.str().c_str());
+			}
+
+			_symbols.emplace(s.name, linkedSymbol{ value, i, s.type });
+		}
+	}
+}
+
+// values go in little-endian, cut to the width they were given, just like the assembler does it
+void linker::relocate()
+{
+	for (const input& in : _inputs)
+	{
+		for (const objectRelocation& r : in.object.relocations)
+		{
+			const objectSection& s = in.object.sections[r.section];
+			std::vector<uint8_t>& segment = _segments[s.segment];
+			size_t at = in.placed[r.section] + r.offset;
+
+			int value;
+			if (!r.symbol.empty())
+			{
+				auto i = _symbols.find(r.symbol);
+				if (i == _symbols.end())
+				{
+					std::stringstream msg;
+					msg << "Linking [" << in.name << "]! Undefined symbol [" << r.symbol << "]!";
+					throw std::exception(msg.str().c_str());
+				}
+
+				value = i->second.value;
+			}
+			else
+			{
+				// the bytes hold an address in the target section as it was assembled
+				value = 0;
+				for (int b = 0; b < r.width; b++)
+					value |= segment[at + b] << (8 * b);
+
+				value += in.placed[r.target] - in.object.sections[r.target].origin;
+			}
+
+			for (int b = 0; b < r.width; b++)
+				segment[at + b] = static_cast<uint8_t>((value >> (8 * b)) & 0xFF);
+		}
+	}
+}
+
+void linker::writeProgramRom(const std::string& basename, std::ostream& out, bool echo) const
+{
+	for (int i = 0; i < numSegments(); i++)
+	{
+		const std::vector<uint8_t>& segment = _segments[i];
+		if (segment.empty())
+			continue;
+
+		std::string filename = basename + ".program" + std::to_string(i) + ".bin";
+		writeRomImage(filename, segment);
+
+		if (echo)
+			out << "\n-- writing program rom segment " << dec << i << ": " << segment.size() << " bytes to " << filename << "\n";
+	}
+}
\ No newline at end of file
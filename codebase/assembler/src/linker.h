@@ -0,0 +1,63 @@
+#pragma once
+
+#include "object.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include <cstdint>
+
+// Puts objects together into program rom segments. Absolute sections go where their .org put them.
+// Relocatable sections are packed one after another, in the order the objects were added, starting
+// at the base address -- by default just past the highest byte any absolute section uses in that
+// segment. Every label is global, so each one must be defined by exactly one object.
+class linker
+{
+public:
+	void add(const std::string& name, objectFile o);
+	void setBase(int b) { _base = b; }
+
+	// Throws on objects built for different architectures, overlapping code, symbols defined twice or
+	// not at all, and code that doesn't fit in the program rom
+	void link();
+
+	int numSegments() const { return static_cast<int>(_segments.size()); }
+	const std::vector<uint8_t>& getSegment(int i) const { return _segments[i]; }
+	int getSymbolAddress(const std::string& name) const;
+
+	// one file per non-empty segment, named like the assembler's own program roms
+	void writeProgramRom(const std::string& basename, std::ostream& out, bool echo) const;
+
+private:
+	struct input
+	{
+		std::string name;
+		objectFile object;
+		std::vector<int> placed;
+	};
+
+	void check(const input& in) const;
+	void place();
+	void copySections();
+	void collectSymbols();
+	void relocate();
+
+private:
+	std::vector<input> _inputs;
+	int _base = -1;
+
+	std::vector<std::vector<uint8_t>> _segments;
+
+	// which input every byte came from (+1, so 0 is free), to catch overlaps
+	std::vector<std::vector<int>> _owners;
+
+	struct linkedSymbol
+	{
+		int value;
+		int input;
+		SymbolType type;
+	};
+
+	std::map<std::string, linkedSymbol, std::less<>> _symbols;
+};
\ No newline at end of file
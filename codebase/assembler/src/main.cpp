@@ -1,16 +1,46 @@
 #include "assembler.h"
 #include "cpu.h"
+#include "stats.h"
+#include "units.h"
+#include "linker.h"
+#include "watch.h"
+#include "parser.h"
+#include "config.h"
 
 #include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <sstream>
+#include <cstring>
+#include <thread>
 #include <conio.h>
 
 int main(int argc, char* argv[])
 {
-	// On the command-line, we expect ./asm file.s, where asm is the name of this
+	// On the command-line, we expect ./asm file.s [options], where asm is the name of this
 // executable and file.s is the file containing the program that you would
 // like assembled. It is implied that file.s either contains all the architecture
 // definitions needed to define your homebrew cpu or includes the appropriate
-// architecture file with those definitions.
+// architecture file with those definitions. The options are:
+//   more.s ...       more source files to assemble, or .obj files to link
+//   -I dir, -Idir    adds to the include search path; the code directory, where
+//                    the projects keep their sources, is searched last
+//   -arch file.arch  parses the architecture once and assembles every source
+//                    file as a unit of its own against it
+//   -j n             assembles n units at a time (one per core by default)
+//   -c               assembles each unit into a relocatable object (file.obj)
+//                    instead of roms, keeping any object that is still up to date
+//   -link name       links the objects (those just assembled and any .obj given)
+//                    into name.programN.bin
+//   -base addr       packs relocatable code from addr on when linking
+//   -watch           builds once, then rebuilds whatever a changed file affects
+//                    until a key is pressed
+//   -cycles          writes file.cycles.lst next to each program, with the clock
+//                    cycles every line, basic block and label takes, worked out
+//                    from the microcode without running anything
+//   -stats file.json writes phase timings and counters to file.json once
+//                    assembly is done
 	if (argc < 2)
 	{
 		std::cout << "Please specify an input file!" << std::endl;
@@ -20,8 +50,58 @@ int main(int argc, char* argv[])
 		// try-catch any fatal errors
 		try
 		{
-			cpu cpu;
-			assembler assembler(argv[1], cpu);
+			std::vector<std::string> units;
+			std::vector<std::string> objects;
+			std::vector<std::string> includePaths;
+			std::string statsFile;
+			std::string archFile;
+			std::string linkName;
+			int threads = 0;
+			int base = -1;
+			bool compile = false;
+			bool watch = false;
+			bool cycles = false;
+
+			for (int i = 1; i < argc; i++)
+			{
+				std::string arg = argv[i];
+
+				if (arg == "-I" && i + 1 < argc)
+					includePaths.push_back(argv[++i]);
+				else if (arg.rfind("-I", 0) == 0 && arg.size() > 2)
+					includePaths.push_back(arg.substr(2));
+				else if (arg == "-stats" && i + 1 < argc)
+					statsFile = argv[++i];
+				else if (arg == "-arch" && i + 1 < argc)
+					archFile = argv[++i];
+				else if (arg == "-j" && i + 1 < argc)
+					threads = std::stoi(argv[++i]);
+				else if (arg == "-c")
+					compile = true;
+				else if (arg == "-watch")
+					watch = true;
+				else if (arg == "-cycles")
+					cycles = true;
+				else if (arg == "-link" && i + 1 < argc)
+					linkName = argv[++i];
+				else if (arg == "-base" && i + 1 < argc)
+				{
+					std::string value = argv[++i];
+					base = parser().parse_literal_num(value);
+				}
+				else if (arg.front() != '-')
+				{
+					bool isObject = arg.size() > std::strlen(OBJECT_EXTENSION) &&
+						arg.compare(arg.size() - std::strlen(OBJECT_EXTENSION), std::string::npos, OBJECT_EXTENSION) == 0;
+
+					(isObject ? objects : units).push_back(arg);
+				}
+				else
+					std::cout << "Ignoring unknown argument [" << arg << "]" << std::endl;
+			}
+
+			includePaths.push_back("code");
+			stats::instance().setEnabled(!statsFile.empty());
 
 			// set the echo verbosity - 8 bit value
 			//  -> bit 7 : echo architecture file definitions
@@ -32,9 +112,125 @@ int main(int argc, char* argv[])
 			//  -> bit 2 : echo minor parsing information
 			//  -> bit 1 : echo source code
 			//  -> bit 0 : echo rom contents
-			assembler.setEcho(0x7C);
+			const unsigned char echo = 0x7C;
+
+			if (watch && !units.empty())
+			{
+				// only warnings, so a rebuild isn't held up by the console
+				watcher w(units, includePaths, 0x10, std::cout);
+
+				if (!archFile.empty())
+					w.setArchitecture(archFile);
+
+				if (!linkName.empty())
+					w.setLink(linkName, base);
+
+				w.build();
+				std::cout << "\n-- watching for changes, press any key to stop\n";
+
+				while (!_kbhit())
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(50));
+					w.poll();
+				}
+
+				linkName.clear();
+			}
+			else if (units.empty())
+			{
+				if (linkName.empty())
+					std::cout << "Please specify an input file!" << std::endl;
+			}
+			else if (archFile.empty() && units.size() == 1)
+			{
+				cpu cpu;
+				assembler assembler(units[0], cpu);
+
+				for (const std::string& path : includePaths)
+					assembler.addIncludePath(path);
+
+				assembler.setEcho(echo);
+				assembler.setCycleListing(cycles);
+
+				if (compile)
+					objects.push_back(assembler.compile());
+				else
+					assembler.assemble();
+			}
+			else if (archFile.empty())
+			{
+				std::cout << "Please specify the architecture the units share with -arch!" << std::endl;
+			}
+			else
+			{
+				cpu architecture;
+				assembler archAssembler(archFile, architecture);
+
+				for (const std::string& path : includePaths)
+					archAssembler.addIncludePath(path);
+
+				archAssembler.setEcho(echo);
+				std::string archPath = archAssembler.loadArchitecture(archFile);
+
+				auto start = std::chrono::steady_clock::now();
+				std::vector<unitResult> results = assembleUnits(architecture, archPath, units, includePaths, echo, threads, compile, cycles);
+				auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+				// each unit's output comes out in one piece, in the order the units were given
+				size_t failed = 0;
+				size_t reused = 0;
+				for (const unitResult& r : results)
+				{
+					std::cout << "\n== " << r.file << " (" << r.ms << " ms)\n";
+					std::cout.write(r.output.data(), r.output.size());
+
+					if (!r.ok)
+					{
+						std::cout << "Fatal error: " << r.error << std::endl;
+						failed++;
+					}
+					else if (compile)
+					{
+						objects.push_back(r.object);
+						reused += r.reused ? 1 : 0;
+					}
+				}
+
+				std::cout << "\n-- assembled " << results.size() - failed << " of " << results.size() << " units";
+				if (compile)
+					std::cout << " (" << reused << " object(s) up to date)";
+				std::cout << " in " << elapsed.count() << " ms\n";
+
+				// don't link a program that is missing a unit
+				if (failed > 0)
+					linkName.clear();
+			}
+
+			if (!linkName.empty())
+			{
+				linker l;
+				l.setBase(base);
+
+				for (const std::string& name : objects)
+				{
+					objectFile o;
+					if (!o.load(name))
+					{
+						std::stringstream msg;
+						msg << "Could not read object file [" << name << "]!";
+						throw std::exception(msg.str().c_str());
+					}
+
+					l.add(name, std::move(o));
+				}
+
+				std::cout << "\n-- linking " << objects.size() << " object(s)\n";
+				l.link();
+				l.writeProgramRom(linkName, std::cout, true);
+			}
 
-			assembler.assemble();
+			if (!statsFile.empty())
+				stats::instance().writeJson(statsFile);
 		}
 		catch (const std::exception& e)
 		{
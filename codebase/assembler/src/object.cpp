@@ -0,0 +1,162 @@
+#include "object.h"
+#include "snapshot.h"
+#include "sourcefile.h"
+#include "stats.h"
+
+#include <fstream>
+
+bool objectFile::save(const std::string& filename) const
+{
+	snapshotWriter w;
+	w.u32(OBJECT_MAGIC);
+	w.u32(OBJECT_VERSION);
+	w.u64(archHash);
+	w.i32(programBits);
+
+	w.u32(static_cast<uint32_t>(sources.size()));
+	for (const objectSource& s : sources)
+	{
+		w.str(s.name);
+		w.u64(s.hash);
+	}
+
+	w.u32(static_cast<uint32_t>(sections.size()));
+	for (const objectSection& s : sections)
+	{
+		w.i32(s.segment);
+		w.u8(s.relocatable);
+		w.i32(s.origin);
+		w.str(std::string_view(reinterpret_cast<const char*>(s.data.data()), s.data.size()));
+	}
+
+	w.u32(static_cast<uint32_t>(symbols.size()));
+	for (const objectSymbol& s : symbols)
+	{
+		w.str(s.name);
+		w.u8(static_cast<uint8_t>(s.type));
+		w.i32(s.value);
+		w.i32(s.section);
+	}
+
+	w.u32(static_cast<uint32_t>(relocations.size()));
+	for (const objectRelocation& r : relocations)
+	{
+		w.i32(r.section);
+		w.i32(r.offset);
+		w.i32(r.width);
+		w.str(r.symbol);
+		w.i32(r.target);
+	}
+
+	std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	file.write(w.data().data(), w.data().size());
+	stats::instance().addBytesWritten(filename, w.data().size());
+
+	return file.good();
+}
+
+bool objectFile::load(const std::string& filename)
+{
+	sourcefile file;
+	if (!file.open(filename))
+		return false;
+
+	snapshotReader r(file.contents());
+
+	uint32_t magic, version, count;
+	if (!r.u32(magic) || magic != OBJECT_MAGIC || !r.u32(version) || version != OBJECT_VERSION)
+		return false;
+
+	objectFile o;
+	int32_t bits;
+	if (!r.u64(o.archHash) || !r.i32(bits))
+		return false;
+
+	o.programBits = bits;
+
+	if (!r.u32(count))
+		return false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		objectSource s;
+		if (!r.str(s.name) || !r.u64(s.hash))
+			return false;
+
+		o.sources.push_back(std::move(s));
+	}
+
+	if (!r.u32(count))
+		return false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		objectSection s;
+		int32_t segment, origin;
+		uint8_t relocatable;
+		std::string data;
+		if (!r.i32(segment) || !r.u8(relocatable) || !r.i32(origin) || !r.str(data))
+			return false;
+
+		s.segment = segment;
+		s.relocatable = relocatable != 0;
+		s.origin = origin;
+		s.data.assign(data.begin(), data.end());
+		o.sections.push_back(std::move(s));
+	}
+
+	if (!r.u32(count))
+		return false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		objectSymbol s;
+		uint8_t type;
+		int32_t value, section;
+		if (!r.str(s.name) || !r.u8(type) || !r.i32(value) || !r.i32(section))
+			return false;
+
+		s.type = static_cast<SymbolType>(type);
+		s.value = value;
+		s.section = section;
+		o.symbols.push_back(std::move(s));
+	}
+
+	if (!r.u32(count))
+		return false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		objectRelocation rel;
+		int32_t section, offset, width, target;
+		if (!r.i32(section) || !r.i32(offset) || !r.i32(width) || !r.str(rel.symbol) || !r.i32(target))
+			return false;
+
+		rel.section = section;
+		rel.offset = offset;
+		rel.width = width;
+		rel.target = target;
+		o.relocations.push_back(std::move(rel));
+	}
+
+	if (!r.done())
+		return false;
+
+	*this = std::move(o);
+	return true;
+}
+
+bool objectFile::sourcesUnchanged() const
+{
+	for (const objectSource& s : sources)
+	{
+		sourcefile source;
+		if (!source.open(s.name) || hashContents(source.contents()) != s.hash)
+			return false;
+	}
+
+	return true;
+}
\ No newline at end of file
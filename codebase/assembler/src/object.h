@@ -0,0 +1,80 @@
+#pragma once
+
+#include "symbol.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Relocatable objects. A unit assembled with -c goes into an object instead of straight into program
+// roms, and a link step puts any number of objects together. Every label is global, so one unit can
+// jump to another's without including it.
+//
+// Code that comes before any .org goes into a relocatable section, assembled as if it started at
+// address 0 and placed by the linker. Each .org starts an absolute section that stays where it was
+// put. A unit can't mix the two -- once code or a label has gone into the relocatable section, .org
+// is an error.
+constexpr uint32_t OBJECT_MAGIC = 0x4F534248; // "HBSO"
+constexpr uint32_t OBJECT_VERSION = 1;
+
+class objectSection
+{
+public:
+	int segment = 0;
+	bool relocatable = false;
+	int origin = 0;
+	std::vector<uint8_t> data;
+};
+
+// Labels, variables and constants the unit defines. A value in a relocatable section is relative to
+// where that section starts.
+class objectSymbol
+{
+public:
+	std::string name;
+	SymbolType type = SymbolType::None;
+	int value = 0;
+	int section = -1;
+};
+
+// A value the linker has to fill in, width bytes little-endian at offset into a section. With a
+// symbol, it is that symbol's final value. Without one, the bytes already hold an offset into the
+// target section, and the linker adds where that section ended up.
+class objectRelocation
+{
+public:
+	int section = 0;
+	int offset = 0;
+	int width = 0;
+	std::string symbol;
+	int target = -1;
+};
+
+// a file the unit was assembled from, and its content hash when it was
+class objectSource
+{
+public:
+	std::string name;
+	uint64_t hash = 0;
+};
+
+class objectFile
+{
+public:
+	// hash of the architecture the unit was assembled against (see cpu::architectureHash)
+	uint64_t archHash = 0;
+	int programBits = 0;
+
+	std::vector<objectSection> sections;
+	std::vector<objectSymbol> symbols;
+	std::vector<objectRelocation> relocations;
+	std::vector<objectSource> sources;
+
+	bool save(const std::string& filename) const;
+
+	// Fails (rather than throws) on a missing, truncated or foreign object
+	bool load(const std::string& filename);
+
+	// true when every file the object was assembled from still hashes the same
+	bool sourcesUnchanged() const;
+};
\ No newline at end of file
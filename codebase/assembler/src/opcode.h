@@ -3,6 +3,9 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
+
+#include "flagset.h"
 
 enum class ArgType { None, Register, Numeral, Ascii, DerefReg, DerefNum, DerefAscii };
 enum class PatternType { None, Seq, Seq_If, Seq_Else };
@@ -11,15 +14,106 @@ class controlPattern
 {
 public:
 	int pattern;
-	std::vector<int> flags;
+	flagSet flags;
 	PatternType type;
+
+	bool operator==(const controlPattern& other) const { return pattern == other.pattern && type == other.type && flags == other.flags; }
 };
 
+// One cycle of an opcode's microcode -- a seq_if and its seq_else share a cycle
 class controlPatterns
 {
 public:
 	controlPattern cpattern[2];
 	int count;
+
+	bool operator==(const controlPatterns& other) const
+	{
+		if (count != other.count)
+			return false;
+
+		for (int i = 0; i < count; i++)
+			if (!(cpattern[i] == other.cpattern[i]))
+				return false;
+
+		return true;
+	}
+};
+
+// Builds the unique string of an opcode (e.g. mov_a_# or mov_[dx]_a) from its mnemonic and argument
+// kinds in a fixed buffer, so instructions can be matched to their encoding without allocating
+class opcodeSignature
+{
+public:
+	static constexpr size_t MAX_LENGTH = 64;
+
+	opcodeSignature(std::string_view mnemonic)
+	{
+		append(mnemonic);
+	}
+
+	// reg is the bare register name, and is only used by register arguments. An argument that isn't
+	// there leaves the signature as it is.
+	void addArg(ArgType t, std::string_view reg = { })
+	{
+		if (t == ArgType::None)
+			return;
+
+		append("_");
+
+		switch (t)
+		{
+		case ArgType::None:
+			break;
+
+		case ArgType::Register:
+			append(reg);
+			break;
+
+		case ArgType::DerefReg:
+			append("[");
+			append(reg);
+			append("]");
+			break;
+
+		case ArgType::Numeral:
+			append("#");
+			break;
+
+		case ArgType::DerefNum:
+			append("[#]");
+			break;
+
+		case ArgType::Ascii:
+			append("ASCII");
+			break;
+
+		case ArgType::DerefAscii:
+			append("[ASCII]");
+			break;
+		}
+	}
+
+	std::string_view view() const { return std::string_view(_buffer, _length); }
+	bool overflowed() const { return _overflow; }
+
+private:
+	void append(std::string_view s)
+	{
+		if (_length + s.size() > MAX_LENGTH)
+		{
+			_overflow = true;
+			return;
+		}
+
+		s.copy(_buffer + _length, s.size());
+		_length += s.size();
+	}
+
+private:
+	char _buffer[MAX_LENGTH];
+	size_t _length = 0;
+	bool _overflow = false;
 };
 
 class opcode
@@ -37,100 +131,64 @@ public:
 	{
 		_mnemonic = "";
 		_value = -1;
-		_controlPatterns.clear();
 		_arguments.clear();
 	}
 
-	void setMnemonic(const std::string& s) { _mnemonic = s; }
+	void setMnemonic(const std::string& s) { _mnemonic = s; updateUniqueString(); }
 	void setValue(const int& v) { _value = v; }
 
-	void addNewControlPattern(const controlPattern& p)
-	{
-		std::vector<int> flags;
-		for (int i = 0; i < p.flags.size(); i++)
-		{
-			flags.push_back(p.flags[i]);
-		}
+	void addArgument(arg a) { _arguments.push_back(a); updateUniqueString(); }
 
-		controlPatterns cp;
-		cp.count = 1;
-		cp.cpattern[0].pattern = p.pattern;
-		cp.cpattern[0].type = p.type;
-		cp.cpattern[0].flags = flags;
+	const std::string& mnemonic() const { return _mnemonic; }
+	int value() const { return _value; }
+	int numArgs() const { return static_cast<int>(_arguments.size()); }
+	const arg& getArg(int i) const { return _arguments[i]; }
 
-		_controlPatterns.push_back(cp);
-	}
+	// the control patterns themselves live in the opcode table's shared pool (see opcodetable.h) --
+	// sequence() is the node there for the last of the opcode's numCycles() cycles
+	int sequence() const { return _sequence; }
+	int numCycles() const { return _numCycles; }
+
+	// the unique string is rebuilt whenever the mnemonic or arguments change, so reading it is free
+	const std::string& getUniqueString() const { return _uniqueString; }
 
-	void addToLastControlPattern(const controlPattern& p)
+	opcodeSignature signature() const
 	{
-		if (_controlPatterns.size() <= 0) return;
+		opcodeSignature sig(_mnemonic);
 
-		std::vector<int> flags;
-		for (int i = 0; i < p.flags.size(); i++)
+		for (const arg& a : _arguments)
 		{
-			flags.push_back(p.flags[i]);
-		}
+			// dereferenced registers are stored with their brackets
+			std::string_view reg = a._string;
+			if (a._type == ArgType::DerefReg && reg.size() > 2)
+				reg = reg.substr(1, reg.size() - 2);
 
-		controlPatterns cp = _controlPatterns[_controlPatterns.size() - 1];
-		cp.count++;
-		cp.cpattern[cp.count - 1].pattern = p.pattern;
-		cp.cpattern[cp.count - 1].type = p.type;
-		cp.cpattern[cp.count - 1].flags = flags;
+			sig.addArg(a._type, reg);
+		}
 
-		_controlPatterns[_controlPatterns.size() - 1] = cp;
+		return sig;
 	}
 
-	void addArgument(arg a) { _arguments.push_back(a); }
-
-	std::string mnemonic() { return _mnemonic; }
-	int value() { return _value; }
-	int numArgs() { return _arguments.size(); }
-	arg getArg(int i) { return _arguments[i]; }
-	int numCycles() { return _controlPatterns.size(); }
-	controlPatterns& getPatterns(int i) { return _controlPatterns[i]; }
-
-	controlPattern getPattern(int i, int j) { return _controlPatterns[i].cpattern[j]; }
-
-	std::string getUniqueString()
+private:
+	void updateUniqueString()
 	{
-		std::string unique_str = _mnemonic + "_";
-
-		for (int i = 0; i < _arguments.size(); i++)
+		opcodeSignature sig = signature();
+		if (sig.overflowed())
 		{
-			switch (_arguments[i]._type)
-			{
-			case ArgType::Register:
-			case ArgType::DerefReg:
-				unique_str += _arguments[i]._string + "_";
-				break;
-
-			case ArgType::Numeral:
-				unique_str += "#_";
-				break;
-
-			case ArgType::DerefNum:
-				unique_str += "[#]_";
-				break;
-
-			case ArgType::Ascii:
-				unique_str += "ASCII_";
-				break;
-
-			case ArgType::DerefAscii:
-				unique_str += "[ASCII]_";
-				break;
-			}
+			std::string msg = "Opcode signature for [" + _mnemonic + "] is longer than " + std::to_string(opcodeSignature::MAX_LENGTH) + " characters!";
+			throw std::exception(msg.c_str());
 		}
 
-		// Erase the '_' character on the end
-		unique_str = std::string(unique_str.begin(), unique_str.end() - 1);
-
-		return unique_str;
+		_uniqueString = std::string(sig.view());
 	}
 
 private:
 	std::string _mnemonic;
 	int _value;
-	std::vector<controlPatterns> _controlPatterns;
 	std::vector<arg> _arguments;
+	std::string _uniqueString;
+	int _sequence = -1;
+	int _numCycles = 0;
+
+	friend class opcodeTable;
 };
\ No newline at end of file
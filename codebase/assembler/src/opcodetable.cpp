@@ -0,0 +1,247 @@
+#include "opcodetable.h"
+
+#include <assert.h>
+
+void opcodeTable::reserve(int instructionWidth)
+{
+	if (instructionWidth <= 0)
+		return;
+
+	_valueBits = instructionWidth * 8;
+	if (_valueBits > MAX_RESERVED_BITS)
+		return;
+
+	size_t count = size_t(1) << _valueBits;
+	if (count > _slots.size())
+		_slots.resize(count, -1);
+
+	_opcodes.reserve(count);
+}
+
+bool opcodeTable::add(int v, const opcode& oc)
+{
+	if (!fits(v))
+		return false;
+
+	if (static_cast<size_t>(v) >= _slots.size())
+		_slots.resize(static_cast<size_t>(v) + 1, -1);
+
+	if (_slots[v] >= 0)
+		return false;
+
+	_slots[v] = static_cast<int>(_opcodes.size());
+	_opcodes.push_back(oc);
+
+	// whatever cycles the copy came with belong to another table
+	_opcodes.back()._sequence = -1;
+	_opcodes.back()._numCycles = 0;
+
+	return true;
+}
+
+opcode* opcodeTable::find(int v)
+{
+	if (v < 0 || static_cast<size_t>(v) >= _slots.size() || _slots[v] < 0)
+		return nullptr;
+
+	return &_opcodes[_slots[v]];
+}
+
+const opcode* opcodeTable::find(int v) const
+{
+	if (v < 0 || static_cast<size_t>(v) >= _slots.size() || _slots[v] < 0)
+		return nullptr;
+
+	return &_opcodes[_slots[v]];
+}
+
+void opcodeTable::addCycle(int v, const controlPattern& p)
+{
+	opcode* oc = find(v);
+	assert(oc != nullptr);
+
+	controlPatterns cps;
+	cps.cpattern[0] = p;
+	cps.count = 1;
+
+	setSequence(*oc, internNode(internCycle(cps), oc->_sequence));
+	oc->_numCycles++;
+}
+
+// The last cycle can't be changed where it is, as other opcodes may share it -- the opcode moves to
+// the node for the cycle with both patterns instead
+bool opcodeTable::addToLastCycle(int v, const controlPattern& p)
+{
+	opcode* oc = find(v);
+	if (oc == nullptr || oc->_numCycles == 0)
+		return false;
+
+	int last = oc->_sequence;
+	controlPatterns cps = _cycles[_nodes[last].cycle];
+	if (cps.count >= 2)
+		return false;
+
+	cps.cpattern[cps.count++] = p;
+
+	// hold on to the cycles before it while the last one is let go, which is usually dropped for good
+	// (a seq_if nobody else has) before the new one goes in
+	int parent = _nodes[last].parent;
+	if (parent >= 0)
+		_nodes[parent].refs++;
+
+	setSequence(*oc, -1);
+	setSequence(*oc, internNode(internCycle(cps), parent));
+
+	release(parent);
+	return true;
+}
+
+int opcodeTable::cycleId(const opcode& oc, int c) const
+{
+	int node = oc._sequence;
+	for (int i = oc._numCycles - 1; i > c; i--)
+		node = _nodes[node].parent;
+
+	return _nodes[node].cycle;
+}
+
+void opcodeTable::cycleIds(const opcode& oc, std::vector<int>& ids) const
+{
+	ids.resize(oc._numCycles);
+
+	int node = oc._sequence;
+	for (int i = oc._numCycles - 1; i >= 0; i--)
+	{
+		ids[i] = _nodes[node].cycle;
+		node = _nodes[node].parent;
+	}
+}
+
+opcodeTable::sharingReport opcodeTable::sharing() const
+{
+	sharingReport r;
+	r.opcodes = size();
+	r.distinctCycles = numDistinctCycles();
+	r.sequenceNodes = static_cast<int>(_nodes.size());
+
+	for (const opcode& oc : _opcodes)
+		r.cycles += oc._numCycles;
+
+	return r;
+}
+
+int opcodeTable::internCycle(const controlPatterns& cps)
+{
+	uint64_t hash = hashCycle(cps);
+
+	auto range = _cycleIndex.equal_range(hash);
+	for (auto i = range.first; i != range.second; ++i)
+		if (_cycles[i->second] == cps)
+			return i->second;
+
+	int id = static_cast<int>(_cycles.size());
+	_cycles.push_back(cps);
+	_cycleRefs.push_back(0);
+	_cycleIndex.emplace(hash, id);
+
+	return id;
+}
+
+int opcodeTable::internNode(int cycle, int parent)
+{
+	auto i = _nodeIndex.find(nodeKey(cycle, parent));
+	if (i != _nodeIndex.end())
+		return i->second;
+
+	int id = static_cast<int>(_nodes.size());
+	_nodes.push_back({ cycle, parent, 0 });
+	_nodeIndex.emplace(nodeKey(cycle, parent), id);
+
+	_cycleRefs[cycle]++;
+	if (parent >= 0)
+		_nodes[parent].refs++;
+
+	return id;
+}
+
+void opcodeTable::setSequence(opcode& oc, int node)
+{
+	if (node >= 0)
+		_nodes[node].refs++;
+
+	int old = oc._sequence;
+	oc._sequence = node;
+
+	release(old);
+}
+
+// Drop a reference to a node. Only the newest node (and then the newest cycle) can be taken back out
+// of the pool, which covers what gets dropped while building -- anything else that ends up unused
+// simply stays behind.
+void opcodeTable::release(int node)
+{
+	while (node >= 0)
+	{
+		if (--_nodes[node].refs > 0 || node != static_cast<int>(_nodes.size()) - 1)
+			return;
+
+		sequenceNode n = _nodes.back();
+		_nodeIndex.erase(nodeKey(n.cycle, n.parent));
+		_nodes.pop_back();
+
+		if (--_cycleRefs[n.cycle] == 0 && n.cycle == numDistinctCycles() - 1)
+		{
+			auto range = _cycleIndex.equal_range(hashCycle(_cycles.back()));
+			for (auto i = range.first; i != range.second; ++i)
+			{
+				if (i->second == n.cycle)
+				{
+					_cycleIndex.erase(i);
+					break;
+				}
+			}
+
+			_cycles.pop_back();
+			_cycleRefs.pop_back();
+		}
+
+		// the node before it just lost a follower
+		node = n.parent;
+	}
+}
+
+// 64-bit FNV-1a over every field that makes two cycles different
+uint64_t opcodeTable::hashCycle(const controlPatterns& cps)
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&](uint32_t v)
+	{
+		for (int b = 0; b < 4; b++)
+		{
+			hash ^= (v >> (8 * b)) & 0xFF;
+			hash *= 1099511628211ull;
+		}
+	};
+
+	mix(static_cast<uint32_t>(cps.count));
+	for (int i = 0; i < cps.count; i++)
+	{
+		const controlPattern& cp = cps.cpattern[i];
+		mix(static_cast<uint32_t>(cp.pattern));
+		mix(static_cast<uint32_t>(cp.type));
+		mix(cp.flags.complemented() ? 1 : 0);
+
+		for (const flagCube& cube : cp.flags.cubes())
+		{
+			mix(cube.value);
+			mix(cube.mask);
+		}
+	}
+
+	return hash;
+}
+
+uint64_t opcodeTable::nodeKey(int cycle, int parent)
+{
+	return (static_cast<uint64_t>(static_cast<uint32_t>(cycle)) << 32) | static_cast<uint32_t>(parent + 1);
+}
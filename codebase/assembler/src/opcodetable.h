@@ -0,0 +1,119 @@
+#pragma once
+
+#include "opcode.h"
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Opcodes indexed directly by their value. The slots are sized from the instruction width, so a
+// lookup is a single index, and asking for a value that was never defined finds nothing rather than
+// making an empty opcode.
+//
+// The microcode lives in a pool shared by every opcode, hash-consed so nothing is stored twice:
+//  - each distinct cycle (the patterns of one seq, or a seq_if with its seq_else) is kept once and
+//    known by its ID, however many opcodes use it
+//  - sequences are nodes of a tree, each holding one cycle and the node of the cycles before it, so
+//    opcodes that start the same way (nearly all of them start with the fetch cycles) share those
+//    nodes, and identical sequences are a single node
+// An opcode only holds the node of its last cycle. Whatever works per cycle, like filling a decoder
+// rom block, can be done once per distinct cycle and reused.
+class opcodeTable
+{
+public:
+	// make room for every value an instruction of this width (in bytes, as instruction_width gives it)
+	// can encode -- from then on, values that don't fit are turned away
+	void reserve(int instructionWidth);
+	bool fits(int v) const { return v >= 0 && (_valueBits <= 0 || _valueBits >= 31 || v < (1 << _valueBits)); }
+
+	// false when v already has an opcode (the first definition stays) or doesn't fit
+	bool add(int v, const opcode& oc);
+
+	opcode* find(int v);
+	const opcode* find(int v) const;
+
+	bool empty() const { return _opcodes.empty(); }
+	int size() const { return static_cast<int>(_opcodes.size()); }
+
+	// microcode -- a new cycle for opcode v, or a second pattern in its last cycle (false when
+	// there's no cycle with room for one)
+	void addCycle(int v, const controlPattern& p);
+	bool addToLastCycle(int v, const controlPattern& p);
+
+	// an opcode's cycles, as IDs of distinct cycles -- cycleIds fills in all of them at once
+	int cycleId(const opcode& oc, int c) const;
+	void cycleIds(const opcode& oc, std::vector<int>& ids) const;
+	const controlPatterns& getCycle(const opcode& oc, int c) const { return _cycles[cycleId(oc, c)]; }
+
+	int numDistinctCycles() const { return static_cast<int>(_cycles.size()); }
+	const controlPatterns& getDistinctCycle(int id) const { return _cycles[id]; }
+
+	// how much of the microcode turned out to be shared
+	struct sharingReport
+	{
+		int opcodes = 0;
+		int cycles = 0;
+		int distinctCycles = 0;
+		int sequenceNodes = 0;
+	};
+
+	sharingReport sharing() const;
+
+	// the opcodes in value order
+	class const_iterator
+	{
+	public:
+		const_iterator(const opcodeTable& t, size_t slot) : _table(t), _slot(slot) { skipEmpty(); }
+
+		const opcode& operator*() const { return _table._opcodes[_table._slots[_slot]]; }
+		const opcode* operator->() const { return &**this; }
+		const_iterator& operator++() { _slot++; skipEmpty(); return *this; }
+		bool operator!=(const const_iterator& other) const { return _slot != other._slot; }
+
+	private:
+		void skipEmpty()
+		{
+			while (_slot < _table._slots.size() && _table._slots[_slot] < 0)
+				_slot++;
+		}
+
+	private:
+		const opcodeTable& _table;
+		size_t _slot;
+	};
+
+	const_iterator begin() const { return const_iterator(*this, 0); }
+	const_iterator end() const { return const_iterator(*this, _slots.size()); }
+
+private:
+	// refs counts the opcodes that end on a node plus the nodes that follow on from it
+	struct sequenceNode
+	{
+		int cycle;
+		int parent;
+		int refs;
+	};
+
+	int internCycle(const controlPatterns& cps);
+	int internNode(int cycle, int parent);
+	void setSequence(opcode& oc, int node);
+	void release(int node);
+
+	static uint64_t hashCycle(const controlPatterns& cps);
+	static uint64_t nodeKey(int cycle, int parent);
+
+private:
+	// wider instructions than this grow the slots as values turn up instead
+	static constexpr int MAX_RESERVED_BITS = 16;
+
+	int _valueBits = 0;
+	std::vector<int> _slots;
+	std::vector<opcode> _opcodes;
+
+	std::vector<controlPatterns> _cycles;
+	std::vector<int> _cycleRefs;
+	std::unordered_multimap<uint64_t, int> _cycleIndex;
+
+	std::vector<sequenceNode> _nodes;
+	std::unordered_map<uint64_t, int> _nodeIndex;
+};
@@ -1,11 +1,12 @@
 #include "parser.h"
 #include "config.h"
+#include "stats.h"
 
 #include <algorithm>
 
 // commands cannot start with a digit and can contain any non-register alphanumeric or underscore
 // characters
-bool parser::is_command(const std::string& s)
+bool parser::is_command(std::string_view s)
 {
 	return s.size() > 0 &&
 		!isdigit(s.front()) &&
@@ -20,7 +21,7 @@ bool parser::is_command(const std::string& s)
 }
 
 // directives start with the DIRECTIVE_KEY (see symbolConfig.h), and are otherwise alphanumeric
-bool parser::is_directive(const std::string& s)
+bool parser::is_directive(std::string_view s)
 {
 	return s.size() > 1 && s.front() == DIRECTIVE_KEY && std::all_of(s.begin() + 1, s.end(), [](char c) { return isalnum(c); });
 }
@@ -44,6 +45,17 @@ void parser::strip_comment(std::string& s)
 	}
 }
 
+// Same as above, but only narrows the view so no characters are copied or moved
+void parser::strip_comment(std::string_view& s)
+{
+	size_t pos = s.find_first_of(COMMENT_KEY);
+
+	if (pos != std::string_view::npos)
+	{
+		s = s.substr(0, pos);
+	}
+}
+
 // Strip indirectly addressed values by only returning the characters between the INDIRECT_BEGIN_KEY and INDIRECT_END_KEY
 bool parser::try_strip_indirect(std::string& s)
 {
@@ -84,10 +96,12 @@ std::optional<std::string> parser::extract_token_ws(std::string& s)
 			s.erase(s.begin(), delimiter);
 
 			// Return the string token
+			stats::instance().count(StatCounter::Tokens);
 			return t;
 		}
 		else
 		{
+			stats::instance().count(StatCounter::Tokens);
 			return std::move(s);
 		}
 	}
@@ -95,6 +109,30 @@ std::optional<std::string> parser::extract_token_ws(std::string& s)
 	return { };
 }
 
+// View version of the function above. The token is a view into the same characters, and the
+// passed-in view is advanced past it rather than erased from the front.
+std::optional<std::string_view> parser::extract_token_ws(std::string_view& s)
+{
+	const auto begin = std::find_if(s.begin(), s.end(), [](char c) { return !isspace(c); });
+	s.remove_prefix(begin - s.begin());
+
+	if (s.size() > 0)
+	{
+		const auto delimiter = std::find_if(s.begin(), s.end(), [](char c)
+			{
+				return (isspace(c));
+			});
+
+		std::string_view t = s.substr(0, delimiter - s.begin());
+		s.remove_prefix(t.size());
+
+		stats::instance().count(StatCounter::Tokens);
+		return t;
+	}
+
+	return { };
+}
+
 // Similar idea to the function above, except it also includes commas as characters to parse out
 std::optional<std::string> parser::extract_token_ws_comma(std::string& s)
 {
@@ -111,10 +149,12 @@ std::optional<std::string> parser::extract_token_ws_comma(std::string& s)
 		{
 			std::string t = std::string(s.begin(), delimiter);
 			s.erase(s.begin(), delimiter + 1);
+			stats::instance().count(StatCounter::Tokens);
 			return t;
 		}
 		else
 		{
+			stats::instance().count(StatCounter::Tokens);
 			return std::move(s);
 		}
 	}
@@ -1,30 +1,28 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <optional>
 
 // formats for literal number types
 enum class LiteralNumType { None, Binary, Decimal, Hexadecimal };
 
+// Every assembler owns one (see assembler::getParser), so units assembling on different threads
+// never share a parser
 class parser
 {
 public:
-	// singleton
-	static parser& instance()
-	{
-		static parser _instance;
-		return _instance;
-	}
-
-	bool is_command(const std::string& s);
-	bool is_directive(const std::string& s);
+	bool is_command(std::string_view s);
+	bool is_directive(std::string_view s);
 	bool is_indirect(const std::string& s);
 	
 	void strip_comment(std::string& s);
+	void strip_comment(std::string_view& s);
 
 	bool try_strip_indirect(std::string& s);
 
 	std::optional<std::string> extract_token_ws(std::string& s);
+	std::optional<std::string_view> extract_token_ws(std::string_view& s);
 	std::optional<std::string> extract_token_ws_comma(std::string& s);
 	std::optional<std::string> extract_token_str(std::string& s);
 
@@ -0,0 +1,156 @@
+#include "rom.h"
+#include "stats.h"
+
+#include <fstream>
+#include <sstream>
+#include <exception>
+
+std::string decoderRomLayout::describe() const
+{
+	int flagLo = 0;
+	int cycleLo = flagLo + flagBits;
+	int opcodeLo = cycleLo + cycleBits;
+	int used = opcodeLo + opcodeBits;
+
+	std::stringstream s;
+	s << addressBits << " address bits = ";
+
+	if (addressBits > used)
+		s << "unused[" << addressBits - 1 << ":" << used << "] ";
+
+	s << "opcode[" << used - 1 << ":" << opcodeLo << "] ";
+
+	if (cycleBits > 0)
+		s << "cycle[" << opcodeLo - 1 << ":" << cycleLo << "] ";
+
+	if (flagBits > 0)
+		s << "flags[" << cycleLo - 1 << ":" << flagLo << "]";
+
+	s << ", " << wordBits << " control bits over " << romCount << " x " << romBits << "-bit rom(s)";
+
+	return s.str();
+}
+
+std::vector<uint8_t> sliceRomImage(const std::vector<uint32_t>& image, int firstBit, int bits)
+{
+	size_t width = bits <= 8 ? 1 : (bits <= 16 ? 2 : 4);
+	uint32_t mask = bits >= 32 ? 0xFFFFFFFFu : ((1u << bits) - 1);
+
+	std::vector<uint8_t> data(image.size() * width);
+	uint8_t* out = data.data();
+
+	for (uint32_t word : image)
+	{
+		uint32_t v = (word >> firstBit) & mask;
+
+		for (size_t b = 0; b < width; b++)
+			*out++ = static_cast<uint8_t>(v >> (8 * b));
+	}
+
+	return data;
+}
+
+void writeRomImage(const std::string& filename, const std::vector<uint8_t>& data)
+{
+	scopedTimer timer("output");
+	std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::string msg = "Could not open rom file [" + filename + "] for writing!";
+		throw std::exception(msg.c_str());
+	}
+
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	stats::instance().addBytesWritten(filename, data.size());
+}
+
+size_t patchRomImage(const std::string& filename, const std::vector<uint8_t>& data)
+{
+	scopedTimer timer("output");
+
+	std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+	if (!file.is_open() || !file.seekg(0, std::ios::end) || static_cast<size_t>(file.tellg()) != data.size())
+	{
+		file.close();
+		writeRomImage(filename, data);
+		return data.size();
+	}
+
+	std::vector<uint8_t> old(data.size());
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(old.data()), old.size());
+
+	// differences closer together than this go out as one write
+	constexpr size_t GAP = 16;
+
+	size_t written = 0;
+	size_t i = 0;
+	while (i < data.size())
+	{
+		if (old[i] == data[i])
+		{
+			i++;
+			continue;
+		}
+
+		size_t start = i;
+		size_t end = i + 1;
+		for (size_t k = end; k < data.size() && k < end + GAP; k++)
+			if (old[k] != data[k])
+				end = k + 1;
+
+		file.seekp(start);
+		file.write(reinterpret_cast<const char*>(data.data() + start), end - start);
+		written += end - start;
+		i = end;
+	}
+
+	if (!file.good())
+	{
+		std::string msg = "Could not update rom file [" + filename + "]!";
+		throw std::exception(msg.c_str());
+	}
+
+	stats::instance().addBytesWritten(filename, written);
+	return written;
+}
+
+std::string hexDumpRomImage(const std::vector<uint8_t>& data, size_t wordBytes)
+{
+	static const char digits[] = "0123456789ABCDEF";
+	const size_t wordsPerLine = 16 / wordBytes;
+	const size_t words = data.size() / wordBytes;
+
+	// "AAAAAAAA:" plus " WW.." per word plus newline
+	std::string dump;
+	dump.reserve((words / wordsPerLine + 1) * (10 + wordsPerLine * (wordBytes * 2 + 1) + 1));
+
+	for (size_t w = 0; w < words; w++)
+	{
+		if (w % wordsPerLine == 0)
+		{
+			if (w != 0)
+				dump += '\n';
+
+			for (int shift = 28; shift >= 0; shift -= 4)
+				dump += digits[(w >> shift) & 0xF];
+
+			dump += ':';
+		}
+
+		dump += ' ';
+
+		// most significant byte first, so multi-byte words read naturally
+		for (size_t b = wordBytes; b-- > 0;)
+		{
+			uint8_t v = data[w * wordBytes + b];
+			dump += digits[v >> 4];
+			dump += digits[v & 0xF];
+		}
+	}
+
+	if (!dump.empty())
+		dump += '\n';
+
+	return dump;
+}
\ No newline at end of file
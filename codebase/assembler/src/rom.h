@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Address layout of the decoder rom. From the most significant bit down, an address is made of the
+// opcode, the cycle within that opcode and the current flag states.
+class decoderRomLayout
+{
+public:
+	int opcodeBits = 0;
+	int cycleBits = 0;
+	int flagBits = 0;
+
+	// as declared by decoder_rom -- at least the sum of the fields above
+	int addressBits = 0;
+
+	// number of control bits actually used, and how they get spread over rom chips
+	int wordBits = 0;
+	int romBits = 0;
+	int romCount = 0;
+
+	uint32_t address(uint32_t opcode, uint32_t cycle, uint32_t flags) const
+	{
+		return (opcode << (cycleBits + flagBits)) | (cycle << flagBits) | flags;
+	}
+
+	size_t entries() const { return size_t(1) << addressBits; }
+	size_t cycleBlock() const { return size_t(1) << flagBits; }
+	size_t opcodeBlock() const { return size_t(1) << (cycleBits + flagBits); }
+
+	std::string describe() const;
+};
+
+// Pull bits [firstBit, firstBit + bits) out of every word of a rom image and pack them into the
+// smallest little-endian element that fits (1, 2 or 4 bytes) -- one rom chip's worth of data
+std::vector<uint8_t> sliceRomImage(const std::vector<uint32_t>& image, int firstBit, int bits);
+
+// Write a rom image in one go, as raw binary
+void writeRomImage(const std::string& filename, const std::vector<uint8_t>& data);
+
+// Bring a rom image on disk up to date by writing only the runs of bytes that differ. A missing file,
+// or one of another size, is written whole. Returns the number of bytes written.
+size_t patchRomImage(const std::string& filename, const std::vector<uint8_t>& data);
+
+// Format a rom image as lines of "address: words", with wordBytes-sized little-endian words. The
+// whole dump is built in one string so it can be written out in one go.
+std::string hexDumpRomImage(const std::vector<uint8_t>& data, size_t wordBytes = 1);
\ No newline at end of file
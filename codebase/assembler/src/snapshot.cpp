@@ -0,0 +1,157 @@
+#include "snapshot.h"
+#include "sourcefile.h"
+#include "cpu.h"
+#include "stats.h"
+
+#include <fstream>
+
+uint64_t hashContents(std::string_view data)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+
+	for (char c : data)
+	{
+		h ^= static_cast<uint8_t>(c);
+		h *= 0x100000001b3ull;
+	}
+
+	return h;
+}
+
+void snapshotWriter::u32(uint32_t v)
+{
+	for (int b = 0; b < 4; b++)
+		u8(static_cast<uint8_t>(v >> (8 * b)));
+}
+
+void snapshotWriter::u64(uint64_t v)
+{
+	for (int b = 0; b < 8; b++)
+		u8(static_cast<uint8_t>(v >> (8 * b)));
+}
+
+void snapshotWriter::str(std::string_view s)
+{
+	u32(static_cast<uint32_t>(s.size()));
+	_data.append(s.data(), s.size());
+}
+
+bool snapshotReader::u8(uint8_t& v)
+{
+	if (_cursor >= _data.size())
+		return false;
+
+	v = static_cast<uint8_t>(_data[_cursor++]);
+	return true;
+}
+
+bool snapshotReader::u32(uint32_t& v)
+{
+	v = 0;
+	for (int b = 0; b < 4; b++)
+	{
+		uint8_t byte;
+		if (!u8(byte))
+			return false;
+
+		v |= static_cast<uint32_t>(byte) << (8 * b);
+	}
+
+	return true;
+}
+
+bool snapshotReader::u64(uint64_t& v)
+{
+	v = 0;
+	for (int b = 0; b < 8; b++)
+	{
+		uint8_t byte;
+		if (!u8(byte))
+			return false;
+
+		v |= static_cast<uint64_t>(byte) << (8 * b);
+	}
+
+	return true;
+}
+
+bool snapshotReader::i32(int32_t& v)
+{
+	uint32_t u;
+	if (!u32(u))
+		return false;
+
+	v = static_cast<int32_t>(u);
+	return true;
+}
+
+bool snapshotReader::str(std::string& s)
+{
+	uint32_t size;
+	if (!u32(size) || size > _data.size() - _cursor)
+		return false;
+
+	s.assign(_data.data() + _cursor, size);
+	_cursor += size;
+	return true;
+}
+
+bool loadArchSnapshot(const std::string& snapFile, cpu& c, std::vector<std::string>* sources)
+{
+	sourcefile snap;
+	if (!snap.open(snapFile))
+		return false;
+
+	snapshotReader r(snap.contents());
+
+	uint32_t magic, version, count;
+	if (!r.u32(magic) || magic != SNAPSHOT_MAGIC || !r.u32(version) || version != SNAPSHOT_VERSION || !r.u32(count))
+		return false;
+
+	// every file the architecture was parsed from must still be exactly the same
+	for (uint32_t i = 0; i < count; i++)
+	{
+		std::string name;
+		uint64_t hash;
+		if (!r.str(name) || !r.u64(hash))
+			return false;
+
+		sourcefile source;
+		if (!source.open(name) || hashContents(source.contents()) != hash)
+			return false;
+
+		if (sources)
+			sources->push_back(name);
+	}
+
+	return c.loadArchitecture(r);
+}
+
+bool saveArchSnapshot(const std::string& snapFile, const cpu& c, const std::vector<std::string>& sources)
+{
+	snapshotWriter w;
+	w.u32(SNAPSHOT_MAGIC);
+	w.u32(SNAPSHOT_VERSION);
+
+	w.u32(static_cast<uint32_t>(sources.size()));
+	for (const std::string& name : sources)
+	{
+		sourcefile source;
+		if (!source.open(name))
+			return false;
+
+		w.str(name);
+		w.u64(hashContents(source.contents()));
+	}
+
+	c.saveArchitecture(w);
+
+	std::ofstream file(snapFile, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	file.write(w.data().data(), w.data().size());
+	stats::instance().addBytesWritten(snapFile, w.data().size());
+
+	return file.good();
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+class cpu;
+
+// Parsing a big architecture file is most of the work of assembling a small program, and the
+// architecture hardly ever changes between runs. Once parsed, the cpu's architecture state is saved
+// next to the .arch file as a binary snapshot, together with a content hash of every file that went
+// into it. Later runs load the snapshot instead, as long as none of those files changed.
+constexpr uint32_t SNAPSHOT_MAGIC = 0x48534248; // "HBSH"
+constexpr uint32_t SNAPSHOT_VERSION = 5;
+
+// 64-bit FNV-1a
+uint64_t hashContents(std::string_view data);
+
+// Fixed-width little-endian values appended to one buffer, so the snapshot reads the same on any host
+class snapshotWriter
+{
+public:
+	void u8(uint8_t v) { _data += static_cast<char>(v); }
+	void u32(uint32_t v);
+	void u64(uint64_t v);
+	void i32(int32_t v) { u32(static_cast<uint32_t>(v)); }
+	void str(std::string_view s);
+
+	const std::string& data() const { return _data; }
+
+private:
+	std::string _data;
+};
+
+// Every read fails (rather than throws) once the data runs out -- a truncated or foreign snapshot
+// just means the architecture gets parsed again
+class snapshotReader
+{
+public:
+	snapshotReader(std::string_view data) : _data(data) {}
+
+	bool u8(uint8_t& v);
+	bool u32(uint32_t& v);
+	bool u64(uint64_t& v);
+	bool i32(int32_t& v);
+	bool str(std::string& s);
+
+	bool done() const { return _cursor == _data.size(); }
+
+private:
+	std::string_view _data;
+	size_t _cursor = 0;
+};
+
+// Fill the cpu from a snapshot. Returns false, leaving the cpu untouched, when there is no usable
+// snapshot or any of the files it was built from no longer hash the same. Those files are listed in
+// sources when it is given.
+bool loadArchSnapshot(const std::string& snapFile, cpu& c, std::vector<std::string>* sources = nullptr);
+
+// Save the cpu's architecture along with the hashes of the files it was parsed from. Returns false
+// when the snapshot could not be written.
+bool saveArchSnapshot(const std::string& snapFile, const cpu& c, const std::vector<std::string>& sources);
\ No newline at end of file
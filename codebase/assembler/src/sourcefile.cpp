@@ -0,0 +1,170 @@
+#include "sourcefile.h"
+
+#include <fstream>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool sourcefile::open(const std::string& filename)
+{
+	close();
+	_name = filename;
+
+	// Try to map the file first, and fall back to reading the whole thing in one go
+	if (!map())
+	{
+		std::ifstream file(filename, std::ios::in | std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		file.seekg(0, std::ios::end);
+		std::streamoff size = file.tellg();
+		file.seekg(0, std::ios::beg);
+
+		_buffer.resize(size > 0 ? static_cast<size_t>(size) : 0);
+		if (!_buffer.empty())
+			file.read(&_buffer[0], _buffer.size());
+
+		_data = _buffer.data();
+		_size = _buffer.size();
+	}
+
+	_cursor = 0;
+	_open = true;
+
+	return true;
+}
+
+void sourcefile::close()
+{
+	unmap();
+
+	_buffer.clear();
+	_data = nullptr;
+	_size = 0;
+	_cursor = 0;
+	_open = false;
+}
+
+// Hand out the next line as a view into the file contents. Handles '\n' and "\r\n" endings, and a
+// last line without any ending at all.
+std::optional<std::string_view> sourcefile::nextLine(size_t& cursor) const
+{
+	if (cursor >= _size)
+		return { };
+
+	const char* begin = _data + cursor;
+	size_t remaining = _size - cursor;
+
+	const char* end = static_cast<const char*>(memchr(begin, '\n', remaining));
+	size_t length = end ? static_cast<size_t>(end - begin) : remaining;
+
+	cursor += end ? length + 1 : length;
+
+	if (length > 0 && begin[length - 1] == '\r')
+		length--;
+
+	return std::string_view(begin, length);
+}
+
+#ifdef _WIN32
+
+bool sourcefile::map()
+{
+	HANDLE file = CreateFileA(_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		// empty files can't be mapped; let the fallback path deal with them
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	_fileHandle = file;
+	_mappingHandle = mapping;
+	_data = static_cast<const char*>(view);
+	_size = static_cast<size_t>(size.QuadPart);
+	_mapped = true;
+
+	return true;
+}
+
+void sourcefile::unmap()
+{
+	if (!_mapped)
+		return;
+
+	UnmapViewOfFile(_data);
+	CloseHandle(static_cast<HANDLE>(_mappingHandle));
+	CloseHandle(static_cast<HANDLE>(_fileHandle));
+
+	_fileHandle = nullptr;
+	_mappingHandle = nullptr;
+	_mapped = false;
+}
+
+#else
+
+bool sourcefile::map()
+{
+	int fd = ::open(_name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (view == MAP_FAILED)
+		return false;
+
+	_data = static_cast<const char*>(view);
+	_size = static_cast<size_t>(st.st_size);
+	_mapped = true;
+
+	return true;
+}
+
+void sourcefile::unmap()
+{
+	if (!_mapped)
+		return;
+
+	munmap(const_cast<char*>(_data), _size);
+	_mapped = false;
+}
+
+#endif
\ No newline at end of file
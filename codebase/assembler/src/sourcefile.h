@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <optional>
+
+// A read-only view of a whole source file. The file is memory-mapped when the platform allows it
+// (and read into a single buffer otherwise), and lines are handed out as views into that memory, so
+// walking a file never allocates per line and end-of-file is an ordinary return value instead of a
+// stream exception.
+class sourcefile
+{
+public:
+	sourcefile() = default;
+	~sourcefile() { close(); }
+
+	sourcefile(const sourcefile&) = delete;
+	sourcefile& operator=(const sourcefile&) = delete;
+
+	bool open(const std::string& filename);
+	void close();
+
+	bool isOpen() const { return _open; }
+	const std::string& name() const { return _name; }
+	std::string_view contents() const { return std::string_view(_data, _size); }
+
+	// line cursor
+	void rewind() { _cursor = 0; }
+	bool eof() const { return _cursor >= _size; }
+	std::optional<std::string_view> nextLine() { return nextLine(_cursor); }
+
+	// the same, with a cursor kept by the caller -- lets several readers walk one loaded file
+	std::optional<std::string_view> nextLine(size_t& cursor) const;
+
+private:
+	bool map();
+	void unmap();
+
+private:
+	std::string _name;
+	bool _open = false;
+
+	const char* _data = nullptr;
+	size_t _size = 0;
+	size_t _cursor = 0;
+
+	// fallback storage when the file cannot be mapped
+	std::string _buffer;
+
+	// platform mapping handles
+	void* _fileHandle = nullptr;
+	void* _mappingHandle = nullptr;
+	bool _mapped = false;
+};
\ No newline at end of file
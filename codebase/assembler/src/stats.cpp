@@ -0,0 +1,95 @@
+#include "stats.h"
+
+#include <sstream>
+#include <fstream>
+#include <exception>
+
+void stats::reset()
+{
+	for (std::atomic<uint64_t>& c : _counters)
+		c.store(0, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_phases.clear();
+	_written.clear();
+}
+
+void stats::addTime(const std::string& phase, double seconds)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	phaseTime& p = _phases[phase];
+	p.seconds += seconds;
+	p.calls++;
+}
+
+void stats::addBytesWritten(const std::string& filename, uint64_t bytes)
+{
+	if (!_enabled)
+		return;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_written[filename] += bytes;
+}
+
+std::string stats::toJson() const
+{
+	static const char* counterNames[] = { "lines", "tokens", "symbols", "opcodes", "flag_expansions" };
+	static_assert(sizeof(counterNames) / sizeof(counterNames[0]) == static_cast<size_t>(StatCounter::Count), "every counter needs a name");
+
+	auto quoted = [](const std::string& s)
+	{
+		std::string out = "\"";
+		for (char c : s)
+		{
+			if (c == '"' || c == '\\')
+				out += '\\';
+
+			out += c;
+		}
+
+		return out + "\"";
+	};
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::stringstream s;
+
+	s << "{\n  \"phases\": {";
+	const char* separator = "\n";
+	for (const auto& [name, p] : _phases)
+	{
+		s << separator << "    " << quoted(name) << ": { \"seconds\": " << p.seconds << ", \"calls\": " << p.calls << " }";
+		separator = ",\n";
+	}
+
+	s << "\n  },\n  \"counters\": {";
+	separator = "\n";
+	for (size_t c = 0; c < static_cast<size_t>(StatCounter::Count); c++)
+	{
+		s << separator << "    \"" << counterNames[c] << "\": " << _counters[c].load(std::memory_order_relaxed);
+		separator = ",\n";
+	}
+
+	s << "\n  },\n  \"bytes_written\": {";
+	separator = "\n";
+	for (const auto& [file, bytes] : _written)
+	{
+		s << separator << "    " << quoted(file) << ": " << bytes;
+		separator = ",\n";
+	}
+
+	s << "\n  }\n}\n";
+	return s.str();
+}
+
+void stats::writeJson(const std::string& filename) const
+{
+	std::ofstream file(filename, std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::string msg = "Could not open stats file [" + filename + "] for writing!";
+		throw std::exception(msg.c_str());
+	}
+
+	file << toJson();
+}
\ No newline at end of file
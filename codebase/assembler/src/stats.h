@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// things worth counting while assembling
+enum class StatCounter { Lines, Tokens, Symbols, Opcodes, FlagExpansions, Count };
+
+// Where assembly time goes. Scoped timers add up the time spent in each phase (loading files,
+// tokenizing, every kind of command, building and writing roms, ...), and counters keep track of how
+// much work there was. Everything is off until enabled -- a disabled hook is one test of a bool.
+// The results come out as json, at exit or whenever asked for.
+class stats
+{
+public:
+	// singleton
+	static stats& instance()
+	{
+		static stats _instance;
+		return _instance;
+	}
+
+	bool enabled() const { return _enabled; }
+	void setEnabled(bool e) { _enabled = e; }
+	void reset();
+
+	void count(StatCounter c, uint64_t n = 1)
+	{
+		if (_enabled)
+			_counters[static_cast<size_t>(c)].fetch_add(n, std::memory_order_relaxed);
+	}
+
+	uint64_t counter(StatCounter c) const { return _counters[static_cast<size_t>(c)].load(std::memory_order_relaxed); }
+
+	void addTime(const std::string& phase, double seconds);
+	void addBytesWritten(const std::string& filename, uint64_t bytes);
+
+	std::string toJson() const;
+	void writeJson(const std::string& filename) const;
+
+private:
+	struct phaseTime
+	{
+		double seconds = 0;
+		uint64_t calls = 0;
+	};
+
+	bool _enabled = false;
+	std::atomic<uint64_t> _counters[static_cast<size_t>(StatCounter::Count)] = { };
+
+	mutable std::mutex _mutex;
+	std::map<std::string, phaseTime> _phases;
+	std::map<std::string, uint64_t> _written;
+};
+
+// Adds the time until it goes out of scope to a phase, named "phase" or "phase/detail"
+class scopedTimer
+{
+public:
+	explicit scopedTimer(std::string_view phase, std::string_view detail = { })
+		:
+		_running(stats::instance().enabled())
+	{
+		if (_running)
+		{
+			_phase = phase;
+			_detail = detail;
+			_start = std::chrono::steady_clock::now();
+		}
+	}
+
+	~scopedTimer()
+	{
+		if (!_running)
+			return;
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+		if (_detail.empty())
+			stats::instance().addTime(std::string(_phase), seconds);
+		else
+			stats::instance().addTime(std::string(_phase) + "/" + std::string(_detail), seconds);
+	}
+
+	scopedTimer(const scopedTimer&) = delete;
+	scopedTimer& operator=(const scopedTimer&) = delete;
+
+private:
+	bool _running;
+	std::string_view _phase;
+	std::string_view _detail;
+	std::chrono::steady_clock::time_point _start;
+};
\ No newline at end of file
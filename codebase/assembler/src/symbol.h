@@ -1,6 +1,6 @@
 #pragma once
 
-#include <string>
+#include <string_view>
 
 enum class SymbolType { None, Constant, Variable, Label, Register, Flag, ControlLine };
 
@@ -9,49 +9,54 @@ enum class SymbolType { None, Constant, Variable, Label, Register, Flag, Control
 //  - the symbol type
 //  - an integer value
 //  - the line the symbol was found on
+// The name is a view into the symbol table's interned names (see symboltable.h), so a symbol is
+// small and cheap to copy. A symbol of type None has been referenced but not defined yet.
 class symbol
 {
 public:
-	symbol(symbol&& donor) noexcept
+	symbol() = default;
+
+	symbol(std::string_view n, SymbolType t, int a, int l)
 		:
-		_name(std::move(donor._name)),
-		_type(donor._type),
-		_address(donor._address),
-		_line(donor._line)
+		_name(n),
+		_type(t),
+		_address(a),
+		_line(l)
 	{}
 
 	// These just access and return the private members of the class
-	const std::string& getName() const { return _name; }
+	std::string_view getName() const { return _name; }
 	int getAddress() const { return _address; }
 	SymbolType getType() const { return _type; }
 	int getLine() const { return _line; }
+	bool isDefined() const { return _type != SymbolType::None; }
 
-	static symbol makeConstant(const std::string& n, int a, int l)
+	static symbol makeConstant(std::string_view n, int a, int l)
 	{
 		return symbol(n, SymbolType::Constant, a, l);
 	}
 
-	static symbol makeVariable(const std::string& n, int a, int l)
+	static symbol makeVariable(std::string_view n, int a, int l)
 	{
 		return symbol(n, SymbolType::Variable, a, l);
 	}
 
-	static symbol makeLabel(const std::string& n, int a, int l)
+	static symbol makeLabel(std::string_view n, int a, int l)
 	{
 		return symbol(n, SymbolType::Label, a, l);
 	}
 
-	static symbol makeRegister(const std::string& n, int a, int l)
+	static symbol makeRegister(std::string_view n, int a, int l)
 	{
 		return symbol(n, SymbolType::Register, a, l);
 	}
 
-	static symbol makeFlag(const std::string& n, int a, int l)
+	static symbol makeFlag(std::string_view n, int a, int l)
 	{
 		return symbol(n, SymbolType::Flag, a, l);
 	}
 
-	static symbol makeControlLine(const std::string& n, int a, int l)
+	static symbol makeControlLine(std::string_view n, int a, int l)
 	{
 		return symbol(n, SymbolType::ControlLine, a, l);
 	}
@@ -60,17 +65,8 @@ public:
 	bool operator==(const symbol& other) const { return _type == other._type && _name == other._name; }
 
 private:
-	symbol(const std::string& n, SymbolType t, int a, int l)
-		:
-		_name(n),
-		_type(t),
-		_address(a),
-		_line(l)
-	{}
-
-private:
-	std::string _name;
-	SymbolType _type;
-	int _address;
-	int _line;
+	std::string_view _name;
+	SymbolType _type = SymbolType::None;
+	int _address = 0;
+	int _line = -1;
 };
\ No newline at end of file
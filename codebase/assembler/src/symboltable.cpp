@@ -0,0 +1,102 @@
+#include "symboltable.h"
+#include "snapshot.h"
+
+#include <cstring>
+
+int stringInterner::find(std::string_view n) const
+{
+	if (_slots.empty())
+		return -1;
+
+	return _slots[probe(n, hashContents(n))].id;
+}
+
+int stringInterner::intern(std::string_view n)
+{
+	// keep the table at most half full so probe runs stay short
+	if ((_names.size() + 1) * 2 > _slots.size())
+		grow();
+
+	uint64_t hash = hashContents(n);
+	slot& s = _slots[probe(n, hash)];
+	if (s.id >= 0)
+		return s.id;
+
+	s.hash = hash;
+	s.id = static_cast<int>(_names.size());
+	_names.push_back(store(n));
+
+	return s.id;
+}
+
+// the slot holding n, or the empty slot it would go in
+size_t stringInterner::probe(std::string_view n, uint64_t hash) const
+{
+	size_t mask = _slots.size() - 1;
+	size_t i = static_cast<size_t>(hash) & mask;
+
+	while (_slots[i].id >= 0)
+	{
+		if (_slots[i].hash == hash && _names[_slots[i].id] == n)
+			break;
+
+		i = (i + 1) & mask;
+	}
+
+	return i;
+}
+
+std::string_view stringInterner::store(std::string_view n)
+{
+	if (n.empty())
+		return std::string_view();
+
+	// names longer than a chunk get one of their own
+	if (n.size() > CHUNK_SIZE - _chunkUsed)
+	{
+		_chunks.push_back(std::make_unique<char[]>(n.size() > CHUNK_SIZE ? n.size() : CHUNK_SIZE));
+		_chunkUsed = 0;
+	}
+
+	char* p = _chunks.back().get() + _chunkUsed;
+	std::memcpy(p, n.data(), n.size());
+	_chunkUsed = n.size() > CHUNK_SIZE ? CHUNK_SIZE : _chunkUsed + n.size();
+
+	return std::string_view(p, n.size());
+}
+
+void stringInterner::grow()
+{
+	std::vector<slot> old(_slots.empty() ? 64 : _slots.size() * 2, { 0, -1 });
+	old.swap(_slots);
+
+	for (const slot& s : old)
+		if (s.id >= 0)
+			_slots[probe(_names[s.id], s.hash)] = s;
+}
+
+int symbolTable::intern(std::string_view n)
+{
+	int id = _names.intern(n);
+	if (id == static_cast<int>(_symbols.size()))
+		_symbols.push_back(symbol(_names.get(id), SymbolType::None, 0, -1));
+
+	return id;
+}
+
+bool symbolTable::define(int id, SymbolType t, int a, int l)
+{
+	symbol& s = _symbols[id];
+	if (s.isDefined())
+		return false;
+
+	s = symbol(_names.get(id), t, a, l);
+	return true;
+}
+
+// for values worked out after the symbol was defined, like an equate's
+void symbolTable::setAddress(int id, int a)
+{
+	const symbol& s = _symbols[id];
+	_symbols[id] = symbol(s.getName(), s.getType(), a, s.getLine());
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "symbol.h"
+
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+// Every distinct name is stored once, in chunks that are never reallocated, so the views handed out
+// stay valid for the life of the interner. Each name gets a small integer ID in the order it was first
+// seen, and lookups go through an open-addressing (linear probe) hash of those IDs.
+class stringInterner
+{
+public:
+	// the ID of n, or -1 if it was never interned
+	int find(std::string_view n) const;
+	int intern(std::string_view n);
+
+	std::string_view get(int id) const { return _names[id]; }
+	int size() const { return static_cast<int>(_names.size()); }
+
+private:
+	struct slot
+	{
+		uint64_t hash;
+		int id;
+	};
+
+	size_t probe(std::string_view n, uint64_t hash) const;
+	std::string_view store(std::string_view n);
+	void grow();
+
+private:
+	static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+	std::vector<std::unique_ptr<char[]>> _chunks;
+	size_t _chunkUsed = CHUNK_SIZE;
+	std::vector<std::string_view> _names;
+	std::vector<slot> _slots;
+};
+
+// The cpu's symbols, indexed by interned name ID. A name can be interned before it is defined (a
+// forward reference), in which case its entry has SymbolType::None until define() is called.
+class symbolTable
+{
+public:
+	int find(std::string_view n) const { return _names.find(n); }
+	int intern(std::string_view n);
+
+	// the first definition of a name wins; false when it was already defined
+	bool define(int id, SymbolType t, int a, int l);
+	void setAddress(int id, int a);
+
+	const symbol& get(int id) const { return _symbols[id]; }
+	std::string_view name(int id) const { return _names.get(id); }
+	int size() const { return static_cast<int>(_symbols.size()); }
+
+	// every entry in ID order, including names that were only referenced
+	std::vector<symbol>::const_iterator begin() const { return _symbols.begin(); }
+	std::vector<symbol>::const_iterator end() const { return _symbols.end(); }
+
+private:
+	stringInterner _names;
+	std::vector<symbol> _symbols;
+};
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "units.h"
+#include "assembler.h"
+#include "cpu.h"
+#include "object.h"
+#include "config.h"
+
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+std::vector<unitResult> assembleUnits(const cpu& architecture, const std::string& archFile, const std::vector<std::string>& units,
+	const std::vector<std::string>& includePaths, unsigned char echo, int threads, bool compile,
+	bool cycleListing)
+{
+	std::vector<unitResult> results(units.size());
+	uint64_t archHash = compile ? architecture.architectureHash() : 0;
+
+	auto assembleUnit = [&](size_t i)
+	{
+		unitResult& r = results[i];
+		r.file = units[i];
+
+		auto start = std::chrono::steady_clock::now();
+		std::stringstream output;
+
+		try
+		{
+			cpu c;
+			assembler a(units[i], c);
+			a.setOutput(output);
+			a.setEcho(echo);
+			a.setCycleListing(cycleListing);
+
+			for (const std::string& path : includePaths)
+				a.addIncludePath(path);
+
+			if (compile)
+			{
+				r.object = a.outputBasename() + OBJECT_EXTENSION;
+
+				objectFile existing;
+				r.reused = existing.load(r.object) && existing.archHash == archHash && existing.sourcesUnchanged();
+			}
+
+			if (r.reused)
+			{
+				if (a.echoMajorTasks())
+					output << "\n-- object is up to date: " << r.object << "\n";
+			}
+			else
+			{
+				a.shareArchitecture(architecture, archFile);
+
+				if (compile)
+					a.compile();
+				else
+					a.assemble();
+			}
+
+			r.ok = true;
+		}
+		catch (const std::exception& e)
+		{
+			r.error = e.what();
+		}
+
+		r.output = output.str();
+		r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < units.size(); i = next++)
+			assembleUnit(i);
+	};
+
+	size_t wanted = threads > 0 ? static_cast<size_t>(threads) : std::thread::hardware_concurrency();
+	size_t threadCount = std::max<size_t>(1, std::min<size_t>(wanted, units.size()));
+
+	std::vector<std::thread> pool;
+	for (size_t t = 1; t < threadCount; t++)
+		pool.emplace_back(worker);
+
+	worker();
+
+	for (std::thread& t : pool)
+		t.join();
+
+	return results;
+}
\ No newline at end of file
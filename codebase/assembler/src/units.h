@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+class cpu;
+
+// What happened to one unit -- everything its assembler echoed, and the error that stopped it if any
+class unitResult
+{
+public:
+	std::string file;
+	bool ok = false;
+	std::string output;
+	std::string error;
+	double ms = 0;
+
+	// with compile, the object file, and whether the one already there was still up to date
+	std::string object;
+	bool reused = false;
+};
+
+// Assemble independent units, each into its own rom images, against one architecture that has
+// already been parsed. Every unit gets its own cpu and assembler (and with it its own parser, include
+// cache and output buffer), copies the architecture in, and runs on whichever worker thread picks it
+// up next. The architecture cpu is shared, but only ever read.
+//
+// With compile, each unit goes into an object instead (see object.h). An object already on disk is
+// kept when it was built against the same architecture from files that haven't changed since.
+// Otherwise, cycleListing has each unit write its cycle listing too (see cycles.h).
+//
+// threads <= 0 uses one thread per core. Results come back in the order the units were given.
+std::vector<unitResult> assembleUnits(const cpu& architecture, const std::string& archFile, const std::vector<std::string>& units,
+	const std::vector<std::string>& includePaths, unsigned char echo, int threads, bool compile = false,
+	bool cycleListing = false);
\ No newline at end of file
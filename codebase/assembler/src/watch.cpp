@@ -0,0 +1,341 @@
+#include "watch.h"
+#include "assembler.h"
+#include "linker.h"
+#include "sourcefile.h"
+#include "rom.h"
+#include "util.h"
+
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+
+watcher::watcher(const std::vector<std::string>& units, const std::vector<std::string>& includePaths, unsigned char echo, std::ostream& out)
+	:
+	_includePaths(includePaths),
+	_echo(echo),
+	_out(out)
+{
+	for (const std::string& file : units)
+	{
+		cpu c;
+		assembler a(file, c);
+
+		unit u;
+		u.file = file;
+		u.basename = a.outputBasename();
+		_units.push_back(std::move(u));
+	}
+}
+
+void watcher::build()
+{
+	auto start = std::chrono::steady_clock::now();
+	size_t written = 0;
+
+	if (loadArchitecture())
+	{
+		for (unit& u : _units)
+			assembleUnit(u);
+
+		written += writeDecoderRoms();
+		written += writeProgramRoms();
+	}
+
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+	_out << "\n-- built " << dec << _units.size() << " unit(s) in " << elapsed.count() << " ms, " << written << " rom byte(s) written\n";
+}
+
+bool watcher::poll()
+{
+	std::set<std::string> changed = changedFiles();
+	if (changed.empty())
+		return false;
+
+	auto start = std::chrono::steady_clock::now();
+	size_t rebuilt = 0;
+	size_t written = 0;
+
+	for (const std::string& file : changed)
+		_out << "\n-- changed: " << file << "\n";
+
+	bool archChanged = !_architecture || std::any_of(changed.begin(), changed.end(), [&](const std::string& f) { return _archFiles.count(f) > 0; });
+
+	if (archChanged)
+	{
+		if (loadArchitecture())
+		{
+			for (unit& u : _units)
+				assembleUnit(u);
+
+			rebuilt = _units.size();
+			written += writeDecoderRoms();
+			written += writeProgramRoms();
+		}
+	}
+	else
+	{
+		// a unit that failed last time gets another go whatever changed
+		for (unit& u : _units)
+		{
+			if (u.ok && std::none_of(changed.begin(), changed.end(), [&](const std::string& f) { return u.files.count(f) > 0; }))
+				continue;
+
+			assembleUnit(u);
+			rebuilt++;
+		}
+
+		written += writeProgramRoms();
+	}
+
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+	_out << "-- rebuilt " << dec << rebuilt << " unit(s) in " << elapsed.count() << " ms, " << written << " rom byte(s) written\n";
+
+	return true;
+}
+
+// Parse the architecture (or load its snapshot) into a cpu of its own, and watch every file it came from
+bool watcher::loadArchitecture()
+{
+	_architecture.reset();
+
+	if (_archFile.empty())
+	{
+		// whatever goes wrong in the unit, the architecture include comes first
+		cpu probe;
+		assembler a(_units.front().file, probe);
+		std::stringstream ignored;
+		a.setOutput(ignored);
+		a.setEcho(0);
+
+		for (const std::string& path : _includePaths)
+			a.addIncludePath(path);
+
+		try
+		{
+			a.assembly_pass0();
+		}
+		catch (const std::exception&)
+		{
+		}
+
+		_archFile = a.architectureFile();
+		if (_archFile.empty())
+		{
+			_out << "Fatal error: [" << _units.front().file << "] doesn't include an architecture!\n";
+			watch(_units.front().file);
+			return false;
+		}
+	}
+
+	auto arch = std::make_unique<cpu>();
+	assembler a(_archFile, *arch);
+	std::stringstream output;
+	a.setOutput(output);
+	a.setEcho(_echo);
+
+	for (const std::string& path : _includePaths)
+		a.addIncludePath(path);
+
+	bool ok = true;
+	try
+	{
+		_archPath = a.loadArchitecture(_archFile);
+	}
+	catch (const std::exception& e)
+	{
+		output << "Fatal error in [" << _archFile << "]: " << e.what() << "\n";
+		ok = false;
+	}
+
+	std::string s = output.str();
+	_out.write(s.data(), s.size());
+
+	_archFiles = a.dependencies();
+	_archFiles.insert(a.architectureSources().begin(), a.architectureSources().end());
+
+	if (!_archPath.empty())
+		_archFiles.insert(_archPath);
+
+	for (const std::string& file : _archFiles)
+		watch(file);
+
+	if (ok)
+		_architecture = std::move(arch);
+
+	return ok;
+}
+
+void watcher::assembleUnit(unit& u)
+{
+	cpu c;
+	assembler a(u.file, c);
+	std::stringstream output;
+	a.setOutput(output);
+	a.setEcho(_echo);
+
+	for (const std::string& path : _includePaths)
+		a.addIncludePath(path);
+
+	bool failed = !u.ok;
+	u.ok = false;
+
+	try
+	{
+		a.shareArchitecture(*_architecture, _archPath);
+
+		if (_linkName.empty())
+		{
+			a.assembly_pass0();
+			c.resolveFixups();
+
+			u.program.clear();
+			for (int i = 0; i < c.numProgramSegments(); i++)
+				u.program.push_back(c.getProgramSegment(i));
+		}
+		else
+		{
+			u.object = a.buildObject();
+		}
+
+		u.ok = true;
+	}
+	catch (const std::exception& e)
+	{
+		output << "Fatal error in [" << u.file << "]: " << e.what() << "\n";
+	}
+
+	// a unit that fails still depends on everything it got to, and on what it used before
+	std::set<std::string> files = a.dependencies();
+	files.insert(u.file);
+
+	if (failed || !u.ok)
+		files.insert(u.files.begin(), u.files.end());
+
+	u.files = std::move(files);
+	for (const std::string& file : u.files)
+		watch(file);
+
+	std::string s = output.str();
+	_out.write(s.data(), s.size());
+}
+
+size_t watcher::writeDecoderRoms()
+{
+	if (!_architecture->writesDecoderRom())
+		return 0;
+
+	decoderRomLayout layout = _architecture->getDecoderRomLayout();
+	std::vector<uint32_t> image = _architecture->buildDecoderRom(layout);
+
+	std::vector<std::string> basenames;
+	if (_linkName.empty())
+	{
+		for (const unit& u : _units)
+			basenames.push_back(u.basename);
+	}
+	else
+	{
+		basenames.push_back(_linkName);
+	}
+
+	size_t written = 0;
+	for (int r = 0; r < layout.romCount; r++)
+	{
+		std::vector<uint8_t> slice = sliceRomImage(image, r * layout.romBits, layout.romBits);
+
+		for (const std::string& basename : basenames)
+			written += patchRomImage(basename + ".decoder" + std::to_string(r) + ".bin", slice);
+	}
+
+	return written;
+}
+
+size_t watcher::writeProgramRoms()
+{
+	size_t written = 0;
+
+	auto patchSegments = [&](const std::string& basename, int count, auto segment)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			const std::vector<uint8_t>& data = segment(i);
+			if (!data.empty())
+				written += patchRomImage(basename + ".program" + std::to_string(i) + ".bin", data);
+		}
+	};
+
+	if (_linkName.empty())
+	{
+		for (const unit& u : _units)
+		{
+			if (u.ok)
+				patchSegments(u.basename, static_cast<int>(u.program.size()), [&](int i) -> const std::vector<uint8_t>& { return u.program[i]; });
+		}
+
+		return written;
+	}
+
+	// keep the last good program until every unit assembles again
+	if (std::any_of(_units.begin(), _units.end(), [](const unit& u) { return !u.ok; }))
+		return 0;
+
+	linker l;
+	l.setBase(_base);
+
+	for (const unit& u : _units)
+		l.add(u.file, u.object);
+
+	try
+	{
+		l.link();
+	}
+	catch (const std::exception& e)
+	{
+		_out << "Fatal error: " << e.what() << "\n";
+		return 0;
+	}
+
+	patchSegments(_linkName, l.numSegments(), [&](int i) -> const std::vector<uint8_t>& { return l.getSegment(i); });
+	return written;
+}
+
+void watcher::watch(const std::string& file)
+{
+	if (_files.count(file) > 0)
+		return;
+
+	std::error_code ec;
+	fileState state;
+	state.time = std::filesystem::last_write_time(file, ec);
+
+	sourcefile source;
+	state.hash = source.open(file) ? hashContents(source.contents()) : 0;
+
+	_files.emplace(file, state);
+}
+
+// Only files whose time moved get hashed, and only a different hash counts as a change
+std::set<std::string> watcher::changedFiles()
+{
+	std::set<std::string> changed;
+
+	for (auto& entry : _files)
+	{
+		std::error_code ec;
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(entry.first, ec);
+		if (ec || time == entry.second.time)
+			continue;
+
+		entry.second.time = time;
+
+		sourcefile source;
+		uint64_t hash = source.open(entry.first) ? hashContents(source.contents()) : 0;
+		if (hash != entry.second.hash)
+		{
+			entry.second.hash = hash;
+			changed.insert(entry.first);
+		}
+	}
+
+	return changed;
+}
\ No newline at end of file
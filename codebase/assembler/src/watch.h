@@ -0,0 +1,80 @@
+#pragma once
+
+#include "cpu.h"
+#include "object.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <ostream>
+#include <filesystem>
+#include <cstdint>
+
+// Watch mode. The architecture is parsed once and kept in memory, and every unit remembers the files
+// its include graph reached. A poll looks at the modification time of every one of those files and
+// hashes the ones that moved. A real change re-assembles only the units that depend on the file,
+// against the architecture in memory, while the rest keep their program bytes (or objects, when
+// linking) from last time. Roms on disk are patched rather than rewritten, and the decoder rom is
+// only built again when the architecture itself changed.
+class watcher
+{
+public:
+	watcher(const std::vector<std::string>& units, const std::vector<std::string>& includePaths, unsigned char echo, std::ostream& out);
+
+	// the architecture the units share -- found through the first unit when not given
+	void setArchitecture(const std::string& archFile) { _archFile = archFile; }
+
+	// link the units into name.programN.bin (and name.decoderN.bin) instead of giving each its own roms
+	void setLink(const std::string& name, int base) { _linkName = name; _base = base; }
+
+	// Build everything once. Errors are reported rather than thrown, so watching can go on.
+	void build();
+
+	// Rebuild whatever depends on a file that changed since the last poll. Returns false when nothing did.
+	bool poll();
+
+private:
+	struct unit
+	{
+		std::string file;
+		std::string basename;
+		std::set<std::string> files;
+		bool ok = false;
+
+		// the unit's own program rom segments, or its object when linking
+		std::vector<std::vector<uint8_t>> program;
+		objectFile object;
+	};
+
+	struct fileState
+	{
+		std::filesystem::file_time_type time;
+		uint64_t hash;
+	};
+
+	bool loadArchitecture();
+	void assembleUnit(unit& u);
+	size_t writeDecoderRoms();
+	size_t writeProgramRoms();
+
+	void watch(const std::string& file);
+	std::set<std::string> changedFiles();
+
+private:
+	std::vector<unit> _units;
+	std::vector<std::string> _includePaths;
+	unsigned char _echo;
+	std::ostream& _out;
+
+	std::string _archFile;
+	std::string _archPath;
+	std::unique_ptr<cpu> _architecture;
+	std::set<std::string> _archFiles;
+
+	std::string _linkName;
+	int _base = -1;
+
+	std::map<std::string, fileState> _files;
+};
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "bench.h"
+
+#include <sstream>
+
+volatile uint64_t benchSink = 0;
+
+namespace
+{
+	std::string jsonString(const std::string& s)
+	{
+		std::string out = "\"";
+		for (char c : s)
+		{
+			if (c == '"' || c == '\\')
+				out += '\\';
+
+			out += c;
+		}
+
+		return out + "\"";
+	}
+}
+
+std::string benchResultsToJson(const std::vector<benchResult>& results)
+{
+	std::stringstream s;
+	s << "{\n  \"benchmarks\": [";
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const benchResult& r = results[i];
+
+		s << (i == 0 ? "\n" : ",\n") << "    { \"group\": " << jsonString(r.group) << ", \"name\": " << jsonString(r.name)
+			<< ", \"scale\": " << r.scale << ", \"operations\": " << r.operations << ", \"seconds\": " << r.seconds
+			<< ", \"ns_per_op\": " << r.nsPerOperation();
+
+		if (r.items > 0)
+		{
+			s << ", \"items_per_op\": " << r.items << ", \"item\": " << jsonString(r.itemName)
+				<< ", \"ns_per_item\": " << r.nsPerOperation() / r.items;
+		}
+
+		s << " }";
+	}
+
+	s << "\n  ]\n}\n";
+	return s.str();
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+// One measurement. Every benchmark does some number of operations -- a call, a line, a whole
+// assembly -- and reports the time per operation.
+class benchResult
+{
+public:
+	std::string group;
+	std::string name;
+
+	// the size of the input, for benchmarks run at several sizes (0 otherwise)
+	int scale = 0;
+
+	uint64_t operations = 0;
+	double seconds = 0;
+
+	// what one operation works through (lines of source, bytes, ...), when that means anything
+	uint64_t items = 0;
+	std::string itemName;
+
+	double nsPerOperation() const { return operations > 0 ? seconds * 1.0e9 / operations : 0; }
+};
+
+class stopwatch
+{
+public:
+	stopwatch() : _start(std::chrono::steady_clock::now()) { }
+
+	double seconds() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count(); }
+
+private:
+	std::chrono::steady_clock::time_point _start;
+};
+
+// Keeps results the compiler could otherwise throw away
+extern volatile uint64_t benchSink;
+
+// Call run(n) with n doubling until one call takes at least minSeconds, then keep the fastest of a
+// few calls at that size. run does n operations and returns how long the part worth timing took, so
+// it can set up (and clean up) around it.
+template <class F>
+benchResult measure(const std::string& group, const std::string& name, F run, double minSeconds)
+{
+	benchResult r;
+	r.group = group;
+	r.name = name;
+
+	uint64_t n = 1;
+	double t = run(n);
+
+	while (t < minSeconds && n < (uint64_t(1) << 40))
+	{
+		n *= t > 0 ? std::min<uint64_t>(16, std::max<uint64_t>(2, static_cast<uint64_t>(minSeconds / t))) : 16;
+		t = run(n);
+	}
+
+	for (int i = 0; i < 2; i++)
+		t = std::min(t, run(n));
+
+	r.operations = n;
+	r.seconds = t;
+
+	return r;
+}
+
+// {"benchmarks": [{"group": ..., "name": ..., "scale": ..., "ns_per_op": ..., ...}, ...]}
+std::string benchResultsToJson(const std::vector<benchResult>& results);
\ No newline at end of file
@@ -0,0 +1,419 @@
+#include "bench.h"
+#include "synthetic.h"
+#include "../../assembler/src/assembler.h"
+#include "../../assembler/src/archtag.h"
+#include "../../assembler/src/config.h"
+#include "../../assembler/src/cpu.h"
+#include "../../assembler/src/parser.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	class benchSuite
+	{
+	public:
+		std::string filter;
+		double minSeconds = 0.2;
+		std::vector<benchResult> results;
+
+		bool wants(const std::string& group, const std::string& name) const
+		{
+			return filter.empty() || (group + "/" + name).find(filter) != std::string::npos;
+		}
+
+		template <class F>
+		benchResult* run(const std::string& group, const std::string& name, int scale, F f)
+		{
+			if (!wants(group, name))
+				return nullptr;
+
+			results.push_back(measure(group, name, f, minSeconds));
+			results.back().scale = scale;
+
+			const benchResult& r = results.back();
+			std::cout << "   " << std::left << std::setw(12) << group << std::setw(28) << name << std::right << std::setw(6) << scale
+				<< std::setw(16) << std::fixed << std::setprecision(1) << r.nsPerOperation() << " ns/op\n" << std::flush;
+
+			return &results.back();
+		}
+	};
+
+	// Some of what the assembler prints doesn't go through the echo settings, and printing isn't what
+	// is being measured
+	class quietOutput
+	{
+	public:
+		quietOutput() : _saved(std::cout.rdbuf(&_null)) { }
+		~quietOutput() { std::cout.rdbuf(_saved); }
+
+	private:
+		class nullBuffer : public std::streambuf
+		{
+		protected:
+			int overflow(int c) override { return c; }
+			std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+		};
+
+		nullBuffer _null;
+		std::streambuf* _saved;
+	};
+
+	// every line of the source that isn't blank or only a comment
+	std::vector<std::string> sourceLines(const std::string& text)
+	{
+		std::vector<std::string> lines;
+		std::stringstream in(text);
+
+		for (std::string line; std::getline(in, line);)
+		{
+			size_t first = line.find_first_not_of(" \t\r");
+			if (first != std::string::npos && line[first] != COMMENT_KEY)
+				lines.push_back(line);
+		}
+
+		return lines;
+	}
+
+	size_t countLines(const std::string& text)
+	{
+		return static_cast<size_t>(std::count(text.begin(), text.end(), '\n')) + 1;
+	}
+
+	// The parser primitives change the strings they're given, so every call works on a fresh copy.
+	// The copies are short enough to stay in the small-string buffer for most tokens.
+	void parserBenchmarks(benchSuite& suite, const std::vector<std::string>& lines)
+	{
+		parser p;
+
+		suite.run("parser", "extract_token_ws_comma", 0, [&](uint64_t n)
+			{
+				stopwatch w;
+				std::string s;
+				size_t next = 0;
+				uint64_t sum = 0;
+
+				for (uint64_t i = 0; i < n; i++)
+				{
+					if (s.empty())
+						s = lines[next++ % lines.size()];
+
+					auto t = p.extract_token_ws_comma(s);
+					sum += t.has_value() ? t->size() : 0;
+				}
+
+				benchSink = benchSink + sum;
+				return w.seconds();
+			});
+
+		const std::vector<std::string> numbers = { "$ff", "%1010", "123", "$1234", "7", "%11110000" };
+		const std::vector<std::string> tokens = { "$ff", "%1010", "123", "a_read_data", "$1234", "#", "_tcuEndSeq", "7" };
+
+		suite.run("parser", "get_num_type", 0, [&](uint64_t n)
+			{
+				stopwatch w;
+				uint64_t sum = 0;
+
+				for (uint64_t i = 0; i < n; i++)
+				{
+					std::string s = tokens[i % tokens.size()];
+					sum += static_cast<uint64_t>(p.get_num_type(s));
+				}
+
+				benchSink = benchSink + sum;
+				return w.seconds();
+			});
+
+		suite.run("parser", "parse_literal_num", 0, [&](uint64_t n)
+			{
+				stopwatch w;
+				uint64_t sum = 0;
+
+				for (uint64_t i = 0; i < n; i++)
+				{
+					std::string s = numbers[i % numbers.size()];
+					sum += p.parse_literal_num(s);
+				}
+
+				benchSink = benchSink + sum;
+				return w.seconds();
+			});
+
+		suite.run("parser", "strip_comment", 0, [&](uint64_t n)
+			{
+				stopwatch w;
+				uint64_t sum = 0;
+
+				for (uint64_t i = 0; i < n; i++)
+				{
+					std::string s = lines[i % lines.size()];
+					p.strip_comment(s);
+					sum += s.size();
+				}
+
+				benchSink = benchSink + sum;
+				return w.seconds();
+			});
+	}
+
+	// The architecture commands run against a cpu that knows everything up to the first opcode --
+	// the registers, flags and control lines the generated lines refer to.
+	void archBenchmarks(benchSuite& suite, const fs::path& prefixFile)
+	{
+		auto timeCommand = [&](const command& cmd, uint64_t n, auto makeLine, auto before)
+		{
+			quietOutput quiet;
+
+			cpu c;
+			assembler a(prefixFile.string(), c);
+			a.setEcho(0);
+			a.assembly_pass0();
+			before(a, c);
+
+			std::vector<std::pair<std::string, std::string>> lines;
+			lines.reserve(n);
+			for (uint64_t i = 0; i < n; i++)
+				lines.push_back(makeLine(i));
+
+			stopwatch w;
+			for (uint64_t i = 0; i < n; i++)
+				cmd.process(a, c, lines[i].first, lines[i].second, static_cast<int>(i));
+
+			return w.seconds();
+		};
+
+		auto nothing = [](assembler&, cpu&) { };
+
+		// half are new fields, half are shorthands made of other lines
+		suite.run("archtag", "archControlLine", 0, [&](uint64_t n)
+			{
+				archControlLine cmd;
+				return timeCommand(cmd, n, [](uint64_t i)
+					{
+						std::string name = "bench_line_" + std::to_string(i);
+						if (i % 2 == 0)
+							return std::make_pair(std::string(CONTROL_STR), name + "\t\t" + std::to_string(i % 8) + " << 29");
+
+						return std::make_pair(std::string(CONTROL_STR), name + " = _mem_write_data | _pc_write_addr | ir_read_data | pc_inc");
+					}, nothing);
+			});
+
+		suite.run("archtag", "archOpcode", 0, [&](uint64_t n)
+			{
+				archOpcode cmd;
+				return timeCommand(cmd, n, [](uint64_t i)
+					{
+						static const char* operands[] = { " a, #", " a, b", " [dx], c", " b, [#]" };
+						return std::make_pair(std::string(OPCODE_STR), "$" + std::to_string(i) + " bench_op_" + std::to_string(i) + operands[i % 4]);
+					}, nothing);
+			});
+
+		// a plain cycle, then a seq_if / seq_else pair, over and over on one opcode
+		suite.run("archtag", "archOpcodeSeq", 0, [&](uint64_t n)
+			{
+				archOpcodeSeq cmd;
+				return timeCommand(cmd, n, [](uint64_t i)
+					{
+						switch (i % 3)
+						{
+						case 0: return std::make_pair(std::string(OPCODE_SEQ_STR), std::string("_mem_write_data | a_read_data | _pc_write_addr | pc_inc"));
+						case 1: return std::make_pair(std::string(OPCODE_SEQ_IF_STR), std::string("xxxx1 : _a_write_lhs | _b_write_rhs | alu_add_inc_lhs_rhs | _alu_write_data | a_read_data"));
+						default: return std::make_pair(std::string(OPCODE_SEQ_ELSE_STR), std::string("_a_write_lhs | _b_write_rhs | alu_add_lhs_rhs | _alu_write_data | a_read_data"));
+						}
+					},
+					[](assembler& a, cpu& c)
+					{
+						archOpcode().process(a, c, OPCODE_STR, "$00 bench_op", 0);
+					});
+			});
+	}
+
+	double assembleFile(const fs::path& file, bool snapshots)
+	{
+		cpu c;
+		assembler a(file.string(), c);
+		a.setEcho(0);
+		a.setArchSnapshots(snapshots);
+
+		quietOutput quiet;
+		stopwatch w;
+		a.assemble();
+		return w.seconds();
+	}
+
+	void assembleBenchmarks(benchSuite& suite, const std::string& arch, const fs::path& dir, const std::vector<int>& scales, const std::vector<int>& depths)
+	{
+		for (int scale : scales)
+		{
+			fs::path scaleDir = dir / ("scale" + std::to_string(scale));
+			fs::create_directories(scaleDir);
+
+			std::string archFile = "arch" + std::to_string(scale) + ".arch";
+			std::string scaled = scaleArchitecture(arch, scale);
+			writeTextFile(scaleDir / archFile, scaled);
+
+			// the architecture on its own...
+			fs::path archOnly = scaleDir / "arch.s";
+			writeTextFile(archOnly, ".include \"" + archFile + "\"\n");
+
+			// ...and with a program that grows with it
+			std::string program = syntheticProgram(8 * scale);
+			fs::path programFile = scaleDir / "program.s";
+			writeTextFile(programFile, ".include \"" + archFile + "\"\n" + program);
+
+			size_t archLines = countLines(scaled);
+			size_t programLines = countLines(program);
+
+			auto assembleRuns = [](const fs::path& file, bool snapshots)
+			{
+				return [file, snapshots](uint64_t n)
+				{
+					double t = 0;
+					for (uint64_t i = 0; i < n; i++)
+						t += assembleFile(file, snapshots);
+
+					return t;
+				};
+			};
+
+			if (benchResult* r = suite.run("assemble", "arch", scale, assembleRuns(archOnly, false)))
+			{
+				r->items = archLines;
+				r->itemName = "line";
+			}
+
+			if (benchResult* r = suite.run("assemble", "program", scale, assembleRuns(programFile, false)))
+			{
+				r->items = archLines + programLines;
+				r->itemName = "line";
+			}
+
+			// the same, with the architecture loaded from its snapshot after the first run
+			if (suite.wants("assemble", "program_snapshot"))
+				assembleFile(programFile, true);
+
+			if (benchResult* r = suite.run("assemble", "program_snapshot", scale, assembleRuns(programFile, true)))
+			{
+				r->items = programLines;
+				r->itemName = "line";
+			}
+		}
+
+		for (int depth : depths)
+		{
+			fs::path chainDir = dir / ("chain" + std::to_string(depth));
+			fs::create_directories(chainDir);
+			writeTextFile(chainDir / "homebrew.arch", arch);
+
+			fs::path top = writeIncludeChain(chainDir, "homebrew.arch", depth);
+
+			if (suite.wants("assemble", "include_chain"))
+				assembleFile(top, true);
+
+			if (benchResult* r = suite.run("assemble", "include_chain", depth, [&](uint64_t n)
+				{
+					double t = 0;
+					for (uint64_t i = 0; i < n; i++)
+						t += assembleFile(top, true);
+
+					return t;
+				}))
+			{
+				r->items = depth;
+				r->itemName = "file";
+			}
+		}
+	}
+
+	std::vector<int> parseList(const std::string& s)
+	{
+		std::vector<int> values;
+		std::stringstream in(s);
+
+		for (std::string item; std::getline(in, item, ',');)
+			values.push_back(std::stoi(item));
+
+		return values;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	// On the command-line, we expect ./bench [options]. Inputs are generated from a real architecture
+	// file into a scratch directory, every benchmark prints ns per operation as it finishes, and the
+	// results can be written as json for tracking.
+	//  -arch file        architecture to build the inputs from (default ../assembler/code/homebrew.arch)
+	//  -dir path         scratch directory (default <temp>/homebrew_bench)
+	//  -json file        write the results to file as json
+	//  -filter text      only run benchmarks whose group/name contains text
+	//  -time s           minimum time per measurement (default 0.2)
+	//  -scales 1,10,100  architecture sizes, in copies of its opcodes
+	//  -depths 10,100    include chain depths
+	try
+	{
+		benchSuite suite;
+		fs::path archPath = "../assembler/code/homebrew.arch";
+		fs::path dir = fs::temp_directory_path() / "homebrew_bench";
+		std::string jsonFile;
+		std::vector<int> scales = { 1, 10, 100 };
+		std::vector<int> depths = { 10, 100, 1000 };
+
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "-arch" && hasValue)
+				archPath = argv[++i];
+			else if (arg == "-dir" && hasValue)
+				dir = argv[++i];
+			else if (arg == "-json" && hasValue)
+				jsonFile = argv[++i];
+			else if (arg == "-filter" && hasValue)
+				suite.filter = argv[++i];
+			else if (arg == "-time" && hasValue)
+				suite.minSeconds = std::stod(argv[++i]);
+			else if (arg == "-scales" && hasValue)
+				scales = parseList(argv[++i]);
+			else if (arg == "-depths" && hasValue)
+				depths = parseList(argv[++i]);
+			else
+				std::cout << "Ignoring unknown argument [" << arg << "]" << std::endl;
+		}
+
+		std::string arch = readTextFile(archPath);
+		fs::create_directories(dir);
+
+		// everything before the first opcode, for the architecture command benchmarks
+		size_t opcodes = arch.find("\nopcode");
+		fs::path prefixFile = dir / "prefix.s";
+		writeTextFile(prefixFile, arch.substr(0, opcodes));
+
+		std::cout << "-- benchmarking with " << archPath.string() << " in " << dir.string() << "\n";
+
+		parserBenchmarks(suite, sourceLines(arch));
+		archBenchmarks(suite, prefixFile);
+		assembleBenchmarks(suite, arch, dir, scales, depths);
+
+		if (!jsonFile.empty())
+		{
+			writeTextFile(jsonFile, benchResultsToJson(suite.results));
+			std::cout << "          *** Wrote " << suite.results.size() << " results to " << jsonFile << "\n";
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Fatal error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "synthetic.h"
+
+#include <sstream>
+#include <fstream>
+#include <exception>
+#include <cctype>
+#include <cstdio>
+
+std::string scaleArchitecture(const std::string& arch, int scale)
+{
+	if (scale <= 1)
+		return arch;
+
+	std::stringstream in(arch);
+	std::stringstream header;
+	std::stringstream opcodes;
+	bool inOpcodes = false;
+
+	for (std::string line; std::getline(in, line);)
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		std::string_view word(line);
+		word = word.substr(0, word.find_first_of(" \t"));
+
+		if (word == "instruction_width")
+			line = "instruction_width 2";
+		else if (word == "decoder_rom")
+			line = "decoder_rom 0 32 16";
+
+		if (word == "opcode")
+			inOpcodes = true;
+
+		(inOpcodes ? opcodes : header) << line << "\n";
+	}
+
+	std::stringstream out;
+	out << header.str() << opcodes.str();
+
+	// the copies -- "opcode $xx name ..." becomes "opcode $kkxx name_k ..."
+	for (int k = 1; k < scale; k++)
+	{
+		std::stringstream copy(opcodes.str());
+
+		for (std::string line; std::getline(copy, line);)
+		{
+			if (line.rfind("opcode ", 0) == 0 || line.rfind("opcode\t", 0) == 0)
+			{
+				size_t dollar = line.find('$');
+				size_t valueEnd = line.find_first_of(" \t", dollar);
+				size_t nameStart = line.find_first_not_of(" \t", valueEnd);
+				size_t nameEnd = line.find_first_of(" \t,", nameStart);
+
+				if (dollar != std::string::npos && nameStart != std::string::npos)
+				{
+					int value = std::stoi(line.substr(dollar + 1, valueEnd - dollar - 1), nullptr, 16) + k * 256;
+
+					char hex[8];
+					std::snprintf(hex, sizeof(hex), "%04x", value);
+
+					std::string name = line.substr(nameStart, nameEnd == std::string::npos ? std::string::npos : nameEnd - nameStart);
+					std::string rest = nameEnd == std::string::npos ? "" : line.substr(nameEnd);
+
+					line = "opcode $" + std::string(hex) + " " + name + "_" + std::to_string(k) + rest;
+				}
+			}
+
+			out << line << "\n";
+		}
+	}
+
+	return out.str();
+}
+
+std::string syntheticProgram(int blocks)
+{
+	std::stringstream s;
+
+	for (int k = 0; k < blocks; k++)
+	{
+		s << "block_" << k << ":\n"
+			<< "\tmov b, 0\n"
+			<< "\tmov c, 10\n"
+			<< "loop_" << k << ":\n"
+			<< "\tclc\n"
+			<< "\tadd b, c\n"
+			<< "\tclc\n"
+			<< "\tdec c\n"
+			<< "\tjnz loop_" << k << "\n"
+			<< "\tmov dh, $80\n"
+			<< "\tmov dl, " << k % 256 << "\n"
+			<< "\tmov [dx], b\n"
+			<< "\tmov a, [dx]\n"
+			<< "\tjmp next_" << k << "\n"
+			<< "next_" << k << ":\n";
+	}
+
+	s << "done:\n\tjmp done\n";
+
+	return s.str();
+}
+
+std::filesystem::path writeIncludeChain(const std::filesystem::path& dir, const std::string& archFile, int depth)
+{
+	std::filesystem::create_directories(dir);
+
+	for (int i = 0; i < depth; i++)
+	{
+		std::stringstream s;
+
+		if (i + 1 < depth)
+			s << ".include \"chain_" << i + 1 << ".s\"\n";
+
+		s << "chain_" << i << ":\n\tmov a, " << i % 256 << "\n\tadd a, b\n";
+		writeTextFile(dir / ("chain_" + std::to_string(i) + ".s"), s.str());
+	}
+
+	std::filesystem::path top = dir / "chain.s";
+	writeTextFile(top, ".include \"" + archFile + "\"\n.include \"chain_0.s\"\ndone:\n\tjmp done\n");
+
+	return top;
+}
+
+std::string readTextFile(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		std::string msg = "Could not open file [" + path.string() + "]!";
+		throw std::exception(msg.c_str());
+	}
+
+	std::stringstream s;
+	s << file.rdbuf();
+	return s.str();
+}
+
+void writeTextFile(const std::filesystem::path& path, const std::string& text)
+{
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::string msg = "Could not open file [" + path.string() + "] for writing!";
+		throw std::exception(msg.c_str());
+	}
+
+	file.write(text.data(), text.size());
+}
\ No newline at end of file
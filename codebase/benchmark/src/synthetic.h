@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <filesystem>
+
+// Inputs for the benchmarks, built from a real architecture file so they exercise the same paths.
+
+// The architecture with its opcodes repeated scale times -- each copy at the next 256 opcode values
+// with its mnemonics suffixed, so every copy is a distinct set of instructions. Past 1x, the
+// instruction width becomes two bytes and the decoder rom is no longer written (a 100x image would
+// be gigabytes).
+std::string scaleArchitecture(const std::string& arch, int scale);
+
+// A program for the homebrew instruction set made of the given number of small loops, each with its
+// own labels and a forward jump
+std::string syntheticProgram(int blocks);
+
+// A program whose code is spread over a chain of depth files, each including the next
+std::filesystem::path writeIncludeChain(const std::filesystem::path& dir, const std::string& archFile, int depth);
+
+std::string readTextFile(const std::filesystem::path& path);
+void writeTextFile(const std::filesystem::path& path, const std::string& text);
\ No newline at end of file
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// The ALU operations, named the way the alu_* control lines name them (without the alu_ prefix and
+// the operand suffix). The firmware picks the carry-in variants itself (add vs add_inc, shl_0 vs
+// shl_1, ...) with seq_if on the carry flag, so the ALU never reads the carry.
+enum class AluOp
+{
+	Pass_Lhs, Pass_Rhs, Inc, Inc_Inc, Dec, Dec_Dec, Shl_0, Shl_1, Shr_0, Shr_1,
+	Mshl_0, Mshl_1, Mshr_0, Mshr_1, Not, And, Or, Xor, Add, Add_Inc, Sub, Sub_Dec,
+	Mul_Lo, Mul_Hi, Div, Mod, Clc, Sec, Cid, Sid,
+	Invalid
+};
+
+// Flag outputs by meaning -- the simulator maps them onto whatever flag bits the architecture defines
+constexpr uint8_t ALU_CARRY = 0x01;
+constexpr uint8_t ALU_OVERFLOW = 0x02;
+constexpr uint8_t ALU_ZERO = 0x04;
+constexpr uint8_t ALU_SIGN = 0x08;
+constexpr uint8_t ALU_DECIMAL = 0x10;
+
+class aluResult
+{
+public:
+	uint8_t value = 0;
+
+	// flags the operation sets, and their new values
+	uint8_t affected = 0;
+	uint8_t flags = 0;
+};
+
+constexpr AluOp aluOpFromName(std::string_view s)
+{
+	// drop the operand suffix -- alu_add_lhs_rhs and alu_inc_lhs become add and inc
+	for (std::string_view suffix : { std::string_view("_lhs_rhs"), std::string_view("_lhs"), std::string_view("_rhs") })
+	{
+		if (s.size() > suffix.size() && s.substr(s.size() - suffix.size()) == suffix)
+		{
+			if (s == "pass_lhs") return AluOp::Pass_Lhs;
+			if (s == "pass_rhs") return AluOp::Pass_Rhs;
+
+			s.remove_suffix(suffix.size());
+			break;
+		}
+	}
+
+	if (s == "inc") return AluOp::Inc;
+	if (s == "inc_inc") return AluOp::Inc_Inc;
+	if (s == "dec") return AluOp::Dec;
+	if (s == "dec_dec") return AluOp::Dec_Dec;
+	if (s == "shl_0") return AluOp::Shl_0;
+	if (s == "shl_1") return AluOp::Shl_1;
+	if (s == "shr_0") return AluOp::Shr_0;
+	if (s == "shr_1") return AluOp::Shr_1;
+	if (s == "mshl_0") return AluOp::Mshl_0;
+	if (s == "mshl_1") return AluOp::Mshl_1;
+	if (s == "mshr_0") return AluOp::Mshr_0;
+	if (s == "mshr_1") return AluOp::Mshr_1;
+	if (s == "not") return AluOp::Not;
+	if (s == "and") return AluOp::And;
+	if (s == "or") return AluOp::Or;
+	if (s == "xor") return AluOp::Xor;
+	if (s == "add") return AluOp::Add;
+	if (s == "add_inc") return AluOp::Add_Inc;
+	if (s == "sub") return AluOp::Sub;
+	if (s == "sub_dec") return AluOp::Sub_Dec;
+	if (s == "mul_lo") return AluOp::Mul_Lo;
+	if (s == "mul_hi") return AluOp::Mul_Hi;
+	if (s == "div") return AluOp::Div;
+	if (s == "mod") return AluOp::Mod;
+	if (s == "clc") return AluOp::Clc;
+	if (s == "sec") return AluOp::Sec;
+	if (s == "cid") return AluOp::Cid;
+	if (s == "sid") return AluOp::Sid;
+
+	return AluOp::Invalid;
+}
+
+// Passing a value through only moves data, so it leaves the flags alone (alu_pass_lhs is the idle
+// state of the alu field). Adds and subtracts set all four arithmetic flags. Carry is the carry out
+// of adds and the borrow out of subtracts, which is what the seq_if xxxx1 variants (add_inc,
+// sub_dec, inc_inc, dec_dec) chain on. Shifts set carry to the bit shifted out, and everything else
+// only sets zero and sign.
+inline aluResult aluCompute(AluOp op, uint8_t lhs, uint8_t rhs)
+{
+	aluResult r;
+	int wide = 0;
+	bool arithmetic = false;
+	bool logical = true;
+
+	auto subtract = [&](int borrow)
+	{
+		wide = lhs - rhs - borrow;
+		r.affected |= ALU_CARRY | ALU_OVERFLOW;
+		if (lhs < rhs + borrow) r.flags |= ALU_CARRY;
+		if (((lhs ^ rhs) & (lhs ^ wide) & 0x80) != 0) r.flags |= ALU_OVERFLOW;
+	};
+
+	auto add = [&](int b, int carry)
+	{
+		wide = lhs + b + carry;
+		r.affected |= ALU_CARRY | ALU_OVERFLOW;
+		if (wide > 0xFF) r.flags |= ALU_CARRY;
+		if ((~(lhs ^ b) & (lhs ^ wide) & 0x80) != 0) r.flags |= ALU_OVERFLOW;
+	};
+
+	auto shiftOut = [&](bool bit)
+	{
+		r.affected |= ALU_CARRY;
+		if (bit) r.flags |= ALU_CARRY;
+	};
+
+	switch (op)
+	{
+	case AluOp::Pass_Lhs: wide = lhs; logical = false; break;
+	case AluOp::Pass_Rhs: wide = rhs; logical = false; break;
+
+	case AluOp::Inc: add(1, 0); arithmetic = true; break;
+	case AluOp::Inc_Inc: add(1, 1); arithmetic = true; break;
+	case AluOp::Dec: rhs = 1; subtract(0); arithmetic = true; break;
+	case AluOp::Dec_Dec: rhs = 1; subtract(1); arithmetic = true; break;
+	case AluOp::Add: add(rhs, 0); arithmetic = true; break;
+	case AluOp::Add_Inc: add(rhs, 1); arithmetic = true; break;
+	case AluOp::Sub: subtract(0); arithmetic = true; break;
+	case AluOp::Sub_Dec: subtract(1); arithmetic = true; break;
+
+	case AluOp::Shl_0: wide = lhs << 1; shiftOut(lhs & 0x80); break;
+	case AluOp::Shl_1: wide = (lhs << 1) | 1; shiftOut(lhs & 0x80); break;
+	case AluOp::Shr_0: wide = lhs >> 1; shiftOut(lhs & 1); break;
+	case AluOp::Shr_1: wide = (lhs >> 1) | 0x80; shiftOut(lhs & 1); break;
+
+	case AluOp::Mshl_0: wide = rhs >= 8 ? 0 : lhs << rhs; break;
+	case AluOp::Mshl_1: wide = rhs >= 8 ? 0xFF : (lhs << rhs) | ((1 << rhs) - 1); break;
+	case AluOp::Mshr_0: wide = rhs >= 8 ? 0 : lhs >> rhs; break;
+	case AluOp::Mshr_1: wide = rhs >= 8 ? 0xFF : (lhs >> rhs) | (0xFF << (8 - rhs)); break;
+
+	case AluOp::Not: wide = ~lhs; break;
+	case AluOp::And: wide = lhs & rhs; break;
+	case AluOp::Or: wide = lhs | rhs; break;
+	case AluOp::Xor: wide = lhs ^ rhs; break;
+
+	case AluOp::Mul_Lo: wide = lhs * rhs; break;
+	case AluOp::Mul_Hi: wide = (lhs * rhs) >> 8; break;
+
+	// dividing by zero gives all ones rather than a fault
+	case AluOp::Div: wide = rhs == 0 ? 0xFF : lhs / rhs; break;
+	case AluOp::Mod: wide = rhs == 0 ? 0xFF : lhs % rhs; break;
+
+	case AluOp::Clc: r.affected = ALU_CARRY; logical = false; break;
+	case AluOp::Sec: r.affected = ALU_CARRY; r.flags = ALU_CARRY; logical = false; break;
+	case AluOp::Cid: r.affected = ALU_DECIMAL; logical = false; break;
+	case AluOp::Sid: r.affected = ALU_DECIMAL; r.flags = ALU_DECIMAL; logical = false; break;
+
+	default: logical = false; break;
+	}
+
+	r.value = static_cast<uint8_t>(wide);
+
+	if (arithmetic || logical)
+	{
+		r.affected |= ALU_ZERO | ALU_SIGN;
+		if (r.value == 0) r.flags |= ALU_ZERO;
+		if (r.value & 0x80) r.flags |= ALU_SIGN;
+	}
+
+	return r;
+}
\ No newline at end of file
@@ -0,0 +1,527 @@
+#include "machine.h"
+#include "../../assembler/src/util.h"
+
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <algorithm>
+#include <cctype>
+
+void machine::load(const cpu& c)
+{
+	_registers.clear();
+	for (const symbol* s : c.getSymbols(SymbolType::Register))
+		_registers.push_back({ std::string(s->getName()), s->getAddress() });
+
+	// 16-bit registers made of two 8-bit ones
+	for (reg& r : _registers)
+	{
+		if (r.bits != 16 || r.name.size() < 2)
+			continue;
+
+		std::string base = r.name.substr(0, r.name.size() - 1);
+		int high = findRegister(base + "h");
+		int low = findRegister(base + "l");
+
+		if (high >= 0 && low >= 0 && _registers[high].bits == 8 && _registers[low].bits == 8)
+		{
+			r.high = static_cast<int8_t>(high);
+			r.low = static_cast<int8_t>(low);
+		}
+	}
+
+	_pc = findRegister("pc");
+	if (_pc < 0)
+		throw std::exception("Simulating an architecture without a pc register!");
+
+	for (uint8_t& f : _flagBits)
+		f = 0;
+
+	for (const symbol* s : c.getSymbols(SymbolType::Flag))
+	{
+		uint8_t bit = static_cast<uint8_t>(1u << (s->getAddress() - 1));
+
+		switch (std::tolower(static_cast<unsigned char>(s->getName().back())))
+		{
+		case 'c': _flagBits[0] = bit; break;
+		case 'v': _flagBits[1] = bit; break;
+		case 'z': _flagBits[2] = bit; break;
+		case 's': _flagBits[3] = bit; break;
+		case 'd': _flagBits[4] = bit; break;
+		}
+	}
+
+	decodeControlLines(c);
+
+	// Decode every word of the decoder rom up front. Most of the rom holds the same few hundred
+	// words, so each distinct word is decoded once and the rom maps onto those.
+	_layout = c.getDecoderRomLayout();
+	std::vector<uint32_t> image = c.buildDecoderRom(_layout);
+
+	std::unordered_map<uint32_t, uint32_t> seen;
+	_words.clear();
+	_wordIndex.resize(image.size());
+
+	for (size_t i = 0; i < image.size(); i++)
+	{
+		auto it = seen.find(image[i]);
+		if (it == seen.end())
+		{
+			it = seen.emplace(image[i], static_cast<uint32_t>(_words.size())).first;
+			_words.push_back(decodeWord(image[i]));
+		}
+
+		_wordIndex[i] = it->second;
+	}
+
+	compileThreaded(c);
+
+	_program = c.numProgramSegments() > 0 ? c.getProgramSegment(0) : std::vector<uint8_t>();
+	if (_program.size() > MEMORY_SIZE)
+		_program.resize(MEMORY_SIZE);
+
+	reset();
+}
+
+void machine::reset()
+{
+	_values.assign(_registers.size(), 0);
+	_memory.assign(MEMORY_SIZE, 0);
+	std::copy(_program.begin(), _program.end(), _memory.begin());
+
+	_ir = 0;
+	_cycle = 0;
+	_flags = 0;
+	_cycles = 0;
+	_instructions = 0;
+	_instructionPc = 0;
+	_halted = false;
+	_sinceSample = 0;
+}
+
+// Each control line belongs to the field of the control word that holds its bits, and is active when
+// that field holds exactly its value. Lines spanning several fields (like fetch) are shorthands for
+// other lines, so they don't need decoding of their own.
+void machine::decodeControlLines(const cpu& c)
+{
+	std::vector<int> starts(c.getControlFields().begin(), c.getControlFields().end());
+
+	_controlLines.clear();
+	for (const symbol* s : c.getSymbols(SymbolType::ControlLine))
+	{
+		uint32_t value = static_cast<uint32_t>(s->getAddress());
+		if (value == 0)
+			continue;
+
+		// without any fields, every line is taken to be a field of its own
+		uint32_t mask = value;
+
+		for (size_t f = 0; f < starts.size(); f++)
+		{
+			int end = f + 1 < starts.size() ? starts[f + 1] : 32;
+			uint32_t field = (end >= 32 ? 0xFFFFFFFFu : (1u << end) - 1) & ~((1u << starts[f]) - 1);
+
+			if ((value & field) == 0)
+				continue;
+
+			mask = (value & ~field) == 0 ? field : 0;
+			break;
+		}
+
+		if (mask != 0)
+			_controlLines.push_back({ std::string(s->getName()), value, mask });
+	}
+}
+
+machine::microWord machine::decodeWord(uint32_t word) const
+{
+	microWord w;
+
+	for (const controlLine& line : _controlLines)
+		if ((word & line.mask) == line.value)
+			applyLine(w, line.name);
+
+	return w;
+}
+
+int machine::findRegister(std::string_view name) const
+{
+	for (size_t i = 0; i < _registers.size(); i++)
+		if (_registers[i].name == name)
+			return static_cast<int>(i);
+
+	return -1;
+}
+
+int machine::registerOrThrow(std::string_view name, std::string_view line) const
+{
+	int r = findRegister(name);
+	if (r < 0)
+	{
+		std::stringstream msg;
+		msg << "Control line [" << line << "] refers to an unknown register [" << name << "]!";
+		throw std::exception(msg.str().c_str());
+	}
+
+	return r;
+}
+
+void machine::applyLine(microWord& w, std::string_view line) const
+{
+	std::string_view name = line;
+	while (!name.empty() && name.front() == '_')
+		name.remove_prefix(1);
+
+	std::string lower(name);
+	std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+
+	if (lower.find("endseq") != std::string::npos)
+	{
+		w.endSeq = true;
+		return;
+	}
+
+	if (lower.rfind("null_", 0) == 0)
+		return;
+
+	auto endsWith = [&](std::string_view suffix)
+	{
+		return name.size() > suffix.size() && name.substr(name.size() - suffix.size()) == suffix;
+	};
+
+	auto deviceIndex = [&](std::string_view x)
+	{
+		if (x.rfind("device", 0) != 0 || x.size() == 6)
+			return -1;
+
+		int d = 0;
+		for (char ch : x.substr(6))
+		{
+			if (!std::isdigit(static_cast<unsigned char>(ch)))
+				return -1;
+
+			d = d * 10 + (ch - '0');
+		}
+
+		if (d >= MAX_DEVICES)
+		{
+			std::stringstream msg;
+			msg << "Control line [" << line << "] uses device " << d << ", but only " << MAX_DEVICES << " are simulated!";
+			throw std::exception(msg.str().c_str());
+		}
+
+		return d;
+	};
+
+	auto addSink = [&](DataSink type, int index)
+	{
+		if (w.nSinks == 4)
+			throw std::exception("Too many data bus readers in one control word!");
+
+		w.sinks[w.nSinks++] = { type, static_cast<int8_t>(index) };
+	};
+
+	auto addCounter = [&](std::string_view x, int delta)
+	{
+		if (w.nCounters == 4)
+			throw std::exception("Too many counters in one control word!");
+
+		w.counters[w.nCounters++] = { static_cast<int8_t>(registerOrThrow(x, line)), static_cast<int8_t>(delta) };
+	};
+
+	if (endsWith("_write_data"))
+	{
+		std::string_view x = name.substr(0, name.size() - 11);
+		int d = deviceIndex(x);
+
+		if (x == "mem")
+		{
+			w.dataSource = DataSource::Memory;
+		}
+		else if (x == "alu")
+		{
+			w.dataSource = DataSource::Alu;
+		}
+		else if (d >= 0)
+		{
+			w.dataSource = DataSource::Device;
+			w.dataIndex = static_cast<int8_t>(d);
+		}
+		else
+		{
+			w.dataSource = DataSource::Register;
+			w.dataIndex = static_cast<int8_t>(registerOrThrow(x, line));
+		}
+	}
+	else if (endsWith("_read_data"))
+	{
+		std::string_view x = name.substr(0, name.size() - 10);
+		int d = deviceIndex(x);
+
+		if (x == "ir")
+			addSink(DataSink::Ir, 0);
+		else if (x == "mem")
+			addSink(DataSink::Memory, 0);
+		else if (d >= 0)
+			addSink(DataSink::Device, d);
+		else
+			addSink(DataSink::Register, registerOrThrow(x, line));
+	}
+	else if (lower.rfind("alu_", 0) == 0)
+	{
+		w.alu = aluOpFromName(name.substr(4));
+		if (w.alu == AluOp::Invalid)
+		{
+			std::stringstream msg;
+			msg << "Control line [" << line << "] is not a known alu operation!";
+			throw std::exception(msg.str().c_str());
+		}
+	}
+	else if (endsWith("_write_lhs") || endsWith("_write_rhs"))
+	{
+		std::string_view x = name.substr(0, name.size() - 10);
+
+		// no interrupt controller is simulated, so its vector reads as zero
+		int r = x == "int" ? -1 : registerOrThrow(x, line);
+
+		if (endsWith("_write_lhs"))
+			w.lhs = static_cast<int8_t>(r);
+		else
+			w.rhs = static_cast<int8_t>(r);
+	}
+	else if (endsWith("_read_lrhs"))
+	{
+		w.lrhs = static_cast<int8_t>(registerOrThrow(name.substr(0, name.size() - 10), line));
+	}
+	else if (endsWith("_write_addr"))
+	{
+		w.addr = static_cast<int8_t>(registerOrThrow(name.substr(0, name.size() - 11), line));
+	}
+	else if (endsWith("_read_addr"))
+	{
+		w.fromAddr = static_cast<int8_t>(registerOrThrow(name.substr(0, name.size() - 10), line));
+	}
+	else if (endsWith("_inc"))
+	{
+		addCounter(name.substr(0, name.size() - 4), 1);
+	}
+	else if (endsWith("_dec"))
+	{
+		addCounter(name.substr(0, name.size() - 4), -1);
+	}
+	else if (endsWith("_rti"))
+	{
+		// returning from an interrupt -- no interrupts are simulated
+	}
+	else if (endsWith("_read"))
+	{
+		w.fromPc = static_cast<int8_t>(registerOrThrow(name.substr(0, name.size() - 5), line));
+	}
+	else
+	{
+		std::stringstream msg;
+		msg << "Don't know how to simulate control line [" << line << "]!";
+		throw std::exception(msg.str().c_str());
+	}
+}
+
+uint16_t machine::readRegister(int r) const
+{
+	const reg& rr = _registers[r];
+	if (rr.high >= 0)
+		return static_cast<uint16_t>((_values[rr.high] << 8) | _values[rr.low]);
+
+	return _values[r];
+}
+
+void machine::writeRegister(int r, uint16_t v)
+{
+	const reg& rr = _registers[r];
+	if (rr.high >= 0)
+	{
+		_values[rr.high] = v >> 8;
+		_values[rr.low] = v & 0xFF;
+	}
+	else
+	{
+		_values[r] = rr.bits == 8 ? (v & 0xFF) : v;
+	}
+}
+
+// 16-bit registers drive their high byte onto lhs and their low byte onto rhs
+uint8_t machine::operand(int r, bool high) const
+{
+	if (r < 0)
+		return 0;
+
+	uint16_t v = readRegister(r);
+	if (_registers[r].bits == 16)
+		return static_cast<uint8_t>(high ? v >> 8 : v);
+
+	return static_cast<uint8_t>(v);
+}
+
+void machine::step()
+{
+	if (_threaded)
+		stepThreaded();
+	else
+		stepRom();
+}
+
+void machine::trace(uint64_t clock, uint8_t ir, uint32_t cycle, uint16_t pc, uint16_t address, uint8_t data) const
+{
+	std::cout << dec << clock << ": pc=$" << hex4 << pc << " ir=$" << hex2 << int(ir) << " cycle=" << dec << cycle
+		<< " addr=$" << hex4 << address << " data=$" << hex2 << int(data) << "\n";
+}
+
+void machine::stepRom()
+{
+	const microWord& w = _words[_wordIndex[_layout.address(_ir, _cycle, _flags)]];
+
+	// everything is read before anything is latched, like on a real clock edge
+	uint16_t pc = readRegister(_pc);
+	uint16_t address = w.addr >= 0 ? readRegister(w.addr) : 0;
+	uint8_t lhs = operand(w.lhs, true);
+	uint8_t rhs = operand(w.rhs, false);
+	aluResult alu = aluCompute(w.alu, lhs, rhs);
+
+	uint8_t data = 0;
+	switch (w.dataSource)
+	{
+	case DataSource::Memory: data = _memory[address]; break;
+	case DataSource::Alu: data = alu.value; break;
+	case DataSource::Device: data = _deviceIn[w.dataIndex]; break;
+	case DataSource::Register: data = static_cast<uint8_t>(readRegister(w.dataIndex)); break;
+	default: break;
+	}
+
+	if (_trace)
+		trace(_cycles, _ir, _cycle, pc, address, data);
+
+	for (int i = 0; i < w.nSinks; i++)
+	{
+		const sink& s = w.sinks[i];
+
+		switch (s.type)
+		{
+		case DataSink::Ir: _ir = data; break;
+		case DataSink::Memory: _memory[address] = data; break;
+		case DataSink::Register: writeRegister(s.index, data); break;
+
+		case DataSink::Device:
+			if (_deviceWrite)
+				_deviceWrite(s.index, data);
+			break;
+		}
+	}
+
+	if (w.lrhs >= 0)
+		writeRegister(w.lrhs, static_cast<uint16_t>((lhs << 8) | rhs));
+
+	if (w.fromPc >= 0)
+		writeRegister(w.fromPc, pc);
+
+	if (w.fromAddr >= 0)
+		writeRegister(w.fromAddr, address);
+
+	for (int i = 0; i < w.nCounters; i++)
+		writeRegister(w.counters[i].reg, static_cast<uint16_t>(readRegister(w.counters[i].reg) + w.counters[i].delta));
+
+	for (int f = 0; f < 5; f++)
+	{
+		uint8_t bit = _flagBits[f];
+		if (bit == 0 || (alu.affected & (1 << f)) == 0)
+			continue;
+
+		_flags = (alu.flags & (1 << f)) ? (_flags | bit) : (_flags & ~bit);
+	}
+
+	_cycles++;
+
+	if (w.endSeq)
+	{
+		_instructions++;
+
+		// an instruction that leaves pc where it found it will do so forever
+		uint16_t next = readRegister(_pc);
+		if (next == _instructionPc)
+			_halted = true;
+
+		_instructionPc = next;
+		_cycle = 0;
+	}
+	else
+	{
+		_cycle = (_cycle + 1) & ((1u << _layout.cycleBits) - 1);
+	}
+}
+
+void machine::setSampler(uint64_t every, std::function<void(uint16_t pc, uint8_t opcode)> f)
+{
+	_sampleEvery = f ? every : 0;
+	_sampler = std::move(f);
+	_sinceSample = 0;
+}
+
+// With a sampler, the clocks run in stretches that end where a sample is due
+uint64_t machine::run(uint64_t maxCycles)
+{
+	if (_sampleEvery == 0)
+		return runClocks(maxCycles);
+
+	uint64_t n = 0;
+	while (!_halted && n < maxCycles)
+	{
+		uint64_t stretch = std::min(_sampleEvery - _sinceSample, maxCycles - n);
+		uint64_t ran = runClocks(stretch);
+
+		n += ran;
+		_sinceSample += ran;
+
+		if (_sinceSample == _sampleEvery)
+		{
+			_sinceSample = 0;
+			_sampler(_instructionPc, _memory[_instructionPc]);
+		}
+
+		if (ran < stretch)
+			break;
+	}
+
+	return n;
+}
+
+uint64_t machine::runClocks(uint64_t maxCycles)
+{
+	uint64_t n = 0;
+
+	if (_threaded)
+	{
+		for (; !_halted && n < maxCycles; n++)
+			stepThreaded();
+	}
+	else
+	{
+		for (; !_halted && n < maxCycles; n++)
+			stepRom();
+	}
+
+	return n;
+}
+
+std::string machine::describe() const
+{
+	std::stringstream s;
+
+	for (size_t r = 0; r < _registers.size(); r++)
+	{
+		if (_registers[r].bits == 16)
+			s << _registers[r].name << "=$" << hex4 << readRegister(static_cast<int>(r)) << " ";
+		else
+			s << _registers[r].name << "=$" << hex2 << readRegister(static_cast<int>(r)) << " ";
+	}
+
+	s << "flags=$" << hex2 << int(_flags) << " ir=$" << hex2 << int(_ir);
+	return s.str();
+}
\ No newline at end of file
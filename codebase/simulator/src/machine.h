@@ -0,0 +1,227 @@
+#pragma once
+
+#include "alu.h"
+#include "../../assembler/src/cpu.h"
+#include "../../assembler/src/rom.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+// A clock-by-clock model of the machine an architecture file describes. Every clock, the decoder rom
+// word for the current (opcode, cycle, flags) is applied to the register file, the memory and the
+// devices, just as the hardware does it.
+//
+// Nothing about the machine is hardcoded. Registers and flags come from the register and flag
+// definitions, and each control word field is decoded by the names of the control lines in it:
+//
+//   x_write_data / x_read_data     x drives / latches the data bus (mem, alu, ir, deviceN, a register)
+//   x_write_lhs / x_write_rhs      register x drives an alu operand (the high / low byte of a 16-bit one)
+//   x_read_lrhs                    16-bit register x latches lhs:rhs
+//   x_write_addr                   16-bit register x drives the address bus
+//   x_inc / x_dec                  16-bit register x counts up / down
+//   x_read                         x latches the program counter (the return address)
+//   x_read_addr                    x latches the address bus
+//   alu_op_...                     the alu operation (see alu.h)
+//   ...endseq                      last cycle of the instruction
+//   null_...                       does nothing
+//
+// A leading underscore (active low in the hardware) is ignored. The flag defined at address k drives
+// bit k - 1 of the decoder rom's flag inputs, and is matched to an alu flag by the last letter of its
+// name (c, v, z, s or d).
+class machine
+{
+public:
+	static constexpr int MEMORY_SIZE = 1 << 16;
+	static constexpr int MAX_DEVICES = 16;
+
+	// Decode the control lines and build the decoder rom. The cpu must hold an assembled program.
+	void load(const cpu& c);
+	void reset();
+
+	// one clock
+	void step();
+
+	// Clock until the program halts (an instruction that jumps to itself) or maxCycles have passed.
+	// Returns the number of clocks run.
+	uint64_t run(uint64_t maxCycles);
+
+	bool halted() const { return _halted; }
+	uint64_t cycles() const { return _cycles; }
+	uint64_t instructions() const { return _instructions; }
+
+	// state
+	int findRegister(std::string_view name) const;
+	uint16_t readRegister(int r) const;
+	uint8_t flags() const { return _flags; }
+	uint8_t memory(uint16_t address) const { return _memory[address]; }
+	std::string describe() const;
+
+	// called whenever the cpu writes to a device
+	void onDeviceWrite(std::function<void(int device, uint8_t value)> f) { _deviceWrite = std::move(f); }
+	void setDeviceInput(int device, uint8_t value) { _deviceIn[device] = value; }
+
+	// print every clock to stdout
+	void setTrace(bool t) { _trace = t; }
+
+	// Sampling -- every n clocks, run hands the sampler the address of the instruction being run and
+	// its opcode. The clocks in between run just as they do without a sampler, so sampling costs
+	// nothing per clock. n = 0 turns it off.
+	void setSampler(uint64_t every, std::function<void(uint16_t pc, uint8_t opcode)> f);
+
+	// By default, clocks run through handler chains compiled from the opcodes' control patterns (see
+	// threaded.cpp). Turning that off looks every clock up in the decoder rom image instead -- slower,
+	// but exactly what the hardware does.
+	void setThreaded(bool t) { _threaded = t; }
+
+private:
+	enum class DataSource : uint8_t { None, Memory, Alu, Device, Register };
+	enum class DataSink : uint8_t { Ir, Memory, Device, Register };
+
+	struct sink
+	{
+		DataSink type;
+		int8_t index;
+	};
+
+	struct counter
+	{
+		int8_t reg;
+		int8_t delta;
+	};
+
+	// one control word, decoded
+	struct microWord
+	{
+		DataSource dataSource = DataSource::None;
+		int8_t dataIndex = -1;
+
+		int8_t lhs = -1;
+		int8_t rhs = -1;
+		int8_t addr = -1;
+		int8_t lrhs = -1;
+		int8_t fromPc = -1;
+		int8_t fromAddr = -1;
+
+		AluOp alu = AluOp::Pass_Lhs;
+		bool endSeq = false;
+
+		uint8_t nSinks = 0;
+		sink sinks[4];
+		uint8_t nCounters = 0;
+		counter counters[4];
+	};
+
+	// A register is 8 or 16 bits. A 16-bit register like dx whose halves (dh, dl) are registers too
+	// is just the pair of them.
+	struct reg
+	{
+		std::string name;
+		int bits;
+		int8_t high = -1;
+		int8_t low = -1;
+	};
+
+	struct controlLine
+	{
+		std::string name;
+		uint32_t value;
+		uint32_t mask;
+	};
+
+	void decodeControlLines(const cpu& c);
+	microWord decodeWord(uint32_t word) const;
+	void applyLine(microWord& w, std::string_view name) const;
+	int registerOrThrow(std::string_view name, std::string_view line) const;
+
+	void writeRegister(int r, uint16_t v);
+	uint8_t operand(int r, bool high) const;
+
+	void stepRom();
+	uint64_t runClocks(uint64_t maxCycles);
+	void stepThreaded();
+	void trace(uint64_t clock, uint8_t ir, uint32_t cycle, uint16_t pc, uint16_t address, uint8_t data) const;
+
+	// Threaded code. Every distinct control word is compiled into a chain of micro-ops, each with a
+	// handler specialized for its job (alu operation, register kind, ...) that calls the next one
+	// directly. The chain ends in a handler that moves on to the next cycle or instruction.
+	friend struct microOps;
+	struct microOp;
+	using handler = void (*)(machine& m, const microOp* op);
+
+	struct microOp
+	{
+		handler run;
+		int8_t a;
+		int8_t b;
+		int8_t c;
+	};
+
+	// The chains one (opcode, cycle) can run, one per flag condition. Conditions are checked in
+	// order, and when none holds the cycle runs the chain of an all-zero control word, just like an
+	// unprogrammed decoder rom location.
+	struct cycleCode
+	{
+		uint8_t count = 0;
+		flagSet conditions[2];
+		const microOp* chains[2] = { };
+		const microOp* otherwise = nullptr;
+	};
+
+	// what the buses carry during the current clock
+	struct busState
+	{
+		uint16_t pc;
+		uint16_t address;
+		uint8_t lhs;
+		uint8_t rhs;
+		uint8_t data;
+	};
+
+	void compileThreaded(const cpu& c);
+	uint32_t compileWord(uint32_t word);
+
+private:
+	// architecture
+	std::vector<reg> _registers;
+	std::vector<controlLine> _controlLines;
+	uint8_t _flagBits[5] = { };
+	int _pc = -1;
+
+	decoderRomLayout _layout;
+	std::vector<microWord> _words;
+	std::vector<uint32_t> _wordIndex;
+
+	// threaded code
+	std::vector<microOp> _ops;
+	std::unordered_map<uint32_t, uint32_t> _compiledWords;
+	std::vector<cycleCode> _code;
+	busState _bus = { };
+	bool _threaded = true;
+
+	// state
+	std::vector<uint16_t> _values;
+	std::vector<uint8_t> _program;
+	std::vector<uint8_t> _memory;
+	uint8_t _ir = 0;
+	uint32_t _cycle = 0;
+	uint8_t _flags = 0;
+	std::array<uint8_t, MAX_DEVICES> _deviceIn = { };
+
+	uint64_t _cycles = 0;
+	uint64_t _instructions = 0;
+	uint16_t _instructionPc = 0;
+	bool _halted = false;
+	bool _trace = false;
+
+	// sampling
+	uint64_t _sampleEvery = 0;
+	uint64_t _sinceSample = 0;
+	std::function<void(uint16_t, uint8_t)> _sampler;
+
+	std::function<void(int, uint8_t)> _deviceWrite;
+};
\ No newline at end of file
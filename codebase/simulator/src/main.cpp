@@ -0,0 +1,117 @@
+#include "machine.h"
+#include "profiler.h"
+#include "../../assembler/src/assembler.h"
+#include "../../assembler/src/cpu.h"
+#include "../../assembler/src/util.h"
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+int main(int argc, char* argv[])
+{
+	// On the command-line, we expect ./sim file.s [options], where file.s is a program for the
+	// architecture it includes. The program is assembled in memory, then run clock by clock.
+	//  -I dir       add to the include search path (the code directory is searched last)
+	//  -cycles n    stop after n clocks (default 100 million)
+	//  -device n    print whatever the program writes to device n as text
+	//  -trace       print every clock
+	//  -rom         look every clock up in the decoder rom instead of running compiled code
+	//  -profile n   sample the running instruction every n clocks, then print where the time went by
+	//               label and by mnemonic, and write file.folded for flame graph tools
+	if (argc < 2)
+	{
+		std::cout << "Please specify an input file!" << std::endl;
+		return 1;
+	}
+
+	try
+	{
+		cpu cpu;
+		assembler assembler(argv[1], cpu);
+		assembler.setEcho(0x10);
+
+		machine m;
+		uint64_t maxCycles = 100000000;
+		int printDevice = -1;
+		uint64_t profileEvery = 0;
+
+		for (int i = 2; i < argc; i++)
+		{
+			std::string arg = argv[i];
+
+			if (arg == "-I" && i + 1 < argc)
+				assembler.addIncludePath(argv[++i]);
+			else if (arg.rfind("-I", 0) == 0 && arg.size() > 2)
+				assembler.addIncludePath(arg.substr(2));
+			else if (arg == "-cycles" && i + 1 < argc)
+				maxCycles = std::stoull(argv[++i]);
+			else if (arg == "-device" && i + 1 < argc)
+				printDevice = std::stoi(argv[++i]);
+			else if (arg == "-trace")
+				m.setTrace(true);
+			else if (arg == "-profile" && i + 1 < argc)
+				profileEvery = std::stoull(argv[++i]);
+			else if (arg == "-rom")
+				m.setThreaded(false);
+			else
+				std::cout << "Ignoring unknown argument [" << arg << "]" << std::endl;
+		}
+
+		assembler.addIncludePath("code");
+
+		// assemble without writing any rom images
+		assembler.assembly_pass0();
+		cpu.resolveFixups();
+
+		m.load(cpu);
+
+		if (printDevice >= 0)
+			m.onDeviceWrite([printDevice](int device, uint8_t value) { if (device == printDevice) std::cout << static_cast<char>(value); });
+
+		std::unique_ptr<profiler> profile;
+		if (profileEvery > 0)
+		{
+			profile = std::make_unique<profiler>(cpu);
+			m.setSampler(profileEvery, [&profile](uint16_t pc, uint8_t opcode) { profile->sample(pc, opcode); });
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		uint64_t cycles = m.run(maxCycles);
+		auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+		double seconds = elapsed.count();
+		double rate = seconds > 0 ? cycles / seconds : 0;
+
+		std::cout << "\n-- " << (m.halted() ? "halted" : "stopped") << " after " << dec << cycles << " cycles ("
+			<< m.instructions() << " instructions) in " << seconds * 1000.0 << " ms = " << rate / 1.0e6 << " MHz\n";
+		std::cout << "   " << m.describe() << "\n";
+
+		if (profile)
+		{
+			profile->writeFlat(std::cout, profileEvery);
+
+			std::string filename = assembler.outputBasename() + profiler::COLLAPSED_EXTENSION;
+			std::ofstream folded(filename);
+			if (!folded)
+			{
+				std::stringstream msg;
+				msg << "Could not write collapsed stacks [" << filename << "]!";
+				throw std::exception(msg.str().c_str());
+			}
+
+			profile->writeCollapsed(folded);
+			std::cout << "\n-- wrote collapsed stacks to " << filename << "\n";
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Fatal error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "profiler.h"
+#include "../../assembler/src/util.h"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+profiler::profiler(const cpu& c)
+{
+	for (const symbol* s : c.getSymbols(SymbolType::Label))
+		_labels.push_back({ s->getAddress(), std::string(s->getName()) });
+
+	// labels at the same address keep the order they were defined in, so the last one names it
+	std::stable_sort(_labels.begin(), _labels.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	// opcodes that aren't defined show as their value
+	_mnemonics.resize(256);
+	for (int v = 0; v < 256; v++)
+	{
+		const opcode* oc = c.getOpcode(v);
+		if (oc != nullptr)
+		{
+			_mnemonics[v] = oc->mnemonic();
+		}
+		else
+		{
+			std::stringstream s;
+			s << "$" << hex2 << v;
+			_mnemonics[v] = s.str();
+		}
+	}
+}
+
+const std::string& profiler::labelOf(uint16_t pc) const
+{
+	auto i = std::upper_bound(_labels.begin(), _labels.end(), static_cast<int>(pc), [](int a, const auto& l) { return a < l.first; });
+	return i == _labels.begin() ? _noLabel : std::prev(i)->second;
+}
+
+const std::string& profiler::mnemonicOf(uint8_t opcode) const
+{
+	return _mnemonics[opcode];
+}
+
+std::vector<profiler::entry> profiler::byLabel() const
+{
+	std::map<std::string, uint64_t> totals;
+	for (const auto& c : _counts)
+		totals[labelOf(static_cast<uint16_t>(c.first >> 8))] += c.second;
+
+	std::vector<entry> entries;
+	for (const auto& t : totals)
+		entries.push_back({ t.first, t.second });
+
+	sortBySamples(entries);
+	return entries;
+}
+
+std::vector<profiler::entry> profiler::byMnemonic() const
+{
+	std::map<std::string, uint64_t> totals;
+	for (const auto& c : _counts)
+		totals[mnemonicOf(static_cast<uint8_t>(c.first & 0xFF))] += c.second;
+
+	std::vector<entry> entries;
+	for (const auto& t : totals)
+		entries.push_back({ t.first, t.second });
+
+	sortBySamples(entries);
+	return entries;
+}
+
+// the most samples first, and by name among equals so the output doesn't move around
+void profiler::sortBySamples(std::vector<entry>& entries)
+{
+	std::stable_sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) { return a.samples > b.samples; });
+}
+
+void profiler::writeTable(std::ostream& o, const char* title, const std::vector<entry>& entries, uint64_t total, uint64_t every)
+{
+	o << "\n" << std::setfill(' ') << std::setw(10) << "samples" << std::setw(8) << "%" << std::setw(14) << "~clocks" << "  " << title << "\n";
+
+	for (const entry& e : entries)
+	{
+		double percent = total > 0 ? 100.0 * e.samples / total : 0;
+
+		o << dec << std::setfill(' ') << std::setw(10) << e.samples << std::setw(7) << std::fixed << std::setprecision(1) << percent << "%"
+			<< std::setw(14) << e.samples * every << "  " << e.name << "\n";
+	}
+
+	o << std::defaultfloat << std::setprecision(6);
+}
+
+void profiler::writeFlat(std::ostream& o, uint64_t every) const
+{
+	o << "\n-- profile: " << dec << _samples << " sample(s), one every " << every << " clocks\n";
+
+	writeTable(o, "label", byLabel(), _samples, every);
+	writeTable(o, "mnemonic", byMnemonic(), _samples, every);
+}
+
+void profiler::writeCollapsed(std::ostream& o) const
+{
+	std::map<std::string, uint64_t> stacks;
+	for (const auto& c : _counts)
+		stacks[labelOf(static_cast<uint16_t>(c.first >> 8)) + ";" + mnemonicOf(static_cast<uint8_t>(c.first & 0xFF))] += c.second;
+
+	for (const auto& s : stacks)
+		o << s.first << " " << dec << s.second << "\n";
+}
\ No newline at end of file
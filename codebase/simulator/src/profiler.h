@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../../assembler/src/cpu.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+#include <cstdint>
+
+// A sampling profile of a simulated program (see machine::setSampler). Each sample is the address of
+// the instruction that was running and its opcode. Once the run is over, an address is put down to the
+// label it falls under -- the closest label at or before it -- and an opcode to its mnemonic.
+//
+// The flat profile lists the labels and the mnemonics by how many samples landed in them. Collapsed
+// stacks (label;mnemonic count, one per line) go to flame graph tools. The architecture keeps return
+// addresses in a register rather than on a stack, so there is no call stack to walk at sample time --
+// a stack is the label with the opcodes that ran under it.
+class profiler
+{
+public:
+	static constexpr const char* COLLAPSED_EXTENSION = ".folded";
+
+	explicit profiler(const cpu& c);
+
+	void sample(uint16_t pc, uint8_t opcode)
+	{
+		_counts[(static_cast<uint32_t>(pc) << 8) | opcode]++;
+		_samples++;
+	}
+
+	uint64_t samples() const { return _samples; }
+
+	// every is the clocks between samples, which each sample is taken to stand for
+	void writeFlat(std::ostream& o, uint64_t every) const;
+	void writeCollapsed(std::ostream& o) const;
+
+private:
+	struct entry
+	{
+		std::string name;
+		uint64_t samples;
+	};
+
+	const std::string& labelOf(uint16_t pc) const;
+	const std::string& mnemonicOf(uint8_t opcode) const;
+
+	std::vector<entry> byLabel() const;
+	std::vector<entry> byMnemonic() const;
+
+	static void sortBySamples(std::vector<entry>& entries);
+	static void writeTable(std::ostream& o, const char* title, const std::vector<entry>& entries, uint64_t total, uint64_t every);
+
+private:
+	// labels by address -- addresses before the first label fall under an unnamed one
+	std::vector<std::pair<int, std::string>> _labels;
+	std::string _noLabel = "[no label]";
+
+	std::vector<std::string> _mnemonics;
+
+	// samples by (pc << 8) | opcode
+	std::unordered_map<uint32_t, uint64_t> _counts;
+	uint64_t _samples = 0;
+};
\ No newline at end of file
@@ -0,0 +1,363 @@
+#include "machine.h"
+
+#include <array>
+#include <utility>
+
+namespace
+{
+	// What a micro-op's register operand is -- a plain 8 or 16-bit register, or a 16-bit register
+	// made of two 8-bit ones (a = high half, b = low half)
+	enum RegKind { Reg8, Reg16, RegPair };
+}
+
+// The micro-op handlers. Each one does a single job for the current clock and then jumps straight to
+// the next micro-op in its chain, so a clock costs one dispatch on (opcode, cycle, flags) plus one
+// indirect call per active control field -- nothing is decoded while running.
+struct microOps
+{
+	using op = machine::microOp;
+	using handler = machine::handler;
+
+	static void next(machine& m, const op* o) { o[1].run(m, o + 1); }
+
+	template <int Kind>
+	static uint16_t read(const machine& m, const op* o)
+	{
+		if constexpr (Kind == RegPair)
+			return static_cast<uint16_t>((m._values[o->a] << 8) | m._values[o->b]);
+		else
+			return m._values[o->a];
+	}
+
+	template <int Kind>
+	static void write(machine& m, const op* o, uint16_t v)
+	{
+		if constexpr (Kind == RegPair)
+		{
+			m._values[o->a] = v >> 8;
+			m._values[o->b] = v & 0xFF;
+		}
+		else if constexpr (Kind == Reg8)
+		{
+			m._values[o->a] = v & 0xFF;
+		}
+		else
+		{
+			m._values[o->a] = v;
+		}
+	}
+
+	// everything that drives a bus comes first...
+	template <int Kind>
+	static void address(machine& m, const op* o) { m._bus.address = read<Kind>(m, o); next(m, o); }
+
+	// 16-bit registers drive their high byte onto lhs and their low byte onto rhs
+	template <int Kind>
+	static void lhs(machine& m, const op* o)
+	{
+		if constexpr (Kind == Reg16)
+			m._bus.lhs = static_cast<uint8_t>(m._values[o->a] >> 8);
+		else
+			m._bus.lhs = static_cast<uint8_t>(m._values[o->a]);
+
+		next(m, o);
+	}
+
+	template <int Kind>
+	static void rhs(machine& m, const op* o)
+	{
+		if constexpr (Kind == RegPair)
+			m._bus.rhs = static_cast<uint8_t>(m._values[o->b]);
+		else
+			m._bus.rhs = static_cast<uint8_t>(m._values[o->a]);
+
+		next(m, o);
+	}
+
+	template <AluOp Op, bool ToData>
+	static void alu(machine& m, const op* o)
+	{
+		aluResult r = aluCompute(Op, m._bus.lhs, m._bus.rhs);
+
+		if constexpr (ToData)
+			m._bus.data = r.value;
+
+		// nothing in a chain reads the flags, so they can change right away
+		for (int f = 0; f < 5; f++)
+		{
+			uint8_t bit = m._flagBits[f];
+			if (bit != 0 && (r.affected & (1 << f)) != 0)
+				m._flags = (r.flags & (1 << f)) ? (m._flags | bit) : (m._flags & ~bit);
+		}
+
+		next(m, o);
+	}
+
+	static void dataMemory(machine& m, const op* o) { m._bus.data = m._memory[m._bus.address]; next(m, o); }
+	static void dataDevice(machine& m, const op* o) { m._bus.data = m._deviceIn[o->a]; next(m, o); }
+
+	template <int Kind>
+	static void dataRegister(machine& m, const op* o) { m._bus.data = static_cast<uint8_t>(read<Kind>(m, o)); next(m, o); }
+
+	// ...then everything that latches
+	static void sinkIr(machine& m, const op* o) { m._ir = m._bus.data; next(m, o); }
+	static void sinkMemory(machine& m, const op* o) { m._memory[m._bus.address] = m._bus.data; next(m, o); }
+
+	static void sinkDevice(machine& m, const op* o)
+	{
+		if (m._deviceWrite)
+			m._deviceWrite(o->a, m._bus.data);
+
+		next(m, o);
+	}
+
+	template <int Kind>
+	static void sinkRegister(machine& m, const op* o) { write<Kind>(m, o, m._bus.data); next(m, o); }
+
+	template <int Kind>
+	static void fromLhsRhs(machine& m, const op* o) { write<Kind>(m, o, static_cast<uint16_t>((m._bus.lhs << 8) | m._bus.rhs)); next(m, o); }
+
+	template <int Kind>
+	static void fromPc(machine& m, const op* o) { write<Kind>(m, o, m._bus.pc); next(m, o); }
+
+	template <int Kind>
+	static void fromAddress(machine& m, const op* o) { write<Kind>(m, o, m._bus.address); next(m, o); }
+
+	template <int Kind>
+	static void count(machine& m, const op* o) { write<Kind>(m, o, static_cast<uint16_t>(read<Kind>(m, o) + o->c)); next(m, o); }
+
+	// the end of every chain
+	static void endCycle(machine& m, const op*)
+	{
+		m._cycle = (m._cycle + 1) & ((1u << m._layout.cycleBits) - 1);
+	}
+
+	static void endInstruction(machine& m, const op*)
+	{
+		m._instructions++;
+
+		// an instruction that leaves pc where it found it will do so forever
+		uint16_t pc = m.readRegister(m._pc);
+		if (pc == m._instructionPc)
+			m._halted = true;
+
+		m._instructionPc = pc;
+		m._cycle = 0;
+	}
+
+	template <bool ToData, size_t... I>
+	static constexpr std::array<handler, sizeof...(I)> aluTable(std::index_sequence<I...>)
+	{
+		return { { &alu<static_cast<AluOp>(I), ToData>... } };
+	}
+};
+
+// the handler for each alu operation and register kind
+namespace
+{
+	using handler = microOps::handler;
+
+	constexpr size_t ALU_OPS = static_cast<size_t>(AluOp::Invalid);
+	constexpr auto aluOnly = microOps::aluTable<false>(std::make_index_sequence<ALU_OPS>());
+	constexpr auto aluToData = microOps::aluTable<true>(std::make_index_sequence<ALU_OPS>());
+
+	constexpr handler addressOps[] = { &microOps::address<Reg8>, &microOps::address<Reg16>, &microOps::address<RegPair> };
+	constexpr handler lhsOps[] = { &microOps::lhs<Reg8>, &microOps::lhs<Reg16>, &microOps::lhs<RegPair> };
+	constexpr handler rhsOps[] = { &microOps::rhs<Reg8>, &microOps::rhs<Reg16>, &microOps::rhs<RegPair> };
+	constexpr handler dataRegisterOps[] = { &microOps::dataRegister<Reg8>, &microOps::dataRegister<Reg16>, &microOps::dataRegister<RegPair> };
+	constexpr handler sinkRegisterOps[] = { &microOps::sinkRegister<Reg8>, &microOps::sinkRegister<Reg16>, &microOps::sinkRegister<RegPair> };
+	constexpr handler fromLhsRhsOps[] = { &microOps::fromLhsRhs<Reg8>, &microOps::fromLhsRhs<Reg16>, &microOps::fromLhsRhs<RegPair> };
+	constexpr handler fromPcOps[] = { &microOps::fromPc<Reg8>, &microOps::fromPc<Reg16>, &microOps::fromPc<RegPair> };
+	constexpr handler fromAddressOps[] = { &microOps::fromAddress<Reg8>, &microOps::fromAddress<Reg16>, &microOps::fromAddress<RegPair> };
+	constexpr handler countOps[] = { &microOps::count<Reg8>, &microOps::count<Reg16>, &microOps::count<RegPair> };
+}
+
+// Compile one control word into a chain of micro-ops -- once per distinct word
+uint32_t machine::compileWord(uint32_t word)
+{
+	auto found = _compiledWords.find(word);
+	if (found != _compiledWords.end())
+		return found->second;
+
+	const microWord w = decodeWord(word);
+	uint32_t start = static_cast<uint32_t>(_ops.size());
+
+	auto emit = [&](handler h, int a = 0, int b = 0, int c = 0)
+	{
+		_ops.push_back({ h, static_cast<int8_t>(a), static_cast<int8_t>(b), static_cast<int8_t>(c) });
+	};
+
+	// pick the handler for the register's kind
+	auto emitRegister = [&](const handler (&family)[3], int r, int c = 0)
+	{
+		const reg& rr = _registers[r];
+
+		if (rr.high >= 0)
+			emit(family[RegPair], rr.high, rr.low, c);
+		else
+			emit(family[rr.bits == 16 ? Reg16 : Reg8], r, 0, c);
+	};
+
+	if (w.addr >= 0)
+		emitRegister(addressOps, w.addr);
+
+	if (w.lhs >= 0)
+		emitRegister(lhsOps, w.lhs);
+
+	if (w.rhs >= 0)
+		emitRegister(rhsOps, w.rhs);
+
+	// the alu only needs to run when its result goes somewhere or it sets flags
+	bool toData = w.dataSource == DataSource::Alu;
+	if (toData || aluCompute(w.alu, 0, 0).affected != 0)
+		emit((toData ? aluToData : aluOnly)[static_cast<size_t>(w.alu)]);
+
+	switch (w.dataSource)
+	{
+	case DataSource::Memory: emit(&microOps::dataMemory); break;
+	case DataSource::Device: emit(&microOps::dataDevice, w.dataIndex); break;
+	case DataSource::Register: emitRegister(dataRegisterOps, w.dataIndex); break;
+	default: break;
+	}
+
+	for (int i = 0; i < w.nSinks; i++)
+	{
+		const sink& s = w.sinks[i];
+
+		switch (s.type)
+		{
+		case DataSink::Ir: emit(&microOps::sinkIr); break;
+		case DataSink::Memory: emit(&microOps::sinkMemory); break;
+		case DataSink::Device: emit(&microOps::sinkDevice, s.index); break;
+		case DataSink::Register: emitRegister(sinkRegisterOps, s.index); break;
+		}
+	}
+
+	if (w.lrhs >= 0)
+		emitRegister(fromLhsRhsOps, w.lrhs);
+
+	if (w.fromPc >= 0)
+		emitRegister(fromPcOps, w.fromPc);
+
+	if (w.fromAddr >= 0)
+		emitRegister(fromAddressOps, w.fromAddr);
+
+	for (int i = 0; i < w.nCounters; i++)
+		emitRegister(countOps, w.counters[i].reg, w.counters[i].delta);
+
+	emit(w.endSeq ? &microOps::endInstruction : &microOps::endCycle);
+
+	_compiledWords.emplace(word, start);
+	return start;
+}
+
+// Compile every (opcode, cycle) straight from the opcodes' control patterns. A cycle's conditions
+// are ordered the way the decoder rom gets filled: plain conditions win over complemented ones
+// (seq_else), and among equals the later pattern wins.
+void machine::compileThreaded(const cpu& c)
+{
+	_ops.clear();
+	_compiledWords.clear();
+
+	const size_t cycles = size_t(1) << _layout.cycleBits;
+	const size_t opcodes = size_t(1) << _layout.opcodeBits;
+
+	// chains are collected as indices, since _ops keeps growing until everything is compiled
+	struct pending
+	{
+		uint32_t chains[2];
+		uint32_t otherwise;
+	};
+
+	uint32_t zero = compileWord(0);
+
+	_code.assign(opcodes * cycles, cycleCode());
+	std::vector<pending> chains(_code.size(), { { zero, zero }, zero });
+
+	// opcodes share most of their cycles, so each distinct one is compiled once and copied after that
+	const opcodeTable& table = c.getOpcodes();
+	std::vector<size_t> compiled(table.numDistinctCycles(), _code.size());
+	std::vector<int> ids;
+
+	for (const opcode& oc : table)
+	{
+		table.cycleIds(oc, ids);
+
+		for (int cycle = 0; cycle < oc.numCycles() && cycle < static_cast<int>(cycles); cycle++)
+		{
+			size_t index = static_cast<size_t>(oc.value()) * cycles + cycle;
+			cycleCode& code = _code[index];
+			pending& p = chains[index];
+
+			if (compiled[ids[cycle]] < _code.size())
+			{
+				code = _code[compiled[ids[cycle]]];
+				p = chains[compiled[ids[cycle]]];
+				continue;
+			}
+
+			compiled[ids[cycle]] = index;
+
+			const controlPatterns& cps = table.getDistinctCycle(ids[cycle]);
+
+			for (int pass = 0; pass < 2; pass++)
+			{
+				for (int i = cps.count - 1; i >= 0; i--)
+				{
+					const controlPattern& cp = cps.cpattern[i];
+					if (cp.flags.complemented() != (pass == 1) || cp.flags.empty())
+						continue;
+
+					uint32_t chain = compileWord(static_cast<uint32_t>(cp.pattern));
+
+					if (cp.flags.isAll())
+					{
+						p.otherwise = chain;
+						pass = 2;
+						break;
+					}
+
+					if (code.count < 2)
+					{
+						code.conditions[code.count] = cp.flags;
+						p.chains[code.count++] = chain;
+					}
+				}
+			}
+		}
+	}
+
+	for (size_t i = 0; i < _code.size(); i++)
+	{
+		_code[i].chains[0] = &_ops[chains[i].chains[0]];
+		_code[i].chains[1] = &_ops[chains[i].chains[1]];
+		_code[i].otherwise = &_ops[chains[i].otherwise];
+	}
+}
+
+void machine::stepThreaded()
+{
+	const cycleCode& code = _code[(static_cast<size_t>(_ir) << _layout.cycleBits) | _cycle];
+
+	const microOp* chain = code.otherwise;
+	for (int i = 0; i < code.count; i++)
+	{
+		if (code.conditions[i].contains(_flags))
+		{
+			chain = code.chains[i];
+			break;
+		}
+	}
+
+	_bus = { readRegister(_pc), 0, 0, 0, 0 };
+
+	uint64_t clock = _cycles;
+	uint8_t ir = _ir;
+	uint32_t cycle = _cycle;
+
+	chain->run(*this, chain);
+	_cycles++;
+
+	if (_trace)
+		trace(clock, ir, cycle, _bus.pc, _bus.address, _bus.data);
+}
\ No newline at end of file
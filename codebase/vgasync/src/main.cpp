@@ -0,0 +1,147 @@
+#include "vgamode.h"
+#include "vgarom.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+int main(int argc, char* argv[])
+{
+	// On the command-line, we expect ./vgasync [mode] [options], where mode is one of the presets
+	// (640x480@60 by default). Any of its timings can be overridden:
+	//  -clock mhz                    pixel clock
+	//  -h visible,front,sync,back    horizontal timing, in pixels
+	//  -v visible,front,sync,back    vertical timing, in lines
+	//  -hpol + | -vpol +             sync polarity (- for active low)
+	//  -o file                       where the rom image goes (default vga<mode>.bin, e.g. vga640x480_60.bin)
+	//  -check                        check the mode and the image it makes instead of writing it
+	// A mode with overridden timings is named after them (see vgaMode::timingName), and a mode that
+	// fails its checks isn't written.
+	try
+	{
+		vgaMode mode = vgaPresets().front();
+		std::string filename;
+		bool check = false;
+		bool overridden = false;
+
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "-clock" && hasValue)
+			{
+				mode.pixelClock = std::stod(argv[++i]);
+				overridden = true;
+			}
+			else if (arg == "-h" && hasValue)
+			{
+				parseVgaAxis(argv[++i], mode.h);
+				overridden = true;
+			}
+			else if (arg == "-v" && hasValue)
+			{
+				parseVgaAxis(argv[++i], mode.v);
+				overridden = true;
+			}
+			else if (arg == "-hpol" && hasValue)
+			{
+				mode.h.syncPositive = std::string(argv[++i]) == "+";
+				overridden = true;
+			}
+			else if (arg == "-vpol" && hasValue)
+			{
+				mode.v.syncPositive = std::string(argv[++i]) == "+";
+				overridden = true;
+			}
+			else if (arg == "-o" && hasValue)
+			{
+				filename = argv[++i];
+			}
+			else if (arg == "-check")
+			{
+				check = true;
+			}
+			else if (const vgaMode* preset = findVgaPreset(arg))
+			{
+				mode = *preset;
+				overridden = false;
+			}
+			else
+			{
+				std::cout << "Ignoring unknown argument [" << arg << "]" << std::endl;
+			}
+		}
+
+		// a preset's name no longer fits once its timings are changed
+		if (overridden)
+			mode.name = mode.timingName();
+
+		if (filename.empty())
+		{
+			filename = "vga" + mode.name + ".bin";
+			std::replace(filename.begin(), filename.end(), '@', '_');
+		}
+
+		std::cout << "-- " << mode.describe() << "\n";
+
+		std::vector<std::string> errors = checkVgaMode(mode);
+		if (!check && !errors.empty())
+		{
+			for (const std::string& e : errors)
+				std::cout << "   !!! " << e << "\n";
+
+			std::cout << "   FAILED, not writing " << filename << "\n";
+			return 1;
+		}
+
+		vgaRomLayout layout(mode);
+		std::cout << "   " << layout.describe() << "\n";
+
+		auto start = std::chrono::steady_clock::now();
+
+		if (check)
+		{
+			vgaRomChecker checker(mode);
+			generateVgaRom(mode, [&](const uint8_t* data, size_t size) { checker.consume(data, size); });
+
+			for (const std::string& e : checker.finish())
+				errors.push_back(e);
+
+			for (const std::string& e : errors)
+				std::cout << "   !!! " << e << "\n";
+
+			auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+			std::cout << "   " << (errors.empty() ? "ok" : "FAILED") << ", checked in " << elapsed.count() << " ms\n";
+
+			return errors.empty() ? 0 : 1;
+		}
+
+		std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::string msg = "Could not open rom file [" + filename + "] for writing!";
+			throw std::exception(msg.c_str());
+		}
+
+		generateVgaRom(mode, [&](const uint8_t* data, size_t size) { file.write(reinterpret_cast<const char*>(data), size); });
+
+		if (!file)
+		{
+			std::string msg = "Could not write rom file [" + filename + "]!";
+			throw std::exception(msg.c_str());
+		}
+
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+		std::cout << "          *** Wrote timing rom to " << filename << " in " << elapsed.count() << " ms\n";
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Fatal error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "vgamode.h"
+
+#include <sstream>
+#include <iomanip>
+#include <exception>
+
+std::string vgaMode::describe() const
+{
+	auto axis = [](std::stringstream& s, const char* label, const vgaAxis& a)
+	{
+		s << label << " " << a.visible << " + " << a.frontPorch << " + " << a.sync << (a.syncPositive ? " (+)" : " (-)")
+			<< " + " << a.backPorch << " = " << a.total();
+	};
+
+	std::stringstream s;
+	s << name << " @ " << pixelClock << " MHz: ";
+	axis(s, "h", h);
+	s << ", ";
+	axis(s, "v", v);
+	s << " -> " << lineRate() << " kHz, " << refreshRate() << " Hz";
+
+	return s.str();
+}
+
+std::string vgaMode::timingName() const
+{
+	for (const vgaMode& m : vgaPresets())
+		if (sameTiming(m))
+			return m.name;
+
+	auto axis = [](std::stringstream& s, const char* label, const vgaAxis& a)
+	{
+		s << "-" << label << a.frontPorch << "." << a.sync << "." << a.backPorch << (a.syncPositive ? "p" : "n");
+	};
+
+	std::stringstream s;
+	s << h.visible << "x" << v.visible << "@" << std::fixed << std::setprecision(2) << refreshRate() << std::defaultfloat << std::setprecision(6);
+	axis(s, "h", h);
+	axis(s, "v", v);
+	s << "-" << pixelClock << "mhz";
+
+	return s.str();
+}
+
+bool vgaMode::sameTiming(const vgaMode& other) const
+{
+	auto sameAxis = [](const vgaAxis& a, const vgaAxis& b)
+	{
+		return a.visible == b.visible && a.frontPorch == b.frontPorch && a.sync == b.sync && a.backPorch == b.backPorch &&
+			a.syncPositive == b.syncPositive;
+	};
+
+	return pixelClock == other.pixelClock && sameAxis(h, other.h) && sameAxis(v, other.v);
+}
+
+const std::vector<vgaMode>& vgaPresets()
+{
+	static const std::vector<vgaMode> presets =
+	{
+		{ "640x480@60", 25.175, { 640, 16, 96, 48, false }, { 480, 10, 2, 33, false } },
+		{ "640x480@72", 31.5, { 640, 24, 40, 128, false }, { 480, 9, 3, 28, false } },
+		{ "800x600@56", 36.0, { 800, 24, 72, 128, true }, { 600, 1, 2, 22, true } },
+		{ "800x600@60", 40.0, { 800, 40, 128, 88, true }, { 600, 1, 4, 23, true } },
+		{ "1024x768@60", 65.0, { 1024, 24, 136, 160, false }, { 768, 3, 6, 29, false } },
+	};
+
+	return presets;
+}
+
+const vgaMode* findVgaPreset(std::string_view name)
+{
+	for (const vgaMode& m : vgaPresets())
+		if (m.name == name)
+			return &m;
+
+	return nullptr;
+}
+
+void parseVgaAxis(const std::string& s, vgaAxis& axis)
+{
+	int* fields[] = { &axis.visible, &axis.frontPorch, &axis.sync, &axis.backPorch };
+
+	std::stringstream in(s);
+	for (int i = 0; i < 4; i++)
+	{
+		char comma = ',';
+		if (!(in >> *fields[i]) || *fields[i] < 0 || (i < 3 && !(in >> comma)) || comma != ',')
+		{
+			std::stringstream msg;
+			msg << "Could not read [" << s << "] as visible,front,sync,back!";
+			throw std::exception(msg.str().c_str());
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One axis of a video mode -- in pixels for the horizontal one, in lines for the vertical one. A
+// line or frame is the visible part, then the front porch, the sync pulse and the back porch.
+class vgaAxis
+{
+public:
+	int visible = 0;
+	int frontPorch = 0;
+	int sync = 0;
+	int backPorch = 0;
+
+	// whether the sync pulse is high (+) or low (-)
+	bool syncPositive = false;
+
+	int syncStart() const { return visible + frontPorch; }
+	int syncEnd() const { return syncStart() + sync; }
+	int total() const { return syncEnd() + backPorch; }
+
+	// counter bits needed to reach the total
+	int bits() const
+	{
+		int b = 0;
+		while ((1 << b) < total())
+			b++;
+
+		return b;
+	}
+};
+
+class vgaMode
+{
+public:
+	std::string name;
+
+	// in MHz
+	double pixelClock = 0;
+
+	vgaAxis h;
+	vgaAxis v;
+
+	// in kHz and Hz
+	double lineRate() const { return h.total() > 0 ? pixelClock * 1000.0 / h.total() : 0; }
+	double refreshRate() const { return v.total() > 0 ? lineRate() * 1000.0 / v.total() : 0; }
+
+	std::string describe() const;
+
+	// A name for the timings as they are -- the preset's own name when they match one, otherwise
+	// one that spells them out, e.g. 640x480@60.00-h16.96.48n-v10.2.33n-25.2mhz
+	std::string timingName() const;
+	bool sameTiming(const vgaMode& other) const;
+};
+
+// the standard VESA timings for the modes the video board can show
+const std::vector<vgaMode>& vgaPresets();
+
+// nullptr when there is no preset of that name
+const vgaMode* findVgaPreset(std::string_view name);
+
+// Parse "visible,front,sync,back" into an axis, throwing if it isn't four numbers
+void parseVgaAxis(const std::string& s, vgaAxis& axis);
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "vgarom.h"
+
+#include <sstream>
+#include <algorithm>
+
+std::string vgaRomLayout::describe() const
+{
+	std::stringstream s;
+	s << addressBits() << " address bits = line[" << addressBits() - 1 << ":" << pixelBits << "] pixel[" << pixelBits - 1
+		<< ":0], " << entries() << " bytes";
+
+	return s.str();
+}
+
+void generateVgaRom(const vgaMode& m, const vgaRomSink& sink, size_t blockLines)
+{
+	const vgaRomLayout layout(m);
+	const size_t stride = layout.lineStride();
+	const size_t lines = size_t(1) << layout.lineBits;
+	const int hTotal = m.h.total();
+	const int vTotal = m.v.total();
+
+	// Every line is the same but for its vertical bits, so the horizontal ones are worked out once
+	std::vector<uint8_t> horizontal(stride);
+	for (size_t x = 0; x < stride; x++)
+	{
+		int px = static_cast<int>(x);
+		bool sync = px >= m.h.syncStart() && px < m.h.syncEnd();
+		uint8_t bits = 0;
+
+		if (sync == m.h.syncPositive)
+			bits |= VGA_HSYNC;
+
+		if (px >= m.h.visible)
+			bits |= VGA_HBLANK;
+
+		if (px >= hTotal - 1)
+			bits |= VGA_HRESET;
+
+		horizontal[x] = bits;
+	}
+
+	std::vector<uint8_t> block(std::max<size_t>(1, blockLines) * stride);
+	size_t filled = 0;
+
+	for (size_t y = 0; y < lines; y++)
+	{
+		int py = static_cast<int>(y);
+		bool sync = py >= m.v.syncStart() && py < m.v.syncEnd();
+		bool vblank = py >= m.v.visible;
+		uint8_t bits = 0;
+
+		if (sync == m.v.syncPositive)
+			bits |= VGA_VSYNC;
+
+		if (vblank)
+			bits |= VGA_VBLANK;
+
+		uint8_t* out = block.data() + filled;
+
+		for (size_t x = 0; x < stride; x++)
+		{
+			uint8_t b = horizontal[x] | bits;
+			if ((b & (VGA_HBLANK | VGA_VBLANK)) == 0)
+				b |= VGA_DISPLAY;
+
+			out[x] = b;
+		}
+
+		// the frame ends on the last pixel of the last line, and every line past it resets
+		if (py > vTotal - 1)
+		{
+			for (size_t x = 0; x < stride; x++)
+				out[x] |= VGA_VRESET;
+		}
+		else if (py == vTotal - 1)
+		{
+			for (size_t x = std::max(hTotal - 1, 0); x < stride; x++)
+				out[x] |= VGA_VRESET;
+		}
+
+		filled += stride;
+		if (filled == block.size())
+		{
+			sink(block.data(), filled);
+			filled = 0;
+		}
+	}
+
+	if (filled != 0)
+		sink(block.data(), filled);
+}
+
+std::vector<std::string> checkVgaMode(const vgaMode& m)
+{
+	std::vector<std::string> errors;
+
+	auto checkAxis = [&](const char* name, const vgaAxis& a)
+	{
+		if (a.visible <= 0 || a.sync <= 0)
+		{
+			std::stringstream msg;
+			msg << name << ": the visible part and the sync pulse can't be empty";
+			errors.push_back(msg.str());
+		}
+
+		if (a.bits() > 12)
+		{
+			std::stringstream msg;
+			msg << name << ": a total of " << a.total() << " needs a " << a.bits() << "-bit counter";
+			errors.push_back(msg.str());
+		}
+	};
+
+	checkAxis("horizontal", m.h);
+	checkAxis("vertical", m.v);
+
+	if (m.pixelClock <= 0)
+		errors.push_back("the pixel clock must be above zero");
+
+	// monitors want lines at 30 kHz and up, and a frame rate they can lock on to
+	double rate = m.refreshRate();
+	if (m.pixelClock > 0 && (m.lineRate() < 30.0 || rate < 50.0 || rate > 100.0))
+	{
+		std::stringstream msg;
+		msg << "a line rate of " << m.lineRate() << " kHz and a frame rate of " << rate << " Hz are outside what vga monitors sync to";
+		errors.push_back(msg.str());
+	}
+
+	return errors;
+}
+
+void vgaRomChecker::error(const std::string& what)
+{
+	// one broken setting usually breaks every line, so stop at a few
+	if (_errors.size() < 16)
+	{
+		std::stringstream msg;
+		msg << "line " << _y << ": " << what;
+		_errors.push_back(msg.str());
+	}
+}
+
+void vgaRomChecker::consume(const uint8_t* data, size_t size)
+{
+	const size_t stride = _layout.lineStride();
+
+	for (size_t i = 0; i < size; i++)
+	{
+		uint8_t b = data[i];
+		int x = static_cast<int>(_x);
+
+		// only what the counters reach counts -- they never get past the first reset of the line
+		if (_lineTotal < 0)
+		{
+			bool hsync = ((b & VGA_HSYNC) != 0) == _mode.h.syncPositive;
+			if (hsync)
+			{
+				if (_hsyncStart < 0)
+					_hsyncStart = x;
+				else if (_hsyncStart + _hsyncPixels != x)
+					error("the hsync pulse is broken up");
+
+				_hsyncPixels++;
+			}
+
+			if (b & VGA_DISPLAY)
+				_displayPixels++;
+
+			if (x == 0)
+			{
+				_lineVsync = ((b & VGA_VSYNC) != 0) == _mode.v.syncPositive;
+				_lineVblank = (b & VGA_VBLANK) != 0;
+			}
+
+			if (b & VGA_HRESET)
+			{
+				_lineTotal = x + 1;
+				_lineVreset = (b & VGA_VRESET) != 0;
+			}
+		}
+
+		if (++_x == stride)
+			endLine();
+	}
+}
+
+void vgaRomChecker::endLine()
+{
+	// lines past the frame only need to reset
+	if (_frameTotal < 0)
+	{
+		std::stringstream msg;
+
+		if (_lineTotal != _mode.h.total())
+			msg << "the line is " << _lineTotal << " pixels long rather than " << _mode.h.total() << "; ";
+
+		if (_hsyncStart != _mode.h.syncStart() || _hsyncPixels != _mode.h.sync)
+			msg << "hsync is " << _hsyncPixels << " pixels from " << _hsyncStart << " rather than " << _mode.h.sync << " from " << _mode.h.syncStart() << "; ";
+
+		int visible = _lineVblank ? 0 : _mode.h.visible;
+		if (_displayPixels != visible)
+			msg << _displayPixels << " pixels are displayed rather than " << visible << "; ";
+
+		std::string what = msg.str();
+		if (!what.empty())
+			error(what.substr(0, what.size() - 2));
+
+		int y = static_cast<int>(_y);
+
+		if (_lineVsync)
+		{
+			if (_vsyncStart < 0)
+				_vsyncStart = y;
+			else if (_vsyncStart + _vsyncLines != y)
+				error("the vsync pulse is broken up");
+
+			_vsyncLines++;
+		}
+
+		if (!_lineVblank)
+			_displayLines++;
+
+		if (_lineVreset)
+			_frameTotal = y + 1;
+	}
+
+	_x = 0;
+	_y++;
+
+	_hsyncStart = -1;
+	_hsyncPixels = 0;
+	_displayPixels = 0;
+	_lineTotal = -1;
+	_lineVsync = false;
+	_lineVblank = false;
+	_lineVreset = false;
+}
+
+std::vector<std::string> vgaRomChecker::finish()
+{
+	std::stringstream msg;
+
+	if (_y != (size_t(1) << _layout.lineBits) || _x != 0)
+		msg << "the image has " << _y << " lines rather than " << (size_t(1) << _layout.lineBits) << "; ";
+
+	if (_frameTotal != _mode.v.total())
+		msg << "the frame is " << _frameTotal << " lines long rather than " << _mode.v.total() << "; ";
+
+	if (_vsyncStart != _mode.v.syncStart() || _vsyncLines != _mode.v.sync)
+		msg << "vsync is " << _vsyncLines << " lines from " << _vsyncStart << " rather than " << _mode.v.sync << " from " << _mode.v.syncStart() << "; ";
+
+	if (_displayLines != _mode.v.visible)
+		msg << _displayLines << " lines are displayed rather than " << _mode.v.visible << "; ";
+
+	std::string what = msg.str();
+	if (!what.empty())
+		_errors.push_back("frame: " + what.substr(0, what.size() - 2));
+
+	return _errors;
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "vgamode.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+// The timing rom is addressed by the line counter (high bits) and the pixel counter (low bits), each
+// as wide as its total needs. Every byte holds what the video board drives during that pixel.
+constexpr uint8_t VGA_HSYNC = 0x01;		// sync levels, with the mode's polarity applied
+constexpr uint8_t VGA_VSYNC = 0x02;
+constexpr uint8_t VGA_HBLANK = 0x04;	// outside the visible part of the line
+constexpr uint8_t VGA_VBLANK = 0x08;	// outside the visible lines
+constexpr uint8_t VGA_DISPLAY = 0x10;	// visible pixel -- neither blank
+constexpr uint8_t VGA_HRESET = 0x20;	// last pixel of the line: clear the pixel counter
+constexpr uint8_t VGA_VRESET = 0x40;	// last pixel of the frame: clear the line counter too
+
+// Pixel counts past the end of the line and lines past the end of the frame can't be reached, but
+// they assert the resets anyway so a counter that glitches there finds its way back.
+class vgaRomLayout
+{
+public:
+	explicit vgaRomLayout(const vgaMode& m) : pixelBits(m.h.bits()), lineBits(m.v.bits()) { }
+
+	int pixelBits;
+	int lineBits;
+
+	int addressBits() const { return pixelBits + lineBits; }
+	size_t lineStride() const { return size_t(1) << pixelBits; }
+	size_t entries() const { return size_t(1) << addressBits(); }
+
+	std::string describe() const;
+};
+
+// Called with the image in order, a block at a time
+using vgaRomSink = std::function<void(const uint8_t* data, size_t size)>;
+
+// Stream the timing rom of a mode, blockLines lines per call to the sink. Nothing is kept but the
+// block being filled.
+void generateVgaRom(const vgaMode& m, const vgaRomSink& sink, size_t blockLines = 256);
+
+// Everything that doesn't add up about a mode itself
+std::vector<std::string> checkVgaMode(const vgaMode& m);
+
+// Follows a streamed timing rom the way the video board's counters would, and checks every line and
+// the frame against the mode -- where the sync pulses and blanking are, and that the resets make the
+// line and frame totals come out right.
+class vgaRomChecker
+{
+public:
+	explicit vgaRomChecker(const vgaMode& m) : _mode(m), _layout(m) { }
+
+	void consume(const uint8_t* data, size_t size);
+
+	// call once the whole image has been consumed
+	std::vector<std::string> finish();
+
+private:
+	void endLine();
+	void error(const std::string& what);
+
+	const vgaMode& _mode;
+	vgaRomLayout _layout;
+	std::vector<std::string> _errors;
+
+	// where the counters are
+	size_t _x = 0;
+	size_t _y = 0;
+
+	// what has been seen of the current line
+	int _hsyncStart = -1;
+	int _hsyncPixels = 0;
+	int _displayPixels = 0;
+	int _lineTotal = -1;
+	bool _lineVsync = false;
+	bool _lineVblank = false;
+	bool _lineVreset = false;
+
+	// ...and of the frame
+	int _vsyncStart = -1;
+	int _vsyncLines = 0;
+	int _displayLines = 0;
+	int _frameTotal = -1;
+};
\ No newline at end of file